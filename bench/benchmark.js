@@ -0,0 +1,138 @@
+// Headless benchmark for the obsapi addon.
+//
+// Measures initialize() per phase, resetAudio()/resetVideo() latency, and
+// sustained encode fps and dropped/skipped frames for every available video
+// encoder across a resolution/fps matrix, then writes the results as JSON.
+//
+//   npm run bench -- [--out bench-results.json] [--seconds 10] [--encoders id,id]
+//
+// The canvas has no sources, so encoders see black frames: numbers are for
+// comparing builds and libobs versions on one machine, not absolute capacity.
+const fs = require('fs')
+const os = require('os')
+const path = require('path')
+const obs = require('bindings')('obsapi');
+
+const MATRIX = [
+  { width: 1280, height: 720, fps: 30 },
+  { width: 1280, height: 720, fps: 60 },
+  { width: 1920, height: 1080, fps: 30 },
+  { width: 1920, height: 1080, fps: 60 },
+]
+
+function parseArgs (argv) {
+  const args = { out: 'bench-results.json', seconds: 10, encoders: null }
+  for (let i = 0; i < argv.length; i++) {
+    if (argv[i] === '--out') args.out = argv[++i]
+    else if (argv[i] === '--seconds') args.seconds = Number(argv[++i])
+    else if (argv[i] === '--encoders') args.encoders = argv[++i].split(',')
+  }
+  return args
+}
+
+function sleep (ms) {
+  return new Promise((resolve) => setTimeout(resolve, ms))
+}
+
+async function timed (fn) {
+  const start = process.hrtime.bigint()
+  const result = await fn()
+  return { ms: Number(process.hrtime.bigint() - start) / 1e6, result }
+}
+
+// Encodes for `seconds` into a throwaway recording and reports the rates.
+async function benchEncoder (id, mode, seconds, tmpDir) {
+  const file = path.join(tmpDir, `bench-${id}-${mode.width}x${mode.height}-${mode.fps}.mkv`)
+  const result = { encoder: id, ...mode }
+  let output = null
+
+  try {
+    output = await obs.createOutput({
+      type: 'ffmpeg_muxer',
+      name: 'bench',
+      settings: { path: file },
+      video: { id, settings: { bitrate: 6000, rate_control: 'CBR' } },
+      audio: { id: 'ffmpeg_aac', settings: { bitrate: 160 } }
+    })
+    await output.start()
+
+    // Let the encoder settle before sampling.
+    await sleep(1000)
+    const before = obs.getStats()
+    await sleep(seconds * 1000)
+    const after = obs.getStats()
+
+    const stats = after.outputs.find((o) => o.name === 'bench') || {}
+    const elapsed = (after.timestamp - before.timestamp) / 1000
+    const first = before.outputs.find((o) => o.name === 'bench') || {}
+    result.fps = ((stats.totalFrames || 0) - (first.totalFrames || 0)) / elapsed
+    result.kbps = ((stats.totalBytes || 0) - (first.totalBytes || 0)) * 8 / 1000 / elapsed
+    result.droppedFrames = (stats.framesDropped || 0) - (first.framesDropped || 0)
+    result.skippedFrames = after.skippedFrames - before.skippedFrames
+    result.laggedFrames = after.laggedFrames - before.laggedFrames
+    result.averageFrameTimeMs = after.averageFrameTimeMs
+
+    await output.stop()
+  } catch (reason) {
+    result.error = `${reason}`
+  } finally {
+    if (output) output.release()
+    fs.rmSync(file, { force: true })
+  }
+
+  return result
+}
+
+async function main () {
+  const args = parseArgs(process.argv.slice(2))
+  const tmpDir = fs.mkdtempSync(path.join(os.tmpdir(), 'obsapi-bench-'))
+  const results = {
+    date: new Date().toISOString(),
+    platform: `${process.platform}-${process.arch}`,
+    cpu: os.cpus()[0] && os.cpus()[0].model,
+    seconds: args.seconds
+  }
+
+  // Every module is loaded so that every encoder can be measured.
+  const init = await timed(() => obs.initialize({ configPath: path.join(tmpDir, 'config') }))
+  results.version = init.result.version
+  results.initialize = { wallMs: init.ms, ...init.result.timings }
+
+  results.resetAudio = (await timed(() => obs.resetAudio('stereo'))).ms
+
+  const encoders = obs.getCodecs()
+    .filter((c) => c.type === 'video' && !c.caps.deprecated && !c.caps.internal)
+    .map((c) => c.id)
+    .filter((id) => !args.encoders || args.encoders.includes(id))
+
+  results.resetVideo = []
+  results.encode = []
+  for (const mode of MATRIX) {
+    const reset = await timed(() => obs.resetVideo({
+      baseWidth: mode.width, baseHeight: mode.height,
+      fpsNum: mode.fps, fpsDen: 1, format: 'nv12'
+    }))
+    results.resetVideo.push({ ...mode, ms: reset.ms })
+
+    for (const id of encoders) {
+      const result = await benchEncoder(id, mode, args.seconds, tmpDir)
+      console.log(`${id} ${mode.width}x${mode.height}@${mode.fps}: ` +
+        (result.error || `${result.fps.toFixed(1)} fps, ${result.skippedFrames} skipped, ` +
+          `${result.droppedFrames} dropped`))
+      results.encode.push(result)
+    }
+  }
+
+  console.log(await obs.shutdown())
+  fs.rmSync(tmpDir, { recursive: true, force: true })
+
+  fs.writeFileSync(args.out, JSON.stringify(results, null, 2))
+  console.log(`Results written to ${args.out}`)
+}
+
+main()
+  .then(() => process.exit(0))
+  .catch((reason) => {
+    console.error(`Benchmark failed: ${reason}`)
+    process.exit(1)
+  })
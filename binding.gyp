@@ -13,6 +13,11 @@
             "-lobs", "-L/usr/local/lib"
       ],
       'defines': [ 'NAPI_DISABLE_CPP_EXCEPTIONS' ],
+      "conditions": [
+        [ "OS=='win'", { "libraries": [ "dxgi.lib" ] } ],
+        [ "OS=='mac'", { "libraries": [ "-lobjc" ] } ],
+        [ "OS=='linux'", { "libraries": [ "-lX11", "-lrt" ] } ]
+      ],
     }
   ]
 }
\ No newline at end of file
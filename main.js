@@ -1,5 +1,5 @@
 // Modules to control application life and create native browser window
-const {app, BrowserWindow} = require('electron')
+const {app, BrowserWindow, screen} = require('electron')
 const path = require('path')
 const obs = require('bindings')('obsapi');
 
@@ -18,15 +18,33 @@ function createWindow () {
 
   // Open the DevTools.
   // mainWindow.webContents.openDevTools()
+
+  return mainWindow
 }
 
 // This method will be called when Electron has finished
 // initialization and is ready to create browser windows.
 // Some APIs can only be used after this event occurs.
 app.whenReady().then(() => {
-  obs.initialize()
+  // Startup and module loading run off the main thread. Every binding
+  // below is queued on the same native command thread and runs in call
+  // order, so no JS-side chaining is needed. The module manifest kept in configPath lets later launches
+  // load the listed modules without scanning the module paths. Besides the outputs, services and
+  // sources used below, they hold the encoders that video: { id: 'auto' } probes on this platform,
+  // with obs-x264 as the fallback everywhere.
+  const platformModules = {
+    win32: ['obs-qsv11', 'enc-amf'],
+    darwin: ['mac-vth264']
+  }
+  obs.initialize({
+    configPath: path.join(app.getPath('userData'), 'obs'),
+    modules: ['obs-outputs', 'obs-ffmpeg', 'rtmp-services', 'image-source', 'obs-x264']
+      .concat(platformModules[process.platform] || [])
+  })
   .then((info) => {
-    console.log("OBS Version: ",info);
+    console.log("OBS Version: ",info.version);
+    console.log("OBS init timings (ms): ",info.timings);
+    console.log("OBS modules: ",info.modules, info.manifestHit ? "(from manifest)" : "(scanned)");
     return info;
   })
   .catch((reason) => {
@@ -34,7 +52,13 @@ app.whenReady().then(() => {
    })
   .finally((info) => console.log("OBS initialized"));
 
-  obs.resetVideo("1920x1080") // Format, width, height
+  // "1920x1080" also works as a shortcut for I420 at 30 fps.
+  obs.resetVideo({
+    baseWidth: 1920, baseHeight: 1080,
+    outputWidth: 1280, outputHeight: 720,
+    fpsNum: 30, fpsDen: 1,
+    format: 'nv12', scaleType: 'bicubic', colorspace: '709', range: 'partial'
+  })
   .then((info) => {
     console.log("OBS resets to: ",info);
     return info;
@@ -44,7 +68,7 @@ app.whenReady().then(() => {
    })
   .finally((info) => console.log("video reset"));
 
-  obs.resetAudio("stereo") // Samples, channels
+  obs.resetAudio({ sampleRate: 48000, speakers: 'stereo' })
   .then((info) => {
     console.log("OBS resets to: ",info);
     return info;
@@ -54,9 +78,98 @@ app.whenReady().then(() => {
    })
   .finally((info) => console.log("audio reset"));
 
-  createWindow()
+  // The whole layout is sent in one batch and shows up on a single frame.
+  obs.applyBatch([
+    { op: 'createScene', name: 'main' },
+    { op: 'createSource', name: 'background', id: 'color_source',
+      settings: { color: 0xff303030, width: 1920, height: 1080 } },
+    { op: 'addItem', scene: 'main', source: 'background' },
+    { op: 'setProgram', source: 'main' }
+  ])
+  .catch((reason) => {
+      console.error(`Trouble with building the scene: ${reason}`);
+   })
+
+  // An offscreen page composited over the scene, without a browser source.
+  const overlay = new BrowserWindow({
+    show: false, width: 1280, height: 720, transparent: true,
+    webPreferences: { offscreen: true }
+  })
+  obs.createFrameSource({ name: 'overlay', width: 1280, height: 720 })
+  .then((frames) => {
+    overlay.webContents.on('paint', (event, dirty, image) => {
+      const size = image.getSize()
+      frames.push(image.getBitmap(), size.width, size.height)
+    })
+    overlay.webContents.setFrameRate(60)
+    overlay.loadFile('index.html')
+    return obs.addSceneItem('main', 'overlay')
+  })
+  .catch((reason) => {
+      console.error(`Trouble with creating the overlay: ${reason}`);
+   })
+
+  const mainWindow = createWindow()
 
-  obs.startOutput("") 
+  // The preview renders on the GPU straight into a child surface of the window.
+  obs.createDisplay(mainWindow.getNativeWindowHandle(), {
+    x: 0, y: 0, width: 960, height: 540,
+    // macOS bounds are in points; elsewhere they are already pixels.
+    scaleFactor: process.platform === 'darwin' ? screen.getPrimaryDisplay().scaleFactor : 1,
+    fps: 30
+  })
+  .then((display) => {
+    // The display must be gone before the window, and with it the surface it presents to,
+    // so closing waits for destroy() once.
+    let destroyed = false
+    mainWindow.on('close', (event) => {
+      if (destroyed) return
+      destroyed = true
+      event.preventDefault()
+      display.destroy().finally(() => mainWindow.close())
+    })
+  })
+  .catch((reason) => {
+      console.error(`Trouble with creating the preview: ${reason}`);
+   })
+
+  // Output lifecycle events arrive batched, with the stop code on "stop".
+  obs.subscribeOutputEvents((events) => {
+    for (const event of events) {
+      console.log(`OBS ${event.output}: ${event.type}` +
+        (event.reason ? ` (${event.reason})` : '') + (event.error ? `: ${event.error}` : ''));
+    }
+  });
+
+  // One encoder pair feeds both the stream and a local recording, so each
+  // frame is encoded once. Outputs keep their encoders and service until
+  // released, and each can be stopped and started on its own.
+  obs.createEncoders({
+    name: 'program',
+    video: { id: 'auto', settings: { bitrate: 2500 } }, // probed once per GPU, then cached
+    audio: { id: 'ffmpeg_aac', settings: { bitrate: 160 } }
+  })
+  .then((encoders) => Promise.all([
+    obs.createOutput({
+      type: 'rtmp_output',
+      name: 'stream',
+      encoders,
+      rtmp: {
+        server: process.env.OBS_SERVER || '',
+        key: process.env.OBS_STREAM_KEY || '',
+        newSocketLoop: process.platform === 'win32',
+        dynamicBitrate: true,
+        reconnect: { retries: 10, delaySec: 2 }
+      }
+    }),
+    obs.createOutput({
+      type: 'ffmpeg_muxer',
+      name: 'record',
+      settings: { path: path.join(app.getPath('videos'), 'obsapi-recording.mkv') },
+      encoders
+    })
+  ]))
+  .then((outputs) => Promise.all(outputs.map((output) => output.start())))
   .then((info) => {
     console.log("OBS started? ",info);
     return info;
@@ -66,8 +179,19 @@ app.whenReady().then(() => {
    })
   .finally((info) => console.log("start output"));
 
-  console.log("OBS Codecs:", obs.getCodecs());
-  console.log("OBS Outputs:", obs.getOutputs());
+  obs.ready()
+  .then(() => {
+    console.log("OBS Codecs:", obs.getCodecs().map((c) => `${c.id} (${c.type}${c.hardware ? ', hw' : ''})`));
+    console.log("OBS Outputs:", obs.getOutputs().map((o) => o.id));
+
+    obs.subscribeStats(5000, (stats) => {
+      for (const output of stats.outputs) {
+        console.log(`OBS ${output.name}: ${output.kbps.toFixed(0)} kbps, ` +
+          `${output.framesDropped} dropped, congestion ${output.congestion.toFixed(2)}`);
+      }
+    });
+  })
+  .catch(() => {});
 
   app.on('activate', function () {
     // On macOS it's common to re-create a window in the app when the
@@ -76,9 +200,17 @@ app.whenReady().then(() => {
   })
 })
 
-// This will be emitted when all windows have been closed and the application will quit
-app.on('will-quit', function () {
-  console.log(obs.shutdown());
+// This will be emitted when all windows have been closed and the application will quit.
+// Quitting waits for the outputs to flush and OBS to shut down.
+let obsShutDown = false
+app.on('will-quit', function (event) {
+  if (obsShutDown) return
+  obsShutDown = true
+  event.preventDefault()
+  obs.shutdown({ timeoutMs: 5000 })
+    .then((result) => console.log('OBS shut down', result))
+    .catch((reason) => console.log(`OBS shutdown failed: ${reason}`))
+    .finally(() => app.exit())
 })
 
 // Quit when all windows are closed, except on macOS. There, it's common
@@ -0,0 +1,184 @@
+// Child process side of obs-remote.js: loads the obsapi addon so that libobs,
+// its plugins and their threads live outside the Electron main process.
+//
+// Requests arrive as [id, handle, method, args] and are answered with
+// [id, error, result]. Handle 0 is the addon; anything a call returns that
+// has methods (outputs, encoders, taps, unsubscribe functions) stays here and
+// is sent as { $handle, methods, terminal, props }. Functions passed as
+// arguments arrive as { $callback } and are invoked with
+// ['callback', id, args].
+//
+// Preview frames and audio levels do not use the channel: createPreviewRing()
+// and createLevelsRing() write them into shared rings (openSharedRing) that
+// the parent maps by name.
+const obs = require('bindings')('obsapi')
+
+const LEVELS_RING_SLOTS = 4
+const MAX_LEVELS_CHANNELS = 8
+
+const handles = new Map()
+let nextHandle = 1
+let nextRing = 1
+
+function isData (value) {
+  return value === null || typeof value !== 'object' || Array.isArray(value) ||
+    value instanceof ArrayBuffer || ArrayBuffer.isView(value)
+}
+
+// Names of the functions reachable from value, own or inherited.
+function methodsOf (value) {
+  const names = new Set()
+  for (let proto = value; proto && proto !== Object.prototype; proto = Object.getPrototypeOf(proto)) {
+    for (const name of Object.getOwnPropertyNames(proto)) {
+      if (name !== 'constructor' && typeof value[name] === 'function') names.add(name)
+    }
+  }
+  return [...names]
+}
+
+function encode (value) {
+  if (typeof value === 'function') {
+    const id = nextHandle++
+    handles.set(id, { value, terminal: [''] })
+    return { $handle: id, methods: [''], terminal: [''], props: {} }
+  }
+  if (Array.isArray(value)) return value.map(encode)
+  if (isData(value)) return value
+
+  const methods = methodsOf(value)
+  const props = {}
+  for (const key of Object.keys(value)) {
+    if (typeof value[key] !== 'function') props[key] = encode(value[key])
+  }
+  if (!methods.length) return props
+
+  // Class instances (Output, Encoders, Display) stay usable after stop();
+  // the plain objects returned by taps and canvases do not.
+  const plain = Object.getPrototypeOf(value) === Object.prototype
+  const terminal = ['release', 'destroy'].concat(plain ? ['stop'] : [])
+  const id = nextHandle++
+  handles.set(id, { value, terminal })
+  return { $handle: id, methods, terminal, props }
+}
+
+function decode (value) {
+  if (Array.isArray(value)) return value.map(decode)
+  // Buffers arrive as plain Uint8Arrays, which the addon does not accept.
+  if (value instanceof Uint8Array && !Buffer.isBuffer(value)) {
+    return Buffer.from(value.buffer, value.byteOffset, value.byteLength)
+  }
+  if (isData(value)) return value
+  if (value.$callback) {
+    const id = value.$callback
+    return (...args) => process.send(['callback', id, encode(args)])
+  }
+  if (value.$handle) {
+    const entry = handles.get(value.$handle)
+    if (!entry) throw new TypeError('Expected a handle that has not been released')
+    return entry.value
+  }
+  const result = {}
+  for (const key of Object.keys(value)) result[key] = decode(value[key])
+  return result
+}
+
+// Preview frames from a video tap, copied into a shared ring. Each frame is
+// one slot laid out as the tap's planes describe.
+function createPreviewRing (options = {}) {
+  const name = `obsapi-${process.pid}-${nextRing++}`
+  let ring = null
+  const tap = obs.createVideoTap(options, (slot) => {
+    if (ring) ring.write(tap.buffers[slot])
+    tap.release(slot)
+  })
+  // The slot size comes from the tap, so it exists first and is stopped
+  // again if the ring cannot be created (E.G. a stale name from a crash).
+  try {
+    ring = obs.openSharedRing({
+      name, create: true, slots: options.ringSlots || 3, slotSize: tap.buffers[0].byteLength
+    })
+  } catch (error) {
+    tap.stop()
+    throw error
+  }
+  return {
+    name,
+    width: tap.width,
+    height: tap.height,
+    format: tap.format,
+    planes: tap.planes,
+    stats: () => tap.stats(),
+    stop () {
+      tap.stop()
+      ring.close()
+    }
+  }
+}
+
+// Audio levels from an audio tap, packed as float64
+// [timestamp, loudness, channels, peak0, rms0, peak1, rms1, ...].
+function createLevelsRing (options = {}) {
+  const name = `obsapi-${process.pid}-${nextRing++}`
+  const ring = obs.openSharedRing({
+    name, create: true, slots: LEVELS_RING_SLOTS, slotSize: 8 * (3 + 2 * MAX_LEVELS_CHANNELS)
+  })
+  const packed = new Float64Array(3 + 2 * MAX_LEVELS_CHANNELS)
+  const tapOptions = { ...options }
+  delete tapOptions.pcmFrames
+  let tap
+  try {
+    tap = obs.createAudioTap(tapOptions, (levels) => {
+      const channels = Math.min(levels.channels.length, MAX_LEVELS_CHANNELS)
+      packed[0] = levels.timestamp
+      packed[1] = levels.loudness
+      packed[2] = channels
+      for (let i = 0; i < channels; i++) {
+        packed[3 + 2 * i] = levels.channels[i].peak
+        packed[4 + 2 * i] = levels.channels[i].rms
+      }
+      ring.write(packed.subarray(0, 3 + 2 * channels))
+    })
+  } catch (error) {
+    ring.close()
+    throw error
+  }
+  return {
+    name,
+    mix: options.mix || 0,
+    stop () {
+      tap.stop()
+      ring.close()
+    }
+  }
+}
+
+const hostMethods = { createPreviewRing, createLevelsRing }
+
+function call (handle, method, args) {
+  if (!handle) {
+    const fn = hostMethods[method] || obs[method]
+    if (typeof fn !== 'function') throw new TypeError(`obsapi has no function ${method}`)
+    return fn(...args)
+  }
+
+  const entry = handles.get(handle)
+  if (!entry) throw new Error('Error: the handle was released')
+  const result = method ? entry.value[method](...args) : entry.value(...args)
+  if (entry.terminal.includes(method)) handles.delete(handle)
+  return result
+}
+
+process.on('message', ([id, handle, method, args]) => {
+  Promise.resolve()
+    .then(() => call(handle, method, decode(args)))
+    .then((result) => process.send([id, null, encode(result)]))
+    .catch((reason) => process.send([id, reason instanceof Error ? reason.message : `${reason}`]))
+})
+
+// The parent went away without shutting down: flush what can be flushed.
+process.on('disconnect', () => {
+  Promise.resolve()
+    .then(() => obs.shutdown({ timeoutMs: 5000 }))
+    .catch(() => {})
+    .finally(() => process.exit(0))
+})
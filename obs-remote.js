@@ -0,0 +1,201 @@
+// Out-of-process mode: createRemote() forks obs-host.js, which hosts libobs,
+// and returns an object with the addon's API. Every call is forwarded over
+// the IPC channel and returns a promise, including the ones that are
+// synchronous in process (getStats(), getCodecs(), frameSource.push(), ...).
+// Outputs, encoders, taps and the like come back as proxies whose methods
+// forward the same way, and callbacks are called back from the host. A
+// stalled or crashing libobs no longer blocks or takes down the main thread:
+// if the host exits, pending calls reject and 'exit' is emitted.
+//
+// Preview frames and audio levels are read from shared rings instead of
+// messages; read() returns the newest one and never waits:
+//
+//   const remote = require('./obs-remote').createRemote()
+//   await remote.initialize({ configPath })
+//   const preview = await remote.openPreview({ width: 640, height: 360, format: 'bgra' })
+//   const frame = preview.read()  // { seq, size, dropped, data } or null
+//   const meter = await remote.openLevels({ mix: 0, intervalMs: 50 })
+//   const levels = meter.read()   // { timestamp, loudness, channels: [{ peak, rms }] } or null
+//   remote.on('exit', (code, signal) => { ... })
+//   await remote.close()          // shutdown() in the host, then it exits
+//
+// The main process loads the addon only for openSharedRing(); libobs is
+// never started there. createDisplay() needs a window handle that another
+// process can parent to, which macOS does not allow.
+const { fork } = require('child_process')
+const EventEmitter = require('events')
+const path = require('path')
+
+const DEFAULT_CLOSE_TIMEOUT_MS = 5000
+
+class ObsRemote extends EventEmitter {
+  constructor (options = {}) {
+    super()
+    this.pending = new Map()
+    this.callbacks = new Map()
+    this.nextCall = 1
+    this.nextCallback = 1
+    this.exited = false
+    this.addon = require('bindings')('obsapi')
+
+    this.process = fork(path.join(__dirname, 'obs-host.js'), options.args || [], {
+      env: { ...process.env, ELECTRON_RUN_AS_NODE: '1' },
+      serialization: 'advanced',
+      stdio: 'inherit'
+    })
+    this.process.on('message', (message) => this.onMessage(message))
+    this.process.on('error', (error) => this.emit('error', error))
+    this.process.on('exit', (code, signal) => this.onExit(code, signal))
+  }
+
+  onMessage (message) {
+    if (message[0] === 'callback') {
+      const callback = this.callbacks.get(message[1])
+      if (callback) callback(...this.decode(message[2]))
+      return
+    }
+
+    const [id, error, result] = message
+    const call = this.pending.get(id)
+    if (!call) return
+    this.pending.delete(id)
+    if (error) {
+      call.callbackIds.forEach((callbackId) => this.callbacks.delete(callbackId))
+      call.reject(new Error(error))
+      return
+    }
+
+    // Callbacks passed to a call that returned a handle live as long as it.
+    const value = this.decode(result)
+    if (result && result.$handle) {
+      Object.defineProperty(value, 'callbackIds', { value: call.callbackIds })
+    }
+    call.resolve(value)
+  }
+
+  onExit (code, signal) {
+    this.exited = true
+    const error = new Error(`Error: the obs host exited (${signal || code})`)
+    for (const call of this.pending.values()) call.reject(error)
+    this.pending.clear()
+    this.callbacks.clear()
+    this.emit('exit', code, signal)
+  }
+
+  call (handle, method, args) {
+    if (this.exited) return Promise.reject(new Error('Error: the obs host has exited'))
+    return new Promise((resolve, reject) => {
+      const id = this.nextCall++
+      const callbackIds = []
+      this.pending.set(id, { resolve, reject, callbackIds })
+      this.process.send([id, handle, method, this.encode(args, callbackIds)])
+    })
+  }
+
+  encode (value, callbackIds) {
+    if (typeof value === 'function') {
+      if (value.$handle) return { $handle: value.$handle }
+      const id = this.nextCallback++
+      this.callbacks.set(id, value)
+      callbackIds.push(id)
+      return { $callback: id }
+    }
+    if (Array.isArray(value)) return value.map((item) => this.encode(item, callbackIds))
+    if (value === null || typeof value !== 'object' ||
+        value instanceof ArrayBuffer || ArrayBuffer.isView(value)) return value
+    if (value.$handle) return { $handle: value.$handle }
+
+    const result = {}
+    for (const key of Object.keys(value)) result[key] = this.encode(value[key], callbackIds)
+    return result
+  }
+
+  decode (value) {
+    if (Array.isArray(value)) return value.map((item) => this.decode(item))
+    if (value === null || typeof value !== 'object' ||
+        value instanceof ArrayBuffer || ArrayBuffer.isView(value)) return value
+
+    if (!value.$handle) {
+      const result = {}
+      for (const key of Object.keys(value)) result[key] = this.decode(value[key])
+      return result
+    }
+
+    const handle = value.$handle
+    const invoke = (method) => (...args) => {
+      if (value.terminal.includes(method) && target.callbackIds) {
+        target.callbackIds.forEach((id) => this.callbacks.delete(id))
+      }
+      return this.call(handle, method, args)
+    }
+    const target = value.methods[0] === '' ? invoke('') : this.decode(value.props)
+    for (const method of value.methods) {
+      if (method) target[method] = invoke(method)
+    }
+    Object.defineProperty(target, '$handle', { value: handle })
+    return target
+  }
+
+  // Maps the host's preview ring; read([buffer]) returns the newest frame.
+  async openPreview (options = {}) {
+    const preview = await this.call(0, 'createPreviewRing', [options])
+    const ring = this.addon.openSharedRing({ name: preview.name })
+    const stop = preview.stop
+    preview.read = (buffer) => ring.read(buffer)
+    preview.stop = () => {
+      ring.close()
+      return stop()
+    }
+    return preview
+  }
+
+  // Maps the host's levels ring; read() returns the newest levels.
+  async openLevels (options = {}) {
+    const meter = await this.call(0, 'createLevelsRing', [options])
+    const ring = this.addon.openSharedRing({ name: meter.name })
+    const buffer = Buffer.alloc(ring.slotSize)
+    const packed = new Float64Array(buffer.buffer, buffer.byteOffset, ring.slotSize / 8)
+    const stop = meter.stop
+    meter.read = () => {
+      if (!ring.read(buffer)) return null
+      const channels = []
+      for (let i = 0; i < packed[2]; i++) {
+        channels.push({ peak: packed[3 + 2 * i], rms: packed[4 + 2 * i] })
+      }
+      return { mix: meter.mix, timestamp: packed[0], loudness: packed[1], channels }
+    }
+    meter.stop = () => {
+      ring.close()
+      return stop()
+    }
+    return meter
+  }
+
+  // Shuts libobs down in the host and waits for it to exit.
+  async close (options = { timeoutMs: DEFAULT_CLOSE_TIMEOUT_MS }) {
+    if (this.exited) return null
+    const exited = new Promise((resolve) => this.once('exit', resolve))
+    const result = await this.call(0, 'shutdown', [options]).catch(() => null)
+    if (!this.exited) this.process.disconnect()
+    await exited
+    return result
+  }
+}
+
+// Returns the remote, where every name that is not one of its own members
+// forwards to the addon function of that name.
+function createRemote (options) {
+  const remote = new ObsRemote(options)
+  return new Proxy(remote, {
+    get (target, name) {
+      if (typeof name === 'symbol' || name in target) {
+        const member = target[name]
+        return typeof member === 'function' ? member.bind(target) : member
+      }
+      if (name === 'then') return undefined
+      return (...args) => target.call(0, name, args)
+    }
+  })
+}
+
+module.exports = { createRemote }
@@ -9,422 +9,9097 @@
 // - Create Twitch service with server URL + streamkey
 // - Create an RTMP output
 // - Set the encoders and the service to the output
-// - Start / stop the output
+// - Start / stop / update the output through a persistent Output handle
 // - Shutdown OBS
 //
 
 #include <napi.h>
 #include <obs.h>
+#include <obs-config.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <set>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <dxgi.h>
+#elif defined(__APPLE__)
+#include <CoreGraphics/CGGeometry.h>
+#include <objc/message.h>
+#include <objc/runtime.h>
+#elif defined(__linux__)
+#include <X11/Xlib.h>
+#endif
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define DEFAULT_VIDEO_ADAPTER 0
+#define ADAPTER_UNSET (-1)
+#define ADAPTER_AUTO (-2)
+#if defined(_WIN32)
+#define DEFAULT_MODULE ("libobs-d3d11")
+#else
 #define DEFAULT_MODULE ("libobs-opengl")
+#endif
 #define DEFAULT_VIDEO_FORMAT VIDEO_FORMAT_I420
 #define DEFAULT_VIDEO_FPS_NUM 30000
 #define DEFAULT_VIDEO_FPS_DEN 1000
 #define DEFAULT_VIDEO_WIDTH 640
 #define DEFAULT_VIDEO_HEIGHT 360
+#define DEFAULT_VIDEO_GPU_CONVERSION true
+#define DEFAULT_VIDEO_COLORSPACE VIDEO_CS_DEFAULT
+#define DEFAULT_VIDEO_RANGE VIDEO_RANGE_DEFAULT
+#define DEFAULT_VIDEO_SCALE_TYPE OBS_SCALE_BICUBIC
+
+#define DEFAULT_AUDIO_SAMPLES 48000
+#define DEFAULT_AUDIO_CHANNELS SPEAKERS_STEREO
+
+#define OUTPUT_STOP_TIMEOUT_MS 10000
+
+#define RTMP_OUTPUT_ID ("rtmp_output")
+#define RTMP_SERVICE_ID ("rtmp_custom")
+#define DEFAULT_RECONNECT_RETRIES 20
+#define DEFAULT_RECONNECT_DELAY_SEC 2
+
+#define DEFAULT_LOCALE ("en-US")
+#define MANIFEST_FILE_NAME ("module-manifest.json")
+
+#define NOT_INITIALIZED_STRING ("Error: OBS API not initialized!")
+#define STARTUP_FAILED_STRING ("Error: OBS failed to start up!")
+#define SHUT_DOWN_STRING ("Error: OBS API has shut down!")
+
+// Milliseconds elapsed since the given time point.
+static double elapsedMs(std::chrono::steady_clock::time_point since) {
+  return std::chrono::duration<double, std::milli>(
+    std::chrono::steady_clock::now() - since).count();
+}
+
+// Initialization state shared by every binding.
+// obs_startup and module loading run as the first command on the command
+// thread, so any command queued after initialize() sees the finished state
+// in waitForReady() instead of racing it.
+enum class ObsInitState { IDLE, STARTING, READY, FAILED };
+
+static std::mutex init_mutex;
+static std::condition_variable init_cv;
+static ObsInitState init_state = ObsInitState::IDLE;
+static std::string init_error;
+static Napi::Reference<Napi::Promise> ready_promise;
+
+static void setInitState(ObsInitState state, const std::string& error = "") {
+  {
+    std::lock_guard<std::mutex> lock(init_mutex);
+    init_state = state;
+    init_error = error;
+  }
+  init_cv.notify_all();
+}
+
+// True once initialize() has been called and has not failed.
+static bool initRequested() {
+  std::lock_guard<std::mutex> lock(init_mutex);
+  return init_state == ObsInitState::STARTING || init_state == ObsInitState::READY;
+}
+
+// True once the init sequence has completed successfully.
+static bool initReady() {
+  std::lock_guard<std::mutex> lock(init_mutex);
+  return init_state == ObsInitState::READY;
+}
+
+// Blocks the calling thread until initialization has completed.
+// Returns false and fills error if OBS failed to start or was never initialized.
+static bool waitForReady(std::string& error) {
+  std::unique_lock<std::mutex> lock(init_mutex);
+  init_cv.wait(lock, [] { return init_state != ObsInitState::STARTING; });
+  if (init_state == ObsInitState::READY)
+    return true;
+
+  error = init_state == ObsInitState::FAILED ? init_error : NOT_INITIALIZED_STRING;
+  return false;
+}
+
+// OBS command thread
+// Every libobs call made on behalf of JS runs on one dedicated native thread
+// instead of the libuv threadpool, so OBS work never competes with fs/dns/
+// crypto work and commands cannot run concurrently with each other.
+// Commands run in priority order, FIFO within a priority:
+//   HIGH:   initialize and short queries that must not wait behind set-up work
+//   NORMAL: configuration and output control, in the order they were issued
+//   LOW:    long running work such as encoder probing
+// Completions are handed back to the JS thread through one ThreadSafeFunction,
+// where OnOK()/OnError() settle the command's promise. A command that waits
+// on a libobs signal defers instead of blocking the thread: it completes when
+// the signal calls Finish(), or fails once its timeout has passed.
+// Counters that libobs keeps atomically (stats) are read directly and never queued.
+enum class ObsPriority { HIGH = 0, NORMAL = 1, LOW = 2 };
+
+#define COMMAND_PRIORITIES 3
+
+class ObsCommandWorker {
+public:
+  virtual ~ObsCommandWorker() {}
+
+  void Queue(ObsPriority priority = ObsPriority::NORMAL);
+
+protected:
+  ObsCommandWorker(napi_env env) : env(env) { }
+
+  Napi::Env Env() const { return Napi::Env(env); }
+
+  void SetError(const std::string& message) {
+    error = message;
+    failed = true;
+  }
+
+  // Called from Execute() before whatever will call Finish() is set up: the
+  // command stays pending after Execute() returns, until Finish() or the
+  // timeout, whichever comes first.
+  void Defer(std::chrono::milliseconds timeout);
+
+  // Completes a deferred command. Safe from any thread; only the first call
+  // (or the timeout) counts.
+  void Finish();
+
+  virtual void Execute() = 0;
+  virtual void OnOK() { }
+  virtual void OnError(const Napi::Error&) { }
+
+  // Runs on the command thread when a deferred command times out, before it
+  // completes: sets the error and makes sure nothing calls Finish()
+  // afterwards, e.g. by disconnecting the signal that would.
+  virtual void OnTimeout() { }
+
+  // Called on the JS thread instead of OnOK()/OnError() for a command still
+  // queued when the queue stops, or pushed after that.
+  virtual void OnDropped() {
+    OnError(Napi::Error::New(Env(), SHUT_DOWN_STRING));
+  }
+
+private:
+  friend class ObsCommandQueue;
+
+  napi_env env;
+  std::string error;
+  bool failed = false;
+  bool sync = false;
+
+  // Guarded by the queue's mutex.
+  bool executing = false;
+  bool deferred = false;
+  bool settled = false;
+};
+
+class ObsCommandQueue {
+public:
+  void Start(Napi::Env env) {
+    completions = Napi::ThreadSafeFunction::New(env,
+        Napi::Function::New(env, [](const Napi::CallbackInfo&) {}), "obsapi_commands", 0, 1);
+    completions.Unref(env);
+    running = true;
+    thread = std::thread(&ObsCommandQueue::Run, this);
+  }
+
+  // Stops after the running command; queued commands are dropped, see
+  // OnDropped(). Deferred commands are leaked, since a signal may still hold
+  // them. Called on the JS thread.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!running)
+        return;
+      running = false;
+    }
+    cv.notify_all();
+    thread.join();
+
+    for (auto& queue : queues) {
+      for (ObsCommandWorker* worker : queue) {
+        if (worker->sync)
+          continue;
+        Napi::HandleScope scope(worker->Env());
+        worker->OnDropped();
+        delete worker;
+      }
+      queue.clear();
+    }
+    completions.Release();
+  }
+
+  // Called on the JS thread. Keeps the event loop alive while commands are pending.
+  // Commands pushed after Stop() are dropped and their promises rejected.
+  void Push(ObsCommandWorker* worker, ObsPriority priority) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!running) {
+        worker->OnDropped();
+        delete worker;
+        return;
+      }
+      queues[(int)priority].push_back(worker);
+    }
+    if (in_flight++ == 0)
+      completions.Ref(worker->Env());
+    cv.notify_one();
+  }
+
+  // Called from a worker's Defer() and Finish(), see there.
+  void Defer(ObsCommandWorker* worker, std::chrono::milliseconds timeout) {
+    std::lock_guard<std::mutex> lock(mutex);
+    worker->deferred = true;
+    deadlines.emplace(std::chrono::steady_clock::now() + timeout, worker);
+  }
+
+  void Finish(ObsCommandWorker* worker) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (worker->settled)
+      return;
+    worker->settled = true;
+    for (auto it = deadlines.begin(); it != deadlines.end(); ++it) {
+      if (it->second == worker) {
+        deadlines.erase(it);
+        break;
+      }
+    }
+    // Still in Execute(): Run() completes it when that returns.
+    if (!worker->executing)
+      Post(worker);
+  }
+
+  // Runs a function on the command thread after every command queued so far
+  // and blocks the caller until it returns. Must not be called from the
+  // command thread.
+  void RunSync(std::function<void()> func) {
+    SyncCommand command(func);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!running) {
+        func();
+        return;
+      }
+      queues[(int)ObsPriority::LOW].push_back(&command);
+    }
+    cv.notify_one();
+
+    std::unique_lock<std::mutex> lock(command.done_mutex);
+    command.done_cv.wait(lock, [&] { return command.done; });
+  }
+
+private:
+  // Command owned by a blocked caller; it is signalled instead of completed.
+  struct SyncCommand : ObsCommandWorker {
+    SyncCommand(std::function<void()>& func) : ObsCommandWorker(nullptr), func(func) {
+      sync = true;
+    }
+    void Execute() override {
+      func();
+      std::lock_guard<std::mutex> lock(done_mutex);
+      done = true;
+      done_cv.notify_all();
+    }
+    std::function<void()> func;
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+  };
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      auto ready = [this] { return !running || HasWork() || Expired(); };
+      if (deadlines.empty())
+        cv.wait(lock, ready);
+      else
+        cv.wait_until(lock, deadlines.begin()->first, ready);
+      if (!running)
+        break;
+
+      if (Expired()) {
+        ObsCommandWorker* worker = deadlines.begin()->second;
+        deadlines.erase(deadlines.begin());
+        worker->settled = true;
+        lock.unlock();
+        worker->OnTimeout();
+        lock.lock();
+        Post(worker);
+        continue;
+      }
+      if (!HasWork())
+        continue;
+
+      ObsCommandWorker* worker = nullptr;
+      for (auto& queue : queues) {
+        if (!queue.empty()) {
+          worker = queue.front();
+          queue.pop_front();
+          break;
+        }
+      }
+
+      // A sync command may be gone as soon as it has run.
+      if (worker->sync) {
+        lock.unlock();
+        worker->Execute();
+        lock.lock();
+        continue;
+      }
+
+      worker->executing = true;
+      lock.unlock();
+      worker->Execute();
+      lock.lock();
+      worker->executing = false;
+      if (!worker->deferred || worker->settled)
+        Post(worker);
+    }
+  }
+
+  bool HasWork() const {
+    for (const auto& queue : queues)
+      if (!queue.empty())
+        return true;
+    return false;
+  }
+
+  bool Expired() const {
+    return !deadlines.empty() && deadlines.begin()->first <= std::chrono::steady_clock::now();
+  }
+
+  // Hands a finished command to the JS thread. Caller holds mutex. The call
+  // only fails while the environment is torn down; the worker holds N-API
+  // handles, which must not be released off the JS thread, so it is leaked.
+  void Post(ObsCommandWorker* worker) {
+    if (running)
+      completions.NonBlockingCall(worker, Complete);
+  }
+
+  static void Complete(Napi::Env env, Napi::Function, ObsCommandWorker* worker);
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<ObsCommandWorker*> queues[COMMAND_PRIORITIES];
+  std::multimap<std::chrono::steady_clock::time_point, ObsCommandWorker*> deadlines;
+  bool running = false;
+  size_t in_flight = 0;
+  Napi::ThreadSafeFunction completions;
+  std::thread thread;
+};
+
+static ObsCommandQueue obs_commands;
+
+void ObsCommandQueue::Complete(Napi::Env env, Napi::Function, ObsCommandWorker* worker) {
+  if (worker->failed)
+    worker->OnError(Napi::Error::New(env, worker->error));
+  else
+    worker->OnOK();
+  delete worker;
+
+  if (--obs_commands.in_flight == 0)
+    obs_commands.completions.Unref(env);
+}
+
+void ObsCommandWorker::Queue(ObsPriority priority) {
+  obs_commands.Push(this, priority);
+}
+
+void ObsCommandWorker::Defer(std::chrono::milliseconds timeout) {
+  obs_commands.Defer(this, timeout);
+}
+
+void ObsCommandWorker::Finish() {
+  obs_commands.Finish(this);
+}
+
+// Command without a promise, for libobs calls that JS does not wait on.
+// The task and everything it captured are destroyed on the command thread.
+// done, if given, runs on the JS thread once the task has run, or instead of
+// it when the queue has stopped; like the task it creates no JS values.
+class ObsTaskWorker : public ObsCommandWorker {
+public:
+  static void Post(napi_env env, std::function<void()> task,
+      ObsPriority priority = ObsPriority::NORMAL, std::function<void()> done = nullptr) {
+    (new ObsTaskWorker(env, task, done))->Queue(priority);
+  }
+
+protected:
+  void Execute() override {
+    task();
+    task = nullptr;
+  }
+
+  virtual void OnOK() override {
+    if (done)
+      done();
+  }
+
+  // Nobody waits on a task, and it may be posted from a finalizer, where no
+  // JS values can be created.
+  void OnDropped() override {
+    if (done)
+      done();
+  }
+
+private:
+  ObsTaskWorker(napi_env env, std::function<void()>& task, std::function<void()>& done) :
+    ObsCommandWorker(env),
+    task(task),
+    done(done) { }
+
+  std::function<void()> task;
+  std::function<void()> done;
+};
+
+
+obs_video_info create_ovi(
+    size_t adapter = DEFAULT_VIDEO_ADAPTER,
+    const char* graphics_module = DEFAULT_MODULE,
+    const enum video_format output_format = DEFAULT_VIDEO_FORMAT,
+    size_t fps_num = DEFAULT_VIDEO_FPS_NUM,
+    size_t fps_den = DEFAULT_VIDEO_FPS_DEN,
+    size_t base_width = DEFAULT_VIDEO_WIDTH,
+    size_t base_height = DEFAULT_VIDEO_HEIGHT,
+    size_t output_width = DEFAULT_VIDEO_WIDTH,
+    size_t output_height = DEFAULT_VIDEO_HEIGHT,
+    bool gpu_conversion = DEFAULT_VIDEO_GPU_CONVERSION,
+    const enum video_colorspace colorspace = DEFAULT_VIDEO_COLORSPACE,
+    const enum video_range_type range = DEFAULT_VIDEO_RANGE,
+    const enum obs_scale_type scale_type = DEFAULT_VIDEO_SCALE_TYPE
+    ) 
+{
+    struct obs_video_info ovi;
+
+    ovi.adapter = adapter;
+    ovi.graphics_module = graphics_module;
+    ovi.output_format = output_format;
+    ovi.fps_num = fps_num;
+    ovi.fps_den = fps_den;
+    ovi.base_width = base_width;
+    ovi.base_height = base_height;
+    ovi.output_width = output_width;
+    ovi.output_height = output_height;
+    ovi.gpu_conversion = gpu_conversion;
+    ovi.colorspace = colorspace;
+    ovi.range = range;
+    ovi.scale_type = scale_type;
+
+    return ovi;
+}
+
+obs_audio_info create_oai(
+  size_t samples_per_sec = DEFAULT_AUDIO_SAMPLES,
+  const enum speaker_layout speakers = DEFAULT_AUDIO_CHANNELS) 
+{
+    struct obs_audio_info oai;
+
+    oai.samples_per_sec = samples_per_sec;
+    oai.speakers = speakers;
+
+    return oai;
+}
+
+// Encoder and output type catalog
+// Built once after modules are loaded and rebuilt only when a module is
+// loaded later; getCodecs()/getOutputs() read it without touching libobs.
+struct ObsEncoderTypeInfo {
+  std::string id;
+  std::string name;
+  std::string codec;
+  enum obs_encoder_type type;
+  uint32_t caps;
+  bool hardware;
+};
+
+struct ObsOutputTypeInfo {
+  std::string id;
+  std::string name;
+  uint32_t flags;
+};
+
+static std::mutex catalog_mutex;
+static std::vector<ObsEncoderTypeInfo> encoder_catalog;
+static std::vector<ObsOutputTypeInfo> output_catalog;
+
+static const char* const HARDWARE_ENCODER_IDS[] = {
+  "nvenc", "qsv", "amf", "vaapi", "videotoolbox",
+};
+
+// libobs has no hardware flag for encoder types; texture-based encoders and
+// the known hardware encoder families are reported as hardware-backed.
+static bool isHardwareEncoder(const std::string& id, uint32_t caps) {
+  if (caps & OBS_ENCODER_CAP_PASS_TEXTURE)
+    return true;
+  if (id.find("videotoolbox") != std::string::npos)
+    return id.find(".gva") != std::string::npos || id.find(".ave.") != std::string::npos;
+  for (const char* family : HARDWARE_ENCODER_IDS)
+    if (id.find(family) != std::string::npos)
+      return true;
+  return false;
+}
+
+static void rebuildCatalog() {
+  std::vector<ObsEncoderTypeInfo> encoders;
+  std::vector<ObsOutputTypeInfo> outputs;
+  const char* id = nullptr;
+
+  for (size_t i = 0; obs_enum_encoder_types(i, &id); i++) {
+    ObsEncoderTypeInfo encoder;
+    const char* name = obs_encoder_get_display_name(id);
+    const char* codec = obs_get_encoder_codec(id);
+    encoder.id = id;
+    encoder.name = name ? name : id;
+    encoder.codec = codec ? codec : "";
+    encoder.type = obs_get_encoder_type(id);
+    encoder.caps = obs_get_encoder_caps(id);
+    encoder.hardware = encoder.type == OBS_ENCODER_VIDEO && isHardwareEncoder(encoder.id, encoder.caps);
+    encoders.push_back(encoder);
+  }
+
+  for (size_t i = 0; obs_enum_output_types(i, &id); i++) {
+    ObsOutputTypeInfo output;
+    const char* name = obs_output_get_display_name(id);
+    output.id = id;
+    output.name = name ? name : id;
+    output.flags = obs_get_output_flags(id);
+    outputs.push_back(output);
+  }
+
+  std::lock_guard<std::mutex> lock(catalog_mutex);
+  encoder_catalog.swap(encoders);
+  output_catalog.swap(outputs);
+}
+
+static std::vector<ObsEncoderTypeInfo> encoderCatalog() {
+  std::lock_guard<std::mutex> lock(catalog_mutex);
+  return encoder_catalog;
+}
+
+// Lists encoder types:
+//   [{ id, name, type: "video"|"audio", codec, hardware,
+//      caps: { deprecated, passTexture, dynamicBitrate, internal } }]
+//
+Napi::Value obsGetCodecs(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!initReady()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::lock_guard<std::mutex> lock(catalog_mutex);
+  Napi::Array codecs = Napi::Array::New(env, encoder_catalog.size());
+  for (size_t i = 0; i < encoder_catalog.size(); i++) {
+    const ObsEncoderTypeInfo& encoder = encoder_catalog[i];
+
+    Napi::Object caps = Napi::Object::New(env);
+    caps.Set("deprecated", Napi::Boolean::New(env, encoder.caps & OBS_ENCODER_CAP_DEPRECATED));
+    caps.Set("passTexture", Napi::Boolean::New(env, encoder.caps & OBS_ENCODER_CAP_PASS_TEXTURE));
+    caps.Set("dynamicBitrate", Napi::Boolean::New(env, encoder.caps & OBS_ENCODER_CAP_DYN_BITRATE));
+    caps.Set("internal", Napi::Boolean::New(env, encoder.caps & OBS_ENCODER_CAP_INTERNAL));
+
+    Napi::Object item = Napi::Object::New(env);
+    item.Set("id", Napi::String::New(env, encoder.id));
+    item.Set("name", Napi::String::New(env, encoder.name));
+    item.Set("type", Napi::String::New(env, encoder.type == OBS_ENCODER_VIDEO ? "video" : "audio"));
+    item.Set("codec", Napi::String::New(env, encoder.codec));
+    item.Set("hardware", Napi::Boolean::New(env, encoder.hardware));
+    item.Set("caps", caps);
+    codecs.Set(i, item);
+  }
+
+  return codecs;
+}
+
+// Lists output types:
+//   [{ id, name, flags: { video, audio, encoded, service, multiTrack } }]
+//
+Napi::Value obsGetOutputs(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!initReady()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::lock_guard<std::mutex> lock(catalog_mutex);
+  Napi::Array outputs = Napi::Array::New(env, output_catalog.size());
+  for (size_t i = 0; i < output_catalog.size(); i++) {
+    const ObsOutputTypeInfo& output = output_catalog[i];
+
+    Napi::Object flags = Napi::Object::New(env);
+    flags.Set("video", Napi::Boolean::New(env, output.flags & OBS_OUTPUT_VIDEO));
+    flags.Set("audio", Napi::Boolean::New(env, output.flags & OBS_OUTPUT_AUDIO));
+    flags.Set("encoded", Napi::Boolean::New(env, output.flags & OBS_OUTPUT_ENCODED));
+    flags.Set("service", Napi::Boolean::New(env, output.flags & OBS_OUTPUT_SERVICE));
+    flags.Set("multiTrack", Napi::Boolean::New(env, output.flags & OBS_OUTPUT_MULTI_TRACK));
+
+    Napi::Object item = Napi::Object::New(env);
+    item.Set("id", Napi::String::New(env, output.id));
+    item.Set("name", Napi::String::New(env, output.name));
+    item.Set("flags", flags);
+    outputs.Set(i, item);
+  }
+
+  return outputs;
+}
+
+// Module loading
+// Modules are opened one at a time (rather than through obs_load_all_modules)
+// so every id a module registers can be recorded in the module manifest.
+// The manifest is kept on disk and lets later launches load exactly the
+// modules that a list of encoder/output/service/source ids needs, without
+// scanning the plugin directories.
+struct ObsModuleEntry {
+  std::string bin_path;
+  std::string data_path;
+  std::vector<std::string> encoders;
+  std::vector<std::string> outputs;
+  std::vector<std::string> services;
+  std::vector<std::string> sources;
+};
+
+struct ObsTypeSet {
+  std::set<std::string> encoders;
+  std::set<std::string> outputs;
+  std::set<std::string> services;
+  std::set<std::string> sources;
+};
+
+static std::mutex module_mutex;
+static std::map<std::string, ObsModuleEntry> module_manifest;
+static std::set<std::string> loaded_modules;
+static std::string manifest_path;
+static std::string config_dir;
+
+// Module name as OBS reports it: the binary file name without extension.
+static std::string moduleNameFromPath(const std::string& bin_path) {
+  size_t slash = bin_path.find_last_of("/\\");
+  std::string name = slash == std::string::npos ? bin_path : bin_path.substr(slash + 1);
+  size_t dot = name.find_last_of('.');
+  return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static ObsTypeSet enumTypes() {
+  ObsTypeSet types;
+  const char* id = nullptr;
+
+  for (size_t i = 0; obs_enum_encoder_types(i, &id); i++)
+    types.encoders.insert(id);
+  for (size_t i = 0; obs_enum_output_types(i, &id); i++)
+    types.outputs.insert(id);
+  for (size_t i = 0; obs_enum_service_types(i, &id); i++)
+    types.services.insert(id);
+  for (size_t i = 0; obs_enum_source_types(i, &id); i++)
+    types.sources.insert(id);
+
+  return types;
+}
+
+static std::vector<std::string> addedTypes(const std::set<std::string>& before,
+    const std::set<std::string>& after) {
+  std::vector<std::string> added;
+  for (const std::string& id : after)
+    if (!before.count(id))
+      added.push_back(id);
+  return added;
+}
+
+static void setIdArray(obs_data_t* data, const char* key, const std::vector<std::string>& ids) {
+  obs_data_array_t* array = obs_data_array_create();
+  for (const std::string& id : ids) {
+    obs_data_t* item = obs_data_create();
+    obs_data_set_string(item, "id", id.c_str());
+    obs_data_array_push_back(array, item);
+    obs_data_release(item);
+  }
+  obs_data_set_array(data, key, array);
+  obs_data_array_release(array);
+}
+
+static std::vector<std::string> getIdArray(obs_data_t* data, const char* key) {
+  std::vector<std::string> ids;
+  obs_data_array_t* array = obs_data_get_array(data, key);
+  for (size_t i = 0; i < obs_data_array_count(array); i++) {
+    obs_data_t* item = obs_data_array_item(array, i);
+    ids.push_back(obs_data_get_string(item, "id"));
+    obs_data_release(item);
+  }
+  obs_data_array_release(array);
+  return ids;
+}
+
+// Reads the manifest from manifest_path. Caller holds module_mutex.
+static void loadManifest() {
+  module_manifest.clear();
+  if (manifest_path.empty())
+    return;
+
+  obs_data_t* root = obs_data_create_from_json_file_safe(manifest_path.c_str(), "bak");
+  if (!root)
+    return;
+
+  obs_data_array_t* modules = obs_data_get_array(root, "modules");
+  for (size_t i = 0; i < obs_data_array_count(modules); i++) {
+    obs_data_t* item = obs_data_array_item(modules, i);
+    ObsModuleEntry entry;
+    entry.bin_path = obs_data_get_string(item, "bin_path");
+    entry.data_path = obs_data_get_string(item, "data_path");
+    entry.encoders = getIdArray(item, "encoders");
+    entry.outputs = getIdArray(item, "outputs");
+    entry.services = getIdArray(item, "services");
+    entry.sources = getIdArray(item, "sources");
+    module_manifest[obs_data_get_string(item, "name")] = entry;
+    obs_data_release(item);
+  }
+  obs_data_array_release(modules);
+  obs_data_release(root);
+}
+
+// Writes the manifest to manifest_path. Caller holds module_mutex.
+static void saveManifest() {
+  if (manifest_path.empty())
+    return;
+
+  obs_data_t* root = obs_data_create();
+  obs_data_array_t* modules = obs_data_array_create();
+  for (const auto& kv : module_manifest) {
+    obs_data_t* item = obs_data_create();
+    obs_data_set_string(item, "name", kv.first.c_str());
+    obs_data_set_string(item, "bin_path", kv.second.bin_path.c_str());
+    obs_data_set_string(item, "data_path", kv.second.data_path.c_str());
+    setIdArray(item, "encoders", kv.second.encoders);
+    setIdArray(item, "outputs", kv.second.outputs);
+    setIdArray(item, "services", kv.second.services);
+    setIdArray(item, "sources", kv.second.sources);
+    obs_data_array_push_back(modules, item);
+    obs_data_release(item);
+  }
+  obs_data_set_array(root, "modules", modules);
+  obs_data_array_release(modules);
+
+  if (!obs_data_save_json_safe(root, manifest_path.c_str(), "tmp", "bak"))
+    blog(LOG_WARNING, "obsapi: could not write module manifest to %s", manifest_path.c_str());
+  obs_data_release(root);
+}
+
+static void findModuleCallback(void* param, const struct obs_module_info* info) {
+  auto* found = (std::map<std::string, ObsModuleEntry>*)param;
+  ObsModuleEntry entry;
+  entry.bin_path = info->bin_path;
+  entry.data_path = info->data_path ? info->data_path : "";
+  (*found)[moduleNameFromPath(entry.bin_path)] = entry;
+}
+
+// Lists the modules present in the OBS module paths without opening them.
+static std::map<std::string, ObsModuleEntry> findModules() {
+  std::map<std::string, ObsModuleEntry> found;
+  obs_find_modules(findModuleCallback, &found);
+  return found;
+}
+
+// Opens and initializes one module, recording the ids it registers.
+// Caller holds module_mutex.
+static bool loadModuleFile(const std::string& name, const std::string& bin_path,
+    const std::string& data_path, std::string& error) {
+  if (loaded_modules.count(name))
+    return true;
+
+  ObsTypeSet before = enumTypes();
+
+  obs_module_t* module = nullptr;
+  int code = obs_open_module(&module, bin_path.c_str(),
+      data_path.empty() ? nullptr : data_path.c_str());
+  if (code != MODULE_SUCCESS) {
+    error = "Error: could not open module " + name + " (code " + std::to_string(code) + ")";
+    return false;
+  }
+
+  if (!obs_init_module(module)) {
+    error = "Error: could not initialize module " + name;
+    return false;
+  }
+
+  ObsTypeSet after = enumTypes();
+
+  ObsModuleEntry& entry = module_manifest[name];
+  entry.bin_path = bin_path;
+  entry.data_path = data_path;
+  entry.encoders = addedTypes(before.encoders, after.encoders);
+  entry.outputs = addedTypes(before.outputs, after.outputs);
+  entry.services = addedTypes(before.services, after.services);
+  entry.sources = addedTypes(before.sources, after.sources);
+
+  loaded_modules.insert(name);
+  return true;
+}
+
+// Loads every module in the module paths and rebuilds the manifest.
+// Caller holds module_mutex.
+static void loadAllModules() {
+  module_manifest.clear();
+
+  for (const auto& kv : findModules()) {
+    std::string error;
+    if (!loadModuleFile(kv.first, kv.second.bin_path, kv.second.data_path, error))
+      blog(LOG_WARNING, "obsapi: %s", error.c_str());
+  }
+
+  saveManifest();
+}
+
+// Loads the named modules, using the manifest paths when they are still valid
+// and scanning the module paths only for names the manifest does not know.
+// Caller holds module_mutex.
+static bool loadModulesByName(const std::vector<std::string>& names, std::string& error) {
+  std::map<std::string, ObsModuleEntry> found;
+  bool scanned = false;
+
+  for (const std::string& name : names) {
+    auto it = module_manifest.find(name);
+    if (it != module_manifest.end() && os_file_exists(it->second.bin_path.c_str())) {
+      ObsModuleEntry entry = it->second;
+      if (!loadModuleFile(name, entry.bin_path, entry.data_path, error))
+        return false;
+      continue;
+    }
+
+    if (!scanned) {
+      found = findModules();
+      scanned = true;
+    }
+
+    auto f = found.find(name);
+    if (f == found.end()) {
+      error = "Error: module not found: " + name;
+      return false;
+    }
+    if (!loadModuleFile(name, f->second.bin_path, f->second.data_path, error))
+      return false;
+  }
+
+  saveManifest();
+  return true;
+}
+
+// Loads the modules providing the given ids. If the manifest cannot resolve
+// every id, falls back to loading all modules, which refreshes the manifest.
+// Caller holds module_mutex.
+static bool loadModulesForIds(const std::vector<std::string>& ids,
+    bool& manifest_hit, std::string& error) {
+  std::set<std::string> names;
+
+  for (const std::string& id : ids) {
+    bool resolved = false;
+    for (const auto& kv : module_manifest) {
+      const ObsModuleEntry& entry = kv.second;
+      for (const auto* list : { &entry.encoders, &entry.outputs, &entry.services, &entry.sources }) {
+        if (std::find(list->begin(), list->end(), id) != list->end()) {
+          resolved = os_file_exists(entry.bin_path.c_str());
+          break;
+        }
+      }
+      if (resolved) {
+        names.insert(kv.first);
+        break;
+      }
+    }
+
+    if (!resolved) {
+      manifest_hit = false;
+      loadAllModules();
+      return true;
+    }
+  }
+
+  manifest_hit = true;
+  return loadModulesByName(std::vector<std::string>(names.begin(), names.end()), error);
+}
+
+// Reads an optional array of strings from a JS options object.
+// Returns false if the property exists but is not an array of strings.
+static bool getStringArray(const Napi::Object& obj, const char* key, std::vector<std::string>& out) {
+  if (!obj.Has(key))
+    return true;
+
+  Napi::Value value = obj.Get(key);
+  if (!value.IsArray())
+    return false;
+
+  Napi::Array array = value.As<Napi::Array>();
+  for (uint32_t i = 0; i < array.Length(); i++) {
+    Napi::Value item = array.Get(i);
+    if (!item.IsString())
+      return false;
+    out.push_back(item.As<Napi::String>());
+  }
+  return true;
+}
+
+// Reads an optional string from a JS options object.
+// Returns false if the property exists but is not a string.
+static bool getString(const Napi::Object& obj, const char* key, std::string& out) {
+  if (!obj.Has(key))
+    return true;
+
+  Napi::Value value = obj.Get(key);
+  if (!value.IsString())
+    return false;
+
+  out = value.As<Napi::String>();
+  return true;
+}
+
+// Profiler
+// With initialize({ profiler: true }) the libobs profiler runs for the whole
+// session with its own name store, so the video, render, output and encoder
+// scopes record their times. profilerCsvPath (implies profiler) dumps the
+// final snapshot to a CSV file on shutdown.
+//
+// JS: getProfilerSnapshot() -> Promise<[entry]>
+//     entry: { name, calls, minMs, maxMs, meanMs, p50Ms, p90Ms, p99Ms,
+//              expectedIntervalMs?, interval?: { minMs, maxMs, meanMs, p50Ms, p90Ms, p99Ms },
+//              children: [entry] }
+static profiler_name_store_t* profiler_names = nullptr;
+static std::string profiler_csv_path;
+
+// Starts the profiler before obs_startup. Runs on the command thread.
+static void startProfiler(const std::string& csv_path) {
+  if (profiler_names)
+    return;
+  profiler_names = profiler_name_store_create();
+  profiler_csv_path = csv_path;
+  profiler_start();
+}
+
+// Stops the profiler after obs_shutdown, writing the CSV if one was asked for.
+// Runs on the command thread.
+static void stopProfiler() {
+  if (!profiler_names)
+    return;
+
+  profiler_stop();
+  if (!profiler_csv_path.empty()) {
+    profiler_snapshot_t* snapshot = profile_snapshot_create();
+    if (!profiler_snapshot_dump_csv(snapshot, profiler_csv_path.c_str()))
+      blog(LOG_WARNING, "obsapi: could not write profiler snapshot to %s",
+          profiler_csv_path.c_str());
+    profile_snapshot_free(snapshot);
+  }
+  profiler_free();
+  profiler_name_store_free(profiler_names);
+  profiler_names = nullptr;
+  profiler_csv_path.clear();
+}
+
+// Distribution of one set of profiler times, in milliseconds.
+struct ObsProfileTimes {
+  uint64_t calls = 0;
+  double min_ms = 0;
+  double max_ms = 0;
+  double mean_ms = 0;
+  double p50_ms = 0;
+  double p90_ms = 0;
+  double p99_ms = 0;
+};
+
+struct ObsProfileEntry {
+  std::string name;
+  ObsProfileTimes times;
+  double expected_interval_ms = 0;
+  ObsProfileTimes interval;
+  std::vector<ObsProfileEntry> children;
+};
+
+// Derives the distribution from a profiler histogram of (microseconds, count).
+static ObsProfileTimes profileTimes(profiler_time_entries_t* entries) {
+  ObsProfileTimes times;
+  std::vector<profiler_time_entry> sorted(entries->array, entries->array + entries->num);
+  std::sort(sorted.begin(), sorted.end(),
+      [](const profiler_time_entry& a, const profiler_time_entry& b) {
+        return a.time_delta < b.time_delta;
+      });
+
+  double sum_us = 0;
+  for (const profiler_time_entry& entry : sorted) {
+    times.calls += entry.count;
+    sum_us += (double)entry.time_delta * entry.count;
+  }
+  if (!times.calls)
+    return times;
+
+  times.min_ms = (double)sorted.front().time_delta / 1000.0;
+  times.max_ms = (double)sorted.back().time_delta / 1000.0;
+  times.mean_ms = sum_us / times.calls / 1000.0;
+
+  const double ranks[] = { 0.5, 0.9, 0.99 };
+  double* percentiles[] = { &times.p50_ms, &times.p90_ms, &times.p99_ms };
+  uint64_t seen = 0;
+  size_t next = 0;
+  for (const profiler_time_entry& entry : sorted) {
+    seen += entry.count;
+    while (next < 3 && seen >= (uint64_t)std::ceil(ranks[next] * times.calls))
+      *percentiles[next++] = (double)entry.time_delta / 1000.0;
+  }
+  return times;
+}
+
+static bool collectProfileEntry(void* data, profiler_snapshot_entry_t* snapshot_entry) {
+  std::vector<ObsProfileEntry>& entries = *(std::vector<ObsProfileEntry>*)data;
+  entries.emplace_back();
+  ObsProfileEntry& entry = entries.back();
+
+  const char* name = profiler_snapshot_entry_name(snapshot_entry);
+  entry.name = name ? name : "";
+  entry.times = profileTimes(profiler_snapshot_entry_times(snapshot_entry));
+  entry.expected_interval_ms =
+      (double)profiler_snapshot_entry_expected_time_between_calls(snapshot_entry) / 1000.0;
+  if (entry.expected_interval_ms > 0)
+    entry.interval = profileTimes(profiler_snapshot_entry_times_between_calls(snapshot_entry));
+
+  profiler_snapshot_enumerate_children(snapshot_entry, collectProfileEntry, &entry.children);
+  return true;
+}
+
+static Napi::Object profileTimesToJs(Napi::Env env, const ObsProfileTimes& times,
+    Napi::Object object) {
+  object.Set("minMs", Napi::Number::New(env, times.min_ms));
+  object.Set("maxMs", Napi::Number::New(env, times.max_ms));
+  object.Set("meanMs", Napi::Number::New(env, times.mean_ms));
+  object.Set("p50Ms", Napi::Number::New(env, times.p50_ms));
+  object.Set("p90Ms", Napi::Number::New(env, times.p90_ms));
+  object.Set("p99Ms", Napi::Number::New(env, times.p99_ms));
+  return object;
+}
+
+static Napi::Array profileEntriesToJs(Napi::Env env, const std::vector<ObsProfileEntry>& entries) {
+  Napi::Array result = Napi::Array::New(env, entries.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    const ObsProfileEntry& entry = entries[i];
+    Napi::Object item = Napi::Object::New(env);
+    item.Set("name", Napi::String::New(env, entry.name));
+    item.Set("calls", Napi::Number::New(env, (double)entry.times.calls));
+    profileTimesToJs(env, entry.times, item);
+    if (entry.expected_interval_ms > 0) {
+      item.Set("expectedIntervalMs", Napi::Number::New(env, entry.expected_interval_ms));
+      item.Set("interval", profileTimesToJs(env, entry.interval, Napi::Object::New(env)));
+    }
+    item.Set("children", profileEntriesToJs(env, entry.children));
+    result.Set(i, item);
+  }
+  return result;
+}
+
+// Asynchronously takes a profiler snapshot. Queued ahead of normal commands
+// so a busy command thread does not skew it.
+//
+class AsyncProfilerSnapshotWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncProfilerSnapshotWorker* worker = new AsyncProfilerSnapshotWorker(env);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue(ObsPriority::HIGH);
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    if (!profiler_names) {
+      SetError("Error: the profiler is not enabled; pass { profiler: true } to initialize()");
+      return;
+    }
+
+    profiler_snapshot_t* snapshot = profile_snapshot_create();
+    profiler_snapshot_enumerate_roots(snapshot, collectProfileEntry, &entries);
+    profile_snapshot_free(snapshot);
+  }
+
+  virtual void OnOK() override {
+    deferredPromise.Resolve(profileEntriesToJs(Env(), entries));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncProfilerSnapshotWorker(napi_env env) :
+    ObsCommandWorker(env),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  std::vector<ObsProfileEntry> entries;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+struct ObsProfile;
+static bool readProfile(const std::string& path, std::shared_ptr<ObsProfile>& profile,
+    std::string& error);
+static std::vector<std::string> profileIds(const ObsProfile& profile);
+static bool applyProfile(ObsProfile& profile, std::string& error);
+static Napi::Object profileToJs(Napi::Env env, ObsProfile& profile);
+static bool getAdapter(const Napi::Object& obj, const char* key, int32_t& out);
+static void setSessionGraphics(int32_t adapter, const std::string& module);
+
+// Set by initialize({ debugObjects: true }) for the session.
+static std::atomic<bool> debug_objects{false};
+
+// Asynchronously initializes the OBS core context.
+// The whole init sequence (startup, module loading, post-load) runs in
+// Execute() so the JS thread never blocks on it. The promise resolves with
+// the version string and the duration of every phase in milliseconds.
+// Calling initialize() again while starting or ready returns the same promise.
+//
+// Options (all optional):
+//   locale:       Locale used by modules (default "en-US")
+//   configPath:   Module config directory; the module manifest is kept here
+//   manifestPath: Explicit location of the module manifest
+//   modules:      Load only these module names (e.g. ["obs-outputs"])
+//   ids:          Load only the modules providing these encoder/output/
+//                 service/source ids, resolved through the manifest
+//   profiler:     Run the libobs profiler for getProfilerSnapshot()
+//   profilerCsvPath:
+//                 Also dump the profiler snapshot to this CSV on shutdown
+//   profile:      Apply this saveProfile() file once started; the result
+//                 then carries the loadProfile() result as profile
+//   debugObjects: Name live libobs objects in getMemoryStats() and report
+//                 the ones left over as leaked on shutdown
+//   adapter:      Graphics adapter index from getAdapters(), or 'auto'
+//                 (default) to prefer the GPU of the hardware encoder
+//   graphicsModule:
+//                 libobs-d3d11 (Windows default) or libobs-opengl
+// Without modules or ids every module is loaded and the manifest rebuilt,
+// unless a profile is given: its encoder, output and service ids are loaded.
+class AsyncInitializeWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (initRequested())
+      return ready_promise.Value();
+
+    AsyncInitializeWorker* worker = new AsyncInitializeWorker(info.Env());
+
+    if (info.Length() > 0 && !info[0].IsUndefined()) {
+      if (!info[0].IsObject()) {
+        delete worker;
+        Napi::TypeError::New(env, "Expected an optional options object")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+      }
+
+      Napi::Object options = info[0].As<Napi::Object>();
+      if (!getString(options, "locale", worker->locale) ||
+          !getString(options, "configPath", worker->config_path) ||
+          !getString(options, "manifestPath", worker->manifest) ||
+          !getStringArray(options, "modules", worker->modules) ||
+          !getStringArray(options, "ids", worker->ids) ||
+          !getString(options, "profilerCsvPath", worker->profiler_csv) ||
+          !getString(options, "profile", worker->profile_path) ||
+          !getAdapter(options, "adapter", worker->adapter) ||
+          !getString(options, "graphicsModule", worker->graphics_module)) {
+        delete worker;
+        Napi::TypeError::New(env, "Invalid initialize options")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      worker->profiler = !worker->profiler_csv.empty() ||
+          (options.Has("profiler") && options.Get("profiler").ToBoolean());
+      worker->debug = options.Has("debugObjects") &&
+          options.Get("debugObjects").ToBoolean();
+    }
+
+    if (worker->manifest.empty() && !worker->config_path.empty())
+      worker->manifest = worker->config_path + "/" + MANIFEST_FILE_NAME;
+
+    setInitState(ObsInitState::STARTING);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    ready_promise = Napi::Persistent(promise);
+    ready_promise.SuppressDestruct();
+
+    worker->Queue(ObsPriority::HIGH);
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    auto begin = std::chrono::steady_clock::now();
+    auto phase = begin;
+
+    //   :param  locale:             The locale to use for modules
+    //                               (E.G. "en-US")
+    //   :param  module_config_path: Path to module config storage directory
+    //                               (or *NULL* if none)
+    //   :param  store:              The profiler name store for OBS to use or NULL
+    if (!config_path.empty())
+      os_mkdirs(config_path.c_str());
+    if (profiler)
+      startProfiler(profiler_csv);
+    debug_objects = debug;
+    setSessionGraphics(adapter, graphics_module);
+    if (!obs_startup(locale.c_str(), config_path.empty() ? nullptr : config_path.c_str(),
+        profiler_names) || !obs_initialized()) {
+      stopProfiler();
+      setInitState(ObsInitState::FAILED, STARTUP_FAILED_STRING);
+      SetError(STARTUP_FAILED_STRING);
+      return;
+    }
+    startup_ms = elapsedMs(phase);
+
+    std::string error;
+    if (!profile_path.empty()) {
+      if (!readProfile(profile_path, profile, error)) {
+        fail(error);
+        return;
+      }
+      if (modules.empty() && ids.empty())
+        ids = profileIds(*profile);
+    }
+
+    phase = std::chrono::steady_clock::now();
+    bool ok = true;
+    {
+      std::lock_guard<std::mutex> lock(module_mutex);
+
+      manifest_path = manifest;
+      config_dir = config_path;
+      loadManifest();
+
+      if (!modules.empty())
+        ok = loadModulesByName(modules, error);
+      else if (!ids.empty())
+        ok = loadModulesForIds(ids, manifest_hit, error);
+      else
+        loadAllModules();
+
+      if (ok)
+        loaded.assign(loaded_modules.begin(), loaded_modules.end());
+    }
+    if (!ok) {
+      fail(error);
+      return;
+    }
+    load_modules_ms = elapsedMs(phase);
+
+    phase = std::chrono::steady_clock::now();
+    obs_post_load_modules();
+    rebuildCatalog();
+    post_load_ms = elapsedMs(phase);
+
+    phase = std::chrono::steady_clock::now();
+    if (profile && !applyProfile(*profile, error)) {
+      profile.reset();
+      fail(error);
+      return;
+    }
+    profile_ms = elapsedMs(phase);
+
+    total_ms = elapsedMs(begin);
+    result = "v" + std::string(obs_get_version_string());
+
+    setInitState(ObsInitState::READY);
+  }
+
+  virtual void OnOK() override {
+      Napi::Env env = Env();
+      Napi::Object timings = Napi::Object::New(env);
+      timings.Set("startup", Napi::Number::New(env, startup_ms));
+      timings.Set("loadModules", Napi::Number::New(env, load_modules_ms));
+      timings.Set("postLoad", Napi::Number::New(env, post_load_ms));
+      if (profile)
+        timings.Set("profile", Napi::Number::New(env, profile_ms));
+      timings.Set("total", Napi::Number::New(env, total_ms));
+
+      Napi::Array names = Napi::Array::New(env, loaded.size());
+      for (size_t i = 0; i < loaded.size(); i++)
+        names.Set(i, Napi::String::New(env, loaded[i]));
+
+      Napi::Object info = Napi::Object::New(env);
+      info.Set("version", Napi::String::New(env, result));
+      info.Set("timings", timings);
+      info.Set("modules", names);
+      info.Set("manifestHit", Napi::Boolean::New(env, manifest_hit));
+      if (profile)
+        info.Set("profile", profileToJs(env, *profile));
+      deferredPromise.Resolve(info);
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+      deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncInitializeWorker(napi_env env) :
+    ObsCommandWorker(env),
+    result(),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  // Shuts the half-started core down again and fails initialization.
+  void fail(const std::string& error) {
+    obs_shutdown();
+    stopProfiler();
+    {
+      std::lock_guard<std::mutex> lock(module_mutex);
+      loaded_modules.clear();
+    }
+    setInitState(ObsInitState::FAILED, error);
+    SetError(error);
+  }
+
+  std::string result;
+  std::string locale = DEFAULT_LOCALE;
+  std::string config_path;
+  std::string manifest;
+  std::vector<std::string> modules;
+  std::vector<std::string> ids;
+  std::vector<std::string> loaded;
+  bool profiler = false;
+  bool debug = false;
+  int32_t adapter = ADAPTER_AUTO;
+  std::string graphics_module = DEFAULT_MODULE;
+  std::string profiler_csv;
+  std::string profile_path;
+  std::shared_ptr<ObsProfile> profile;
+  bool manifest_hit = false;
+  double startup_ms = 0;
+  double load_modules_ms = 0;
+  double post_load_ms = 0;
+  double profile_ms = 0;
+  double total_ms = 0;
+
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Returns the promise shared by every caller waiting for initialization.
+//
+Napi::Value obsReady(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (ready_promise.IsEmpty()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return ready_promise.Value();
+}
+
+// Asynchronously loads a single module on demand and records it in the manifest.
+// Resolves with the ids the module provides.
+// Note: obs_post_load_modules is not re-run for modules loaded this way.
+//
+class AsyncLoadModuleWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    if (info.Length() != 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected a single string argument")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    std::string input = info[0].As<Napi::String>();
+
+    AsyncLoadModuleWorker* worker = new AsyncLoadModuleWorker(info.Env(), input);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error)) {
+      SetError(error);
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(module_mutex);
+    if (!loadModulesByName({ input }, error)) {
+      SetError(error);
+      return;
+    }
+    entry = module_manifest[input];
+    rebuildCatalog();
+  }
+
+  virtual void OnOK() override {
+      Napi::Env env = Env();
+      Napi::Object result = Napi::Object::New(env);
+      result.Set("name", Napi::String::New(env, input));
+      result.Set("encoders", toArray(env, entry.encoders));
+      result.Set("outputs", toArray(env, entry.outputs));
+      result.Set("services", toArray(env, entry.services));
+      result.Set("sources", toArray(env, entry.sources));
+      deferredPromise.Resolve(result);
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+      deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncLoadModuleWorker(napi_env env, std::string& hint) :
+    ObsCommandWorker(env),
+    input(hint),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  static Napi::Array toArray(Napi::Env env, const std::vector<std::string>& ids) {
+    Napi::Array array = Napi::Array::New(env, ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
+      array.Set(i, Napi::String::New(env, ids[i]));
+    return array;
+  }
+
+  std::string input;
+  ObsModuleEntry entry;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Name <-> enum tables for the structured video configuration.
+template <typename T>
+struct ObsEnumName {
+  const char* name;
+  T value;
+};
+
+static const ObsEnumName<enum video_format> VIDEO_FORMAT_NAMES[] = {
+  { "nv12", VIDEO_FORMAT_NV12 },
+  { "i420", VIDEO_FORMAT_I420 },
+  { "i444", VIDEO_FORMAT_I444 },
+  { "rgba", VIDEO_FORMAT_RGBA },
+  { "bgra", VIDEO_FORMAT_BGRA },
+#if LIBOBS_API_MAJOR_VER >= 28
+  { "p010", VIDEO_FORMAT_P010 },
+  { "i010", VIDEO_FORMAT_I010 },
+#endif
+};
+
+static const ObsEnumName<enum obs_scale_type> SCALE_TYPE_NAMES[] = {
+  { "disable", OBS_SCALE_DISABLE },
+  { "point", OBS_SCALE_POINT },
+  { "bilinear", OBS_SCALE_BILINEAR },
+  { "bicubic", OBS_SCALE_BICUBIC },
+  { "lanczos", OBS_SCALE_LANCZOS },
+  { "area", OBS_SCALE_AREA },
+};
+
+static const ObsEnumName<enum video_colorspace> COLORSPACE_NAMES[] = {
+  { "default", VIDEO_CS_DEFAULT },
+  { "601", VIDEO_CS_601 },
+  { "709", VIDEO_CS_709 },
+#if LIBOBS_API_MAJOR_VER >= 28
+  { "srgb", VIDEO_CS_SRGB },
+  { "2100pq", VIDEO_CS_2100_PQ },
+  { "2100hlg", VIDEO_CS_2100_HLG },
+#endif
+};
+
+static const ObsEnumName<enum video_range_type> RANGE_NAMES[] = {
+  { "default", VIDEO_RANGE_DEFAULT },
+  { "partial", VIDEO_RANGE_PARTIAL },
+  { "full", VIDEO_RANGE_FULL },
+};
+
+static const ObsEnumName<enum speaker_layout> SPEAKER_LAYOUT_NAMES[] = {
+  { "mono", SPEAKERS_MONO },
+  { "stereo", SPEAKERS_STEREO },
+  { "2.1", SPEAKERS_2POINT1 },
+  { "4.0", SPEAKERS_4POINT0 },
+  { "4.1", SPEAKERS_4POINT1 },
+  { "5.1", SPEAKERS_5POINT1 },
+  { "7.1", SPEAKERS_7POINT1 },
+};
+
+// Reads an optional enum given by name. Returns false for unknown names.
+template <typename T, size_t N>
+static bool getEnum(const Napi::Object& obj, const char* key, const ObsEnumName<T> (&names)[N], T& out) {
+  std::string name;
+  if (!obj.Has(key))
+    return true;
+  if (!getString(obj, key, name))
+    return false;
+
+  for (const ObsEnumName<T>& entry : names) {
+    if (name == entry.name) {
+      out = entry.value;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename T, size_t N>
+static const char* enumName(const ObsEnumName<T> (&names)[N], T value) {
+  for (const ObsEnumName<T>& entry : names)
+    if (entry.value == value)
+      return entry.name;
+  return "unknown";
+}
+
+// Reads an optional positive integer. Returns false if present but not a positive number.
+static bool getUint(const Napi::Object& obj, const char* key, uint32_t& out) {
+  if (!obj.Has(key))
+    return true;
+
+  Napi::Value value = obj.Get(key);
+  if (!value.IsNumber() || value.As<Napi::Number>().DoubleValue() <= 0)
+    return false;
+
+  out = value.As<Napi::Number>().Uint32Value();
+  return true;
+}
+
+// Reads an optional number in [min, max].
+static bool getNumber(const Napi::Object& obj, const char* key, double min, double max, double& out) {
+  if (!obj.Has(key))
+    return true;
+
+  Napi::Value value = obj.Get(key);
+  if (!value.IsNumber())
+    return false;
+
+  double number = value.As<Napi::Number>().DoubleValue();
+  if (number < min || number > max)
+    return false;
+
+  out = number;
+  return true;
+}
+
+// Parses the structured video configuration:
+//   { baseWidth, baseHeight, outputWidth, outputHeight, fpsNum, fpsDen,
+//     format, scaleType, colorspace, range, gpuConversion }
+// Settings left out keep their value in ovi; the output size defaults to
+// the base size.
+static bool parseVideoConfig(const Napi::Object& options, struct obs_video_info& ovi) {
+  uint32_t base_width = ovi.base_width;
+  uint32_t base_height = ovi.base_height;
+  uint32_t fps_num = ovi.fps_num;
+  uint32_t fps_den = ovi.fps_den;
+  enum video_format format = ovi.output_format;
+  enum obs_scale_type scale_type = ovi.scale_type;
+  enum video_colorspace colorspace = ovi.colorspace;
+  enum video_range_type range = ovi.range;
+  bool gpu_conversion = ovi.gpu_conversion;
+
+  if (!getUint(options, "baseWidth", base_width) ||
+      !getUint(options, "baseHeight", base_height) ||
+      !getUint(options, "fpsNum", fps_num) ||
+      !getUint(options, "fpsDen", fps_den) ||
+      !getEnum(options, "format", VIDEO_FORMAT_NAMES, format) ||
+      !getEnum(options, "scaleType", SCALE_TYPE_NAMES, scale_type) ||
+      !getEnum(options, "colorspace", COLORSPACE_NAMES, colorspace) ||
+      !getEnum(options, "range", RANGE_NAMES, range))
+    return false;
+
+  uint32_t output_width = base_width;
+  uint32_t output_height = base_height;
+  if (!getUint(options, "outputWidth", output_width) ||
+      !getUint(options, "outputHeight", output_height))
+    return false;
+
+  if (options.Has("gpuConversion"))
+    gpu_conversion = options.Get("gpuConversion").ToBoolean();
+
+  ovi = create_ovi(ovi.adapter, ovi.graphics_module, format, fps_num, fps_den,
+    base_width, base_height, output_width, output_height,
+    gpu_conversion, colorspace, range, scale_type);
+  return true;
+}
+
+// The effective video settings, as resolved by resetVideo() and createCanvas().
+static Napi::Object videoInfoToJs(Napi::Env env, const struct obs_video_info& ovi) {
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("baseWidth", Napi::Number::New(env, ovi.base_width));
+  result.Set("baseHeight", Napi::Number::New(env, ovi.base_height));
+  result.Set("outputWidth", Napi::Number::New(env, ovi.output_width));
+  result.Set("outputHeight", Napi::Number::New(env, ovi.output_height));
+  result.Set("fpsNum", Napi::Number::New(env, ovi.fps_num));
+  result.Set("fpsDen", Napi::Number::New(env, ovi.fps_den));
+  result.Set("format", Napi::String::New(env, enumName(VIDEO_FORMAT_NAMES, ovi.output_format)));
+  result.Set("scaleType", Napi::String::New(env, enumName(SCALE_TYPE_NAMES, ovi.scale_type)));
+  result.Set("colorspace", Napi::String::New(env, enumName(COLORSPACE_NAMES, ovi.colorspace)));
+  result.Set("range", Napi::String::New(env, enumName(RANGE_NAMES, ovi.range)));
+  result.Set("gpuConversion", Napi::Boolean::New(env, ovi.gpu_conversion));
+  result.Set("adapter", Napi::Number::New(env, ovi.adapter));
+  result.Set("graphicsModule", Napi::String::New(env,
+      ovi.graphics_module ? ovi.graphics_module : ""));
+  return result;
+}
+
+static std::string resetVideoError(int code) {
+  switch (code) {
+  case OBS_VIDEO_NOT_SUPPORTED:
+    return "Error: video settings not supported by the graphics adapter";
+  case OBS_VIDEO_INVALID_PARAM:
+    return "Error: invalid video settings";
+  case OBS_VIDEO_CURRENTLY_ACTIVE:
+    return "Error: video cannot be reset while an output is active";
+  case OBS_VIDEO_MODULE_NOT_FOUND:
+    return "Error: graphics module not found";
+  default:
+    return "Error: video reset failed (code " + std::to_string(code) + ")";
+  }
+}
+
+// Graphics adapter and backend
+// The adapter and the graphics module only take effect on the first video
+// reset of a session: libobs keeps its graphics device until obs_shutdown.
+// initialize({ adapter, graphicsModule }) sets them for the session, and
+// resetVideo() accepts the same options as long as no video exists yet.
+//
+// adapter is an index from getAdapters() or 'auto' (the default). Auto
+// prefers the discrete GPU whose vendor has a hardware encoder loaded
+// (NVENC, AMF, QSV), so that texture encoders take frames from the GPU that
+// rendered them instead of copying them across adapters; without one it
+// takes the discrete GPU with the most dedicated memory, else adapter 0.
+// Vendor and memory come from DXGI, so auto only chooses on Windows, where
+// the default backend is libobs-d3d11 (libobs-opengl elsewhere).
+//
+// JS: getAdapters() -> Promise<[{ index, name, vendor, vendorId, dedicatedVideoMemory,
+//                                 sharedSystemMemory, software, discrete, preferred,
+//                                 selected }]>
+#define DISCRETE_VIDEO_MEMORY (512ull * 1024 * 1024)
+#define VENDOR_NVIDIA 0x10de
+#define VENDOR_AMD 0x1002
+#define VENDOR_INTEL 0x8086
+
+struct ObsAdapterInfo {
+  uint32_t index = 0;
+  std::string name;
+  uint32_t vendor_id = 0;
+  uint64_t dedicated_video_memory = 0;
+  uint64_t shared_system_memory = 0;
+  bool software = false;
+
+  bool discrete() const {
+    return !software && dedicated_video_memory >= DISCRETE_VIDEO_MEMORY;
+  }
+};
+
+static const ObsEnumName<uint32_t> VENDOR_NAMES[] = {
+  { "nvidia", VENDOR_NVIDIA },
+  { "amd", VENDOR_AMD },
+  { "intel", VENDOR_INTEL },
+  { "microsoft", 0x1414 },
+  { "apple", 0x106b },
+};
+
+// Hardware encoder families and the vendor whose GPU runs them.
+static const ObsEnumName<uint32_t> ENCODER_VENDORS[] = {
+  { "nvenc", VENDOR_NVIDIA },
+  { "amf", VENDOR_AMD },
+  { "qsv", VENDOR_INTEL },
+};
+
+// Session choice, set by initialize() on the command thread. libobs keeps
+// the module name pointer of the first reset, so the string must outlive it.
+static int32_t session_adapter = ADAPTER_AUTO;
+static std::string session_graphics_module = DEFAULT_MODULE;
+
+// Lists the adapters in the order the graphics module numbers them. Runs
+// on the command thread.
+static std::vector<ObsAdapterInfo> enumAdapters() {
+  std::vector<ObsAdapterInfo> adapters;
+#if defined(_WIN32)
+  // libobs-d3d11 enumerates with DXGI too, so the indices match.
+  IDXGIFactory1* factory = nullptr;
+  if (FAILED(CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&factory)))
+    return adapters;
+
+  IDXGIAdapter1* adapter = nullptr;
+  for (UINT i = 0; factory->EnumAdapters1(i, &adapter) == S_OK; i++) {
+    DXGI_ADAPTER_DESC1 desc;
+    if (SUCCEEDED(adapter->GetDesc1(&desc))) {
+      ObsAdapterInfo info;
+      info.index = i;
+      char name[256] = {};
+      WideCharToMultiByte(CP_UTF8, 0, desc.Description, -1, name, sizeof(name) - 1,
+          nullptr, nullptr);
+      info.name = name;
+      info.vendor_id = desc.VendorId;
+      info.dedicated_video_memory = desc.DedicatedVideoMemory;
+      info.shared_system_memory = desc.SharedSystemMemory;
+      info.software = (desc.Flags & DXGI_ADAPTER_FLAG_SOFTWARE) != 0;
+      adapters.push_back(info);
+    }
+    adapter->Release();
+  }
+  factory->Release();
+#else
+  // Only names, and only once the graphics device exists.
+  struct obs_video_info ovi;
+  if (!obs_initialized() || !obs_get_video_info(&ovi))
+    return adapters;
+  obs_enter_graphics();
+  gs_enum_adapters([](void* param, const char* name, uint32_t id) {
+    ObsAdapterInfo info;
+    info.index = id;
+    info.name = name ? name : "";
+    ((std::vector<ObsAdapterInfo>*)param)->push_back(info);
+    return true;
+  }, &adapters);
+  obs_leave_graphics();
+#endif
+  return adapters;
+}
+
+// Vendors with a hardware encoder among the loaded encoder types.
+static std::set<uint32_t> encoderVendors() {
+  std::set<uint32_t> vendors;
+  for (const ObsEncoderTypeInfo& encoder : encoderCatalog()) {
+    if (!encoder.hardware)
+      continue;
+    for (const ObsEnumName<uint32_t>& family : ENCODER_VENDORS)
+      if (encoder.id.find(family.name) != std::string::npos)
+        vendors.insert(family.value);
+  }
+  return vendors;
+}
+
+// The auto policy, see above.
+static uint32_t preferredAdapter(const std::vector<ObsAdapterInfo>& adapters) {
+  std::set<uint32_t> vendors = encoderVendors();
+  const ObsAdapterInfo* best = nullptr;
+  auto rank = [&vendors](const ObsAdapterInfo& adapter) {
+    return std::make_tuple(adapter.discrete() && vendors.count(adapter.vendor_id) > 0,
+        adapter.discrete(), adapter.dedicated_video_memory);
+  };
+  for (const ObsAdapterInfo& adapter : adapters) {
+    if (adapter.discrete() && (!best || rank(adapter) > rank(*best)))
+      best = &adapter;
+  }
+  return best ? best->index : DEFAULT_VIDEO_ADAPTER;
+}
+
+// Runs on the command thread, before obs_startup.
+static void setSessionGraphics(int32_t adapter, const std::string& module) {
+  session_adapter = adapter;
+  session_graphics_module = module;
+}
+
+// Fills in the adapter and graphics module of ovi before a reset: the
+// session's choice on the first reset, the running ones afterwards. Asking
+// for a different adapter or module once video exists is an error. Runs on
+// the command thread.
+static bool selectGraphics(struct obs_video_info& ovi, int32_t adapter,
+    const std::string& module, std::string& error) {
+  struct obs_video_info current;
+  if (obs_get_video_info(&current)) {
+    if ((adapter >= 0 && (uint32_t)adapter != current.adapter) ||
+        (!module.empty() && module != current.graphics_module)) {
+      error = "Error: the adapter and graphics module cannot change until shutdown()";
+      return false;
+    }
+    ovi.adapter = current.adapter;
+    ovi.graphics_module = current.graphics_module;
+    return true;
+  }
+
+  if (!module.empty())
+    session_graphics_module = module;
+  if (adapter == ADAPTER_UNSET)
+    adapter = session_adapter;
+  if (adapter == ADAPTER_AUTO) {
+    adapter = preferredAdapter(enumAdapters());
+    blog(LOG_INFO, "obsapi: auto-selected graphics adapter %d", adapter);
+  }
+  ovi.adapter = (uint32_t)adapter;
+  ovi.graphics_module = session_graphics_module.c_str();
+  return true;
+}
+
+// Reads an optional adapter: an index or 'auto'.
+static bool getAdapter(const Napi::Object& obj, const char* key, int32_t& out) {
+  if (!obj.Has(key))
+    return true;
+
+  Napi::Value value = obj.Get(key);
+  if (value.IsString() && value.As<Napi::String>().Utf8Value() == "auto") {
+    out = ADAPTER_AUTO;
+    return true;
+  }
+  if (!value.IsNumber() || value.As<Napi::Number>().DoubleValue() < 0)
+    return false;
+  out = value.As<Napi::Number>().Int32Value();
+  return true;
+}
+
+// Asynchronously lists the graphics adapters. Works before initialize(),
+// so the adapter can be chosen up front.
+//
+class AsyncGetAdaptersWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    AsyncGetAdaptersWorker* worker = new AsyncGetAdaptersWorker(info.Env());
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue(ObsPriority::HIGH);
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    adapters = enumAdapters();
+    preferred = preferredAdapter(adapters);
+    struct obs_video_info ovi;
+    if (obs_initialized() && obs_get_video_info(&ovi))
+      selected = (int32_t)ovi.adapter;
+  }
+
+  virtual void OnOK() override {
+    Napi::Env env = Env();
+    Napi::Array result = Napi::Array::New(env, adapters.size());
+    for (size_t i = 0; i < adapters.size(); i++) {
+      const ObsAdapterInfo& adapter = adapters[i];
+      const char* vendor = "unknown";
+      for (const ObsEnumName<uint32_t>& name : VENDOR_NAMES)
+        if (name.value == adapter.vendor_id)
+          vendor = name.name;
+
+      Napi::Object item = Napi::Object::New(env);
+      item.Set("index", Napi::Number::New(env, adapter.index));
+      item.Set("name", Napi::String::New(env, adapter.name));
+      item.Set("vendor", Napi::String::New(env, vendor));
+      item.Set("vendorId", Napi::Number::New(env, adapter.vendor_id));
+      item.Set("dedicatedVideoMemory", Napi::Number::New(env,
+          (double)adapter.dedicated_video_memory));
+      item.Set("sharedSystemMemory", Napi::Number::New(env, (double)adapter.shared_system_memory));
+      item.Set("software", Napi::Boolean::New(env, adapter.software));
+      item.Set("discrete", Napi::Boolean::New(env, adapter.discrete()));
+      item.Set("preferred", Napi::Boolean::New(env, adapter.index == preferred));
+      item.Set("selected", Napi::Boolean::New(env, (int32_t)adapter.index == selected));
+      result.Set(i, item);
+    }
+    deferredPromise.Resolve(result);
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncGetAdaptersWorker(napi_env env) :
+    ObsCommandWorker(env),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  std::vector<ObsAdapterInfo> adapters;
+  uint32_t preferred = DEFAULT_VIDEO_ADAPTER;
+  int32_t selected = ADAPTER_UNSET;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+struct ObsEncoderContext;
+static bool cycleOutputs(const ObsEncoderContext* bound,
+    const std::function<bool(std::string&)>& change,
+    std::vector<std::string>& restarted, std::string& error);
+static const char* internalOutputUser(obs_output_t* output);
+
+// Asynchronously sets base video output base resolution/fps/format
+// Accepts either the "WxH" shortcut (resolves with "WxH") or the structured
+// configuration read by parseVideoConfig (resolves with the effective
+// settings as an object).
+// Note: This data cannot be changed if an output is currently active. With
+// { restartOutputs: true } the active outputs are stopped, the video is reset
+// and they are started again on the same output, encoder and service
+// objects; the result lists them as restarted. Recordings reopen their path.
+// Prefer encoder scaling (createEncoders({ video: { scale } })) for rendition
+// changes, which leaves the canvas alone.
+// Note: The graphics module cannot be changed without fully destroying the OBS context.
+// { adapter, graphicsModule } (see getAdapters()) therefore only apply to
+// the first reset of a session; later resets must leave them as they are.
+//
+class AsyncResetVideoWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    if (info.Length() != 1 || !(info[0].IsString() || info[0].IsObject())) {
+      Napi::TypeError::New(env, "Expected a \"WxH\" string or a video config object")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    std::string input;
+    struct obs_video_info config = create_ovi();
+    bool structured = info[0].IsObject();
+    bool restart = false;
+    int32_t adapter = ADAPTER_UNSET;
+    std::string module;
+    if (structured) {
+      if (!parseVideoConfig(info[0].As<Napi::Object>(), config) ||
+          !getAdapter(info[0].As<Napi::Object>(), "adapter", adapter) ||
+          !getString(info[0].As<Napi::Object>(), "graphicsModule", module)) {
+        Napi::TypeError::New(env, "Invalid video config")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      if (info[0].As<Napi::Object>().Has("restartOutputs"))
+        restart = info[0].As<Napi::Object>().Get("restartOutputs").ToBoolean();
+    } else {
+      input = info[0].As<Napi::String>();
+    }
+
+    AsyncResetVideoWorker* worker = new AsyncResetVideoWorker(info.Env(), input);
+    worker->ovi = config;
+    worker->structured = structured;
+    worker->restart = restart;
+    worker->adapter = adapter;
+    worker->module = module;
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error)) {
+      SetError(error);
+      return;
+    }
+
+    if (!structured) {
+      size_t width = DEFAULT_VIDEO_WIDTH;
+      size_t height = DEFAULT_VIDEO_HEIGHT;
+      size_t xpos = input.find('x');
+      if(xpos != std::string::npos) {
+        std::string w = input.substr(0, xpos);
+        input.erase(0, xpos + 1);
+        std::string h = input;
+        if(w.length()) {
+          width = atoi(w.c_str());
+        };
+        if(h.length()) {
+          height = atoi(h.c_str());
+        };
+      }
+
+      ovi = create_ovi(DEFAULT_VIDEO_ADAPTER, DEFAULT_MODULE, DEFAULT_VIDEO_FORMAT, 
+        DEFAULT_VIDEO_FPS_NUM, DEFAULT_VIDEO_FPS_DEN, width, height, width, height);
+    }
+    if (!selectGraphics(ovi, adapter, module, error)) {
+      SetError(error);
+      return;
+    }
+
+    auto reset = [this](std::string& reset_error) {
+      int code = obs_reset_video(&ovi);
+      if (code != OBS_VIDEO_SUCCESS) {
+        reset_error = resetVideoError(code);
+        return false;
+      }
+      return true;
+    };
+
+    bool reset_ok = restart ? cycleOutputs(nullptr, reset, restarted, error) : reset(error);
+    if (!reset_ok) {
+      SetError(error);
+      return;
+    }
+    obs_get_video_info(&ovi);
+  }
+
+  virtual void OnOK() override {
+      Napi::Env env = Env();
+      if (!structured) {
+        deferredPromise.Resolve(Napi::String::New(env, 
+          std::to_string(ovi.base_width) + 'x' + std::to_string(ovi.base_height)));
+        return;
+      }
+
+      Napi::Object result = videoInfoToJs(env, ovi);
+      if (restart) {
+        Napi::Array names = Napi::Array::New(env, restarted.size());
+        for (size_t i = 0; i < restarted.size(); i++)
+          names.Set(i, Napi::String::New(env, restarted[i]));
+        result.Set("restarted", names);
+      }
+      deferredPromise.Resolve(result);
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+      deferredPromise.Reject(e.Value());
+  }
+
+private:
+  struct obs_video_info ovi;
+  bool structured = false;
+  bool restart = false;
+  int32_t adapter = ADAPTER_UNSET;
+  std::string module;
+  std::vector<std::string> restarted;
+  AsyncResetVideoWorker(napi_env env, std::string& hint) :
+    ObsCommandWorker(env),
+    input(hint),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  std::string input;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Structured audio configuration:
+//   { sampleRate, speakers, fixedBuffering, maxBufferingMs }
+// speakers is one of SPEAKER_LAYOUT_NAMES. Matching sampleRate to the
+// encoders and the ingest (48000 for most) avoids a resample pass.
+// fixedBuffering keeps audio buffering at maxBufferingMs instead of letting
+// it grow when sources arrive late, which bounds A/V latency; both need
+// libobs 28 (obs_reset_audio2). maxBufferingMs 0 keeps the libobs default.
+struct ObsAudioConfig {
+  uint32_t sample_rate = DEFAULT_AUDIO_SAMPLES;
+  enum speaker_layout speakers = DEFAULT_AUDIO_CHANNELS;
+  bool fixed_buffering = false;
+  uint32_t max_buffering_ms = 0;
+};
+
+static bool parseAudioConfig(const Napi::Object& options, ObsAudioConfig& config) {
+  if (!getUint(options, "sampleRate", config.sample_rate) ||
+      !getEnum(options, "speakers", SPEAKER_LAYOUT_NAMES, config.speakers) ||
+      !getUint(options, "maxBufferingMs", config.max_buffering_ms))
+    return false;
+
+  if (options.Has("fixedBuffering"))
+    config.fixed_buffering = options.Get("fixedBuffering").ToBoolean();
+  return true;
+}
+
+// The config audio was last reset to, for saveProfile().
+static ObsAudioConfig audio_config;
+
+static Napi::Object audioConfigToJs(Napi::Env env, const ObsAudioConfig& config) {
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("sampleRate", Napi::Number::New(env, config.sample_rate));
+  result.Set("speakers", Napi::String::New(env, enumName(SPEAKER_LAYOUT_NAMES, config.speakers)));
+  result.Set("channels", Napi::Number::New(env, get_audio_channels(config.speakers)));
+  result.Set("fixedBuffering", Napi::Boolean::New(env, config.fixed_buffering));
+  result.Set("maxBufferingMs", Napi::Number::New(env, config.max_buffering_ms));
+  return result;
+}
+
+// Resets audio to the config. Runs on the command thread.
+static bool resetAudio(const ObsAudioConfig& config, std::string& error) {
+#if LIBOBS_API_MAJOR_VER >= 28
+  struct obs_audio_info2 oai = {};
+  oai.samples_per_sec = config.sample_rate;
+  oai.speakers = config.speakers;
+  oai.fixed_buffering = config.fixed_buffering;
+  oai.max_buffering_ms = config.max_buffering_ms;
+  bool reset = obs_reset_audio2(&oai);
+#else
+  if (config.fixed_buffering || config.max_buffering_ms) {
+    error = "Error: audio buffering options require libobs 28 or later";
+    return false;
+  }
+  struct obs_audio_info oai = create_oai(config.sample_rate, config.speakers);
+  bool reset = obs_reset_audio(&oai);
+#endif
+  if (!reset) {
+    error = "Error: audio cannot be reset while an output or audio tap is active";
+    return false;
+  }
+  audio_config = config;
+  return true;
+}
+
+// Asynchronously sets base audio output format/channels/samples/etc.
+// Accepts either the "stereo"/"mono" shortcut (resolves with the layout
+// name) or the structured configuration read by parseAudioConfig (resolves
+// with the effective { sampleRate, speakers, channels, fixedBuffering,
+// maxBufferingMs }).
+// Note: Cannot reset base audio if an output is currently active.
+//
+class AsyncResetAudioWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    if (info.Length() != 1 || !(info[0].IsString() || info[0].IsObject())) {
+      Napi::TypeError::New(env, "Expected a \"stereo\"/\"mono\" string or an audio config object")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    ObsAudioConfig config;
+    bool structured = info[0].IsObject();
+    if (structured) {
+      if (!parseAudioConfig(info[0].As<Napi::Object>(), config)) {
+        Napi::TypeError::New(env, "Invalid audio config")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+      }
+    } else {
+      std::string input = info[0].As<Napi::String>();
+      if (input.find("mono") != std::string::npos)
+        config.speakers = SPEAKERS_MONO;
+    }
+
+    AsyncResetAudioWorker* worker = new AsyncResetAudioWorker(info.Env(), config, structured);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error) || !resetAudio(config, error)) {
+      SetError(error);
+      return;
+    }
+
+    struct obs_audio_info oai;
+    if (obs_get_audio_info(&oai)) {
+      config.sample_rate = oai.samples_per_sec;
+      config.speakers = oai.speakers;
+    }
+  }
+
+  virtual void OnOK() override {
+      Napi::Env env = Env();
+      if (!structured) {
+        deferredPromise.Resolve(Napi::String::New(env,
+          config.speakers == SPEAKERS_STEREO ? "stereo" : "mono"));
+        return;
+      }
+
+      deferredPromise.Resolve(audioConfigToJs(env, config));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+      deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncResetAudioWorker(napi_env env, const ObsAudioConfig& config, bool structured) :
+    ObsCommandWorker(env),
+    config(config),
+    structured(structured),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  ObsAudioConfig config;
+  bool structured;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Video encoder selection
+// Candidates are probed by test-encoding frames from the main video at the
+// current obs_video_info resolution through a private output that only
+// counts packets. They are ranked by measured throughput (packets per second,
+// ties broken by encode latency) and the ranking is cached per GPU so later
+// starts skip the probe.
+static const char* const VIDEO_ENCODER_CANDIDATES[] = {
+  "jim_nvenc",
+  "ffmpeg_nvenc",
+  "obs_qsv11",
+  "amd_amf_h264",
+  "ffmpeg_vaapi",
+  "com.apple.videotoolbox.videoencoder.ave.avc",
+  "com.apple.videotoolbox.videoencoder.h264.gva",
+  "obs_x264",
+};
+
+#define PROBE_OUTPUT_ID ("obsapi_probe_output")
+#define ENCODER_CACHE_FILE_NAME ("encoder-ranking.json")
+#define DEFAULT_PROBE_FRAMES 30
+#define DEFAULT_PROBE_BITRATE 6000
+#define AUTO_ENCODER_ID ("auto")
+
+struct ObsEncoderProbe {
+  std::string id;
+  double fps = 0;
+  double latency_ms = 0;
+  uint64_t frames = 0;
+  std::string error;
+};
+
+struct ObsEncoderSelectOptions {
+  std::vector<std::string> candidates;
+  std::string gpu_key;
+  std::string cache_path;
+  uint32_t frames = DEFAULT_PROBE_FRAMES;
+  uint32_t bitrate = DEFAULT_PROBE_BITRATE;
+  bool force = false;
+};
+
+struct ObsEncoderSelection {
+  std::string id;
+  std::string key;
+  bool cached = false;
+  std::vector<ObsEncoderProbe> ranking;
+};
+
+// Plugin data of the probe output.
+struct ObsProbeOutputData {
+  obs_output_t* output = nullptr;
+  std::mutex mutex;
+  std::condition_variable cv;
+  uint64_t packets = 0;
+  uint64_t first_us = 0;
+  uint64_t last_us = 0;
+  double latency_sum_ms = 0;
+  bool failed = false;
+};
+
+static std::mutex selector_mutex;
+
+static const char* probeGetName(void*) {
+  return "obsapi encoder probe";
+}
+
+static void* probeCreate(obs_data_t*, obs_output_t* output) {
+  ObsProbeOutputData* data = new ObsProbeOutputData();
+  data->output = output;
+  return data;
+}
+
+static void probeDestroy(void* data) {
+  delete (ObsProbeOutputData*)data;
+}
+
+static bool probeStart(void* data) {
+  ObsProbeOutputData* probe = (ObsProbeOutputData*)data;
+  if (!obs_output_can_begin_data_capture(probe->output, 0) ||
+      !obs_output_initialize_encoders(probe->output, 0))
+    return false;
+  return obs_output_begin_data_capture(probe->output, 0);
+}
+
+static void probeStop(void* data, uint64_t) {
+  obs_output_end_data_capture(((ObsProbeOutputData*)data)->output);
+}
+
+static void probePacket(void* data, struct encoder_packet* packet) {
+  ObsProbeOutputData* probe = (ObsProbeOutputData*)data;
+  uint64_t now_us = os_gettime_ns() / 1000;
+  {
+    std::lock_guard<std::mutex> lock(probe->mutex);
+    if (!packet) {
+      probe->failed = true;
+    } else {
+      if (!probe->packets)
+        probe->first_us = now_us;
+      probe->last_us = now_us;
+      probe->latency_sum_ms += (double)(now_us - (uint64_t)packet->sys_dts_usec) / 1000.0;
+      probe->packets++;
+    }
+  }
+  probe->cv.notify_all();
+}
+
+// Registers the probe output type once per OBS session.
+static void registerProbeOutput() {
+  if (obs_output_get_display_name(PROBE_OUTPUT_ID))
+    return;
+
+  struct obs_output_info info = {};
+  info.id = PROBE_OUTPUT_ID;
+  info.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED;
+  info.get_name = probeGetName;
+  info.create = probeCreate;
+  info.destroy = probeDestroy;
+  info.start = probeStart;
+  info.stop = probeStop;
+  info.encoded_packet = probePacket;
+  obs_register_output(&info);
+}
+
+// Test-encodes frames with one encoder and measures throughput and latency.
+static ObsEncoderProbe probeEncoder(const std::string& id, const ObsEncoderSelectOptions& options,
+    const struct obs_video_info& ovi) {
+  ObsEncoderProbe result;
+  result.id = id;
+
+  obs_data_t* settings = obs_data_create();
+  obs_data_set_int(settings, "bitrate", options.bitrate);
+  obs_encoder_t* encoder = obs_video_encoder_create(id.c_str(), ("obsapi_probe_" + id).c_str(),
+      settings, nullptr);
+  obs_data_release(settings);
+  if (!encoder) {
+    result.error = "could not create encoder";
+    return result;
+  }
+  obs_encoder_set_video(encoder, obs_get_video());
+
+  obs_output_t* output = obs_output_create(PROBE_OUTPUT_ID, "obsapi_probe", nullptr, nullptr);
+  obs_output_set_video_encoder(output, encoder);
+  ObsProbeOutputData* probe = (ObsProbeOutputData*)obs_obj_get_data(output);
+
+  if (!probe || !obs_output_start(output)) {
+    result.error = "could not start encoder";
+  } else {
+    // Allow twice the real-time duration of the probe plus encoder warm-up.
+    double frame_ms = 1000.0 * ovi.fps_den / ovi.fps_num;
+    auto timeout = std::chrono::milliseconds((long long)(frame_ms * options.frames * 2) + 2000);
+
+    std::unique_lock<std::mutex> lock(probe->mutex);
+    probe->cv.wait_for(lock, timeout, [&] { return probe->failed || probe->packets >= options.frames; });
+
+    result.frames = probe->packets;
+    if (probe->failed) {
+      result.error = "encoder failed";
+    } else if (probe->packets > 1) {
+      result.fps = (probe->packets - 1) * 1000000.0 / (double)(probe->last_us - probe->first_us);
+      result.latency_ms = probe->latency_sum_ms / probe->packets;
+    } else {
+      result.error = "no packets";
+    }
+    lock.unlock();
+
+    obs_output_stop(output);
+  }
+
+  obs_output_release(output);
+  obs_encoder_release(encoder);
+  return result;
+}
+
+// Identifies the GPU the probe ran on: the caller's key (E.G. vendor, device
+// and driver version from Electron's app.getGPUInfo()) or the adapter name
+// libobs reports, plus the video mode the ranking was measured at.
+static std::string encoderCacheKey(const std::string& gpu_key, const struct obs_video_info& ovi) {
+  std::string key = gpu_key;
+
+  if (key.empty()) {
+    struct AdapterQuery { uint32_t index; std::string name; } query = { ovi.adapter, "" };
+    obs_enter_graphics();
+    gs_enum_adapters([](void* param, const char* name, uint32_t id) {
+      AdapterQuery* q = (AdapterQuery*)param;
+      if (id == q->index)
+        q->name = name;
+      return true;
+    }, &query);
+    const char* device = gs_get_device_name();
+    obs_leave_graphics();
+    key = std::string(device ? device : "") + ":" + query.name;
+  }
+
+  return key + "@" + std::to_string(ovi.output_width) + "x" + std::to_string(ovi.output_height) +
+      "/" + std::to_string(ovi.fps_num) + "/" + std::to_string(ovi.fps_den);
+}
+
+static bool readCachedSelection(const std::string& path, const std::string& key,
+    ObsEncoderSelection& selection) {
+  if (path.empty())
+    return false;
+
+  obs_data_t* root = obs_data_create_from_json_file_safe(path.c_str(), "bak");
+  if (!root)
+    return false;
+
+  obs_data_t* entry = obs_data_get_obj(root, key.c_str());
+  bool found = entry && *obs_data_get_string(entry, "id");
+  if (found) {
+    selection.id = obs_data_get_string(entry, "id");
+    obs_data_array_t* ranking = obs_data_get_array(entry, "ranking");
+    for (size_t i = 0; i < obs_data_array_count(ranking); i++) {
+      obs_data_t* item = obs_data_array_item(ranking, i);
+      ObsEncoderProbe probe;
+      probe.id = obs_data_get_string(item, "id");
+      probe.fps = obs_data_get_double(item, "fps");
+      probe.latency_ms = obs_data_get_double(item, "latency_ms");
+      probe.frames = (uint64_t)obs_data_get_int(item, "frames");
+      probe.error = obs_data_get_string(item, "error");
+      selection.ranking.push_back(probe);
+      obs_data_release(item);
+    }
+    obs_data_array_release(ranking);
+  }
+
+  obs_data_release(entry);
+  obs_data_release(root);
+  return found;
+}
+
+static void writeCachedSelection(const std::string& path, const ObsEncoderSelection& selection) {
+  if (path.empty())
+    return;
+
+  obs_data_t* root = obs_data_create_from_json_file_safe(path.c_str(), "bak");
+  if (!root)
+    root = obs_data_create();
+
+  obs_data_t* entry = obs_data_create();
+  obs_data_set_string(entry, "id", selection.id.c_str());
+  obs_data_array_t* ranking = obs_data_array_create();
+  for (const ObsEncoderProbe& probe : selection.ranking) {
+    obs_data_t* item = obs_data_create();
+    obs_data_set_string(item, "id", probe.id.c_str());
+    obs_data_set_double(item, "fps", probe.fps);
+    obs_data_set_double(item, "latency_ms", probe.latency_ms);
+    obs_data_set_int(item, "frames", (long long)probe.frames);
+    obs_data_set_string(item, "error", probe.error.c_str());
+    obs_data_array_push_back(ranking, item);
+    obs_data_release(item);
+  }
+  obs_data_set_array(entry, "ranking", ranking);
+  obs_data_array_release(ranking);
+  obs_data_set_obj(root, selection.key.c_str(), entry);
+  obs_data_release(entry);
+
+  if (!obs_data_save_json_safe(root, path.c_str(), "tmp", "bak"))
+    blog(LOG_WARNING, "obsapi: could not write encoder ranking to %s", path.c_str());
+  obs_data_release(root);
+}
+
+// Picks the best available video encoder, from the cache when possible.
+// Must be called after video has been reset.
+static bool selectVideoEncoder(const ObsEncoderSelectOptions& options,
+    ObsEncoderSelection& selection, std::string& error) {
+  std::lock_guard<std::mutex> lock(selector_mutex);
+
+  struct obs_video_info ovi;
+  if (!obs_get_video_info(&ovi)) {
+    error = "Error: video must be reset before selecting an encoder";
+    return false;
+  }
+
+  std::string cache_path = options.cache_path;
+  if (cache_path.empty() && !config_dir.empty())
+    cache_path = config_dir + "/" + ENCODER_CACHE_FILE_NAME;
+
+  selection.key = encoderCacheKey(options.gpu_key, ovi);
+  if (!options.force && readCachedSelection(cache_path, selection.key, selection)) {
+    selection.cached = true;
+    return true;
+  }
+
+  std::vector<std::string> candidates = options.candidates;
+  if (candidates.empty())
+    candidates.assign(std::begin(VIDEO_ENCODER_CANDIDATES), std::end(VIDEO_ENCODER_CANDIDATES));
+
+  std::set<std::string> available;
+  for (const ObsEncoderTypeInfo& encoder : encoderCatalog())
+    if (encoder.type == OBS_ENCODER_VIDEO)
+      available.insert(encoder.id);
+
+  registerProbeOutput();
+
+  for (const std::string& candidate : candidates)
+    if (available.count(candidate))
+      selection.ranking.push_back(probeEncoder(candidate, options, ovi));
+
+  // Higher throughput wins, compared in whole frames per second so that the
+  // ordering stays transitive; within the same one the lower latency wins,
+  // then the candidate order (hardware first).
+  std::stable_sort(selection.ranking.begin(), selection.ranking.end(),
+      [](const ObsEncoderProbe& a, const ObsEncoderProbe& b) {
+    if (a.error.empty() != b.error.empty())
+      return a.error.empty();
+    double a_fps = std::floor(a.fps);
+    double b_fps = std::floor(b.fps);
+    if (a_fps != b_fps)
+      return a_fps > b_fps;
+    return a.latency_ms < b.latency_ms;
+  });
+
+  if (selection.ranking.empty() || !selection.ranking[0].error.empty()) {
+    error = "Error: no usable video encoder found";
+    return false;
+  }
+
+  selection.id = selection.ranking[0].id;
+  writeCachedSelection(cache_path, selection);
+  return true;
+}
+
+// Asynchronously selects the best video encoder for this machine.
+// Options (all optional): candidates, gpuKey, cachePath, frames, bitrate, force.
+// Resolves with { id, key, cached, ranking: [{ id, fps, latencyMs, frames, error }] }.
+//
+class AsyncSelectEncoderWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    ObsEncoderSelectOptions options;
+    if (info.Length() > 0 && !info[0].IsUndefined()) {
+      Napi::Object obj = info[0].IsObject() ? info[0].As<Napi::Object>() : Napi::Object();
+      if (obj.IsEmpty() ||
+          !getStringArray(obj, "candidates", options.candidates) ||
+          !getString(obj, "gpuKey", options.gpu_key) ||
+          !getString(obj, "cachePath", options.cache_path)) {
+        Napi::TypeError::New(env, "Invalid encoder selection options")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+      }
+      if (obj.Has("frames") && obj.Get("frames").IsNumber())
+        options.frames = std::max(2u, obj.Get("frames").As<Napi::Number>().Uint32Value());
+      if (obj.Has("bitrate") && obj.Get("bitrate").IsNumber())
+        options.bitrate = obj.Get("bitrate").As<Napi::Number>().Uint32Value();
+      if (obj.Has("force"))
+        options.force = obj.Get("force").ToBoolean();
+    }
+
+    AsyncSelectEncoderWorker* worker = new AsyncSelectEncoderWorker(info.Env(), options);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue(ObsPriority::LOW);
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error) || !selectVideoEncoder(options, selection, error))
+      SetError(error);
+  }
+
+  virtual void OnOK() override {
+    Napi::Env env = Env();
+    Napi::Array ranking = Napi::Array::New(env, selection.ranking.size());
+    for (size_t i = 0; i < selection.ranking.size(); i++) {
+      const ObsEncoderProbe& probe = selection.ranking[i];
+      Napi::Object item = Napi::Object::New(env);
+      item.Set("id", Napi::String::New(env, probe.id));
+      item.Set("fps", Napi::Number::New(env, probe.fps));
+      item.Set("latencyMs", Napi::Number::New(env, probe.latency_ms));
+      item.Set("frames", Napi::Number::New(env, (double)probe.frames));
+      if (!probe.error.empty())
+        item.Set("error", Napi::String::New(env, probe.error));
+      ranking.Set(i, item);
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("id", Napi::String::New(env, selection.id));
+    result.Set("key", Napi::String::New(env, selection.key));
+    result.Set("cached", Napi::Boolean::New(env, selection.cached));
+    result.Set("ranking", ranking);
+    deferredPromise.Resolve(result);
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncSelectEncoderWorker(napi_env env, ObsEncoderSelectOptions& options) :
+    ObsCommandWorker(env),
+    options(options),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  ObsEncoderSelectOptions options;
+  ObsEncoderSelection selection;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Serializes a JS value to JSON so it can be turned into obs_data off the JS thread.
+static std::string toJson(Napi::Env env, Napi::Value value) {
+  Napi::Object json = env.Global().Get("JSON").As<Napi::Object>();
+  Napi::Function stringify = json.Get("stringify").As<Napi::Function>();
+  Napi::Value result = stringify.Call(json, { value });
+  return result.IsString() ? result.As<Napi::String>().Utf8Value() : std::string();
+}
+
+// Creates obs_data from a JSON string; an empty or invalid string gives empty data.
+static obs_data_t* dataFromJson(const std::string& json) {
+  obs_data_t* data = json.empty() ? nullptr : obs_data_create_from_json(json.c_str());
+  return data ? data : obs_data_create();
+}
+
+// Reads an optional "settings" object from a JS options object as JSON.
+static bool getSettingsJson(Napi::Env env, const Napi::Object& obj, std::string& out) {
+  if (!obj.Has("settings"))
+    return true;
+
+  Napi::Value value = obj.Get("settings");
+  if (!value.IsObject())
+    return false;
+
+  out = toJson(env, value);
+  return true;
+}
+
+// Canvases
+// A canvas is an obs_view with its own video mix: one scene rendered at its
+// own resolution and frame rate in the same graphics context as the main
+// canvas, E.G. a 9:16 vertical stream next to the 16:9 one. Encoders created
+// with { canvas: name } encode it instead of the main video. Mixes with
+// their own video settings need libobs 30 (obs_view_add2); older versions
+// only render canvases at the main canvas settings.
+//
+// JS: createCanvas({ name, scene, baseWidth, baseHeight, ...video config }) -> Promise<Canvas>
+//     canvas: { name, video: effective settings, setScene(name) -> Promise, destroy() }
+// fps and color settings left out follow the main canvas. Encoders created on
+// a canvas keep it alive after destroy().
+struct ObsCanvas {
+  std::string name;
+  obs_view_t* view = nullptr;
+  video_t* video = nullptr;
+
+  // Runs on the command thread.
+  void destroy() {
+    if (!view)
+      return;
+    if (video)
+      obs_view_remove(view);
+    obs_view_set_source(view, 0, nullptr);
+    obs_view_destroy(view);
+    view = nullptr;
+    video = nullptr;
+  }
+
+  ~ObsCanvas() {
+    destroy();
+  }
+};
+
+// Canvases by name, touched on the command thread only.
+static std::map<std::string, std::shared_ptr<ObsCanvas>> canvases;
+
+// Destroys every canvas. Runs on the command thread, after the encoders.
+static void stopCanvases() {
+  for (auto& kv : canvases)
+    kv.second->destroy();
+  canvases.clear();
+}
+
+// Configuration of an encoder pair, parsed on the JS thread.
+//   name:  Base name of the encoders
+//   canvas: Name of the canvas the video encoder encodes; the main canvas by default
+//   video: { id, settings, scale } of the video encoder; id "auto" uses selectVideoEncoder()
+//          scale: { width, height, fpsDivisor } encodes a scaled rendition of the canvas
+//   audio: { id, settings, mixer } of the audio encoder
+struct ObsEncoderConfig {
+  std::string name = "obsapi_output";
+  std::string video_id;
+  std::string video_settings;
+  uint32_t scale_width = 0;
+  uint32_t scale_height = 0;
+  uint32_t fps_divisor = 0;
+  std::string audio_id;
+  std::string audio_settings;
+  uint32_t audio_mixer = 0;
+  std::string canvas;
+};
+
+// Parses one { id, settings } component of an output config.
+static bool parseComponent(Napi::Env env, const Napi::Object& options, const char* key,
+    std::string& id, std::string& settings, bool id_required) {
+  if (!options.Has(key))
+    return true;
+
+  Napi::Value value = options.Get(key);
+  if (!value.IsObject())
+    return false;
+
+  Napi::Object component = value.As<Napi::Object>();
+  if (!getString(component, "id", id) || !getSettingsJson(env, component, settings))
+    return false;
+
+  return !id_required || !id.empty();
+}
+
+// Parses a video encoder scale: { width, height, fpsDivisor }. Width and
+// height go together; leaving them out encodes at the canvas output size.
+static bool parseVideoScale(const Napi::Object& scale, uint32_t& width, uint32_t& height,
+    uint32_t& fps_divisor) {
+  return getUint(scale, "width", width) && getUint(scale, "height", height) &&
+      !width == !height && getUint(scale, "fpsDivisor", fps_divisor);
+}
+
+// Parses the video and audio components; with id_required false only the
+// settings matter, as for update().
+static bool parseEncoderConfig(Napi::Env env, const Napi::Object& options,
+    ObsEncoderConfig& config, bool id_required) {
+  if (!parseComponent(env, options, "video", config.video_id, config.video_settings, id_required) ||
+      !parseComponent(env, options, "audio", config.audio_id, config.audio_settings, id_required))
+    return false;
+
+  if (id_required && !getString(options, "canvas", config.canvas))
+    return false;
+
+  if (id_required && options.Has("video")) {
+    Napi::Object video = options.Get("video").As<Napi::Object>();
+    if (video.Has("scale") && (!video.Get("scale").IsObject() ||
+        !parseVideoScale(video.Get("scale").As<Napi::Object>(),
+            config.scale_width, config.scale_height, config.fps_divisor)))
+      return false;
+  }
+
+  if (options.Has("audio")) {
+    Napi::Object audio = options.Get("audio").As<Napi::Object>();
+    if (audio.Has("mixer")) {
+      if (!audio.Get("mixer").IsNumber())
+        return false;
+      config.audio_mixer = audio.Get("mixer").As<Napi::Number>().Uint32Value();
+    }
+  }
+
+  return true;
+}
+
+// Every live encoder pair, so shutdown can release encoders that JS
+// handles still hold.
+struct ObsEncoderContext;
+static std::mutex encoder_registry_mutex;
+static std::set<ObsEncoderContext*> encoder_registry;
+
+// Native state of an encoder pair. Every output bound to it receives the
+// same packets, so a frame is encoded once however many outputs run; libobs
+// keeps the encoders running until the last bound output stops.
+struct ObsEncoderContext {
+  obs_encoder_t* video_encoder = nullptr;
+  obs_encoder_t* audio_encoder = nullptr;
+  std::shared_ptr<ObsCanvas> canvas;
+
+  // What saveProfile() needs to recreate the pair; settings are read live.
+  std::string name;
+  uint32_t audio_mixer = 0;
+  uint32_t scale_width = 0;
+  uint32_t scale_height = 0;
+  uint32_t fps_divisor = 0;
+  bool shared = false;
+
+  // The video bitrate last configured through the addon (creation, update(),
+  // service limits), which ABR controllers follow; their own changes do
+  // not count. Set on the command thread.
+  std::atomic<uint32_t> video_bitrate{0};
+
+  ObsEncoderContext() {
+    std::lock_guard<std::mutex> lock(encoder_registry_mutex);
+    encoder_registry.insert(this);
+  }
+
+  bool active() const {
+    return (video_encoder && obs_encoder_active(video_encoder)) ||
+        (audio_encoder && obs_encoder_active(audio_encoder));
+  }
+
+  // Encoders keep the video/audio they were bound to; rebind idle ones in
+  // case video or audio was reset since they last ran.
+  void rebind() {
+    if (video_encoder && !obs_encoder_active(video_encoder))
+      obs_encoder_set_video(video_encoder, canvas ? canvas->video : obs_get_video());
+    if (audio_encoder && !obs_encoder_active(audio_encoder))
+      obs_encoder_set_audio(audio_encoder, obs_get_audio());
+  }
+
+  // Reads the configured video bitrate back from the encoder.
+  void readVideoBitrate() {
+    if (!video_encoder)
+      return;
+    obs_data_t* settings = obs_encoder_get_settings(video_encoder);
+    video_bitrate = (uint32_t)obs_data_get_int(settings, "bitrate");
+    obs_data_release(settings);
+  }
+
+  void update(const ObsEncoderConfig& config) {
+    obs_data_t* settings;
+    if (!config.video_settings.empty() && video_encoder) {
+      settings = dataFromJson(config.video_settings);
+      obs_encoder_update(video_encoder, settings);
+      // Only a new bitrate counts: the encoder's may be the one ABR set.
+      if (obs_data_has_user_value(settings, "bitrate"))
+        video_bitrate = (uint32_t)obs_data_get_int(settings, "bitrate");
+      obs_data_release(settings);
+    }
+    if (!config.audio_settings.empty() && audio_encoder) {
+      settings = dataFromJson(config.audio_settings);
+      obs_encoder_update(audio_encoder, settings);
+      obs_data_release(settings);
+    }
+  }
+
+  // Sets the scaled size and frame rate divisor of the video encoder; a zero
+  // size encodes at the canvas output size. libobs only accepts them while
+  // the encoder is idle.
+  bool setScale(uint32_t width, uint32_t height, uint32_t divisor, std::string& error) {
+    if (!video_encoder) {
+      error = "Error: encoders have no video encoder";
+      return false;
+    }
+    if (obs_encoder_active(video_encoder)) {
+      error = "Error: the video encoder is still in use";
+      return false;
+    }
+
+#if LIBOBS_API_MAJOR_VER >= 30
+    obs_encoder_set_frame_rate_divisor(video_encoder, divisor ? divisor : 1);
+#else
+    if (divisor > 1) {
+      error = "Error: fpsDivisor requires libobs 30 or later";
+      return false;
+    }
+#endif
+    obs_encoder_set_scaled_size(video_encoder, width, height);
+    scale_width = width;
+    scale_height = height;
+    fps_divisor = divisor > 1 ? divisor : 0;
+    return true;
+  }
+
+  // Releases the encoders; also called by shutdown for pairs still held.
+  void release() {
+    {
+      std::lock_guard<std::mutex> lock(encoder_registry_mutex);
+      encoder_registry.erase(this);
+    }
+
+    if(video_encoder) {
+      obs_encoder_release(video_encoder);
+      video_encoder = nullptr;
+    }
+    if(audio_encoder) {
+      obs_encoder_release(audio_encoder);
+      audio_encoder = nullptr;
+    }
+    canvas.reset();
+  }
+
+  ~ObsEncoderContext() {
+    release();
+  }
+};
+
+// Creates the encoders of a config. Runs on the command thread.
+static bool createEncoders(ObsEncoderConfig& config,
+    std::shared_ptr<ObsEncoderContext>& encoders, std::string& error) {
+  encoders = std::make_shared<ObsEncoderContext>();
+  encoders->name = config.name;
+  encoders->audio_mixer = config.audio_mixer;
+
+  if (!config.canvas.empty()) {
+    auto it = canvases.find(config.canvas);
+    if (it == canvases.end()) {
+      error = "Error: no canvas named " + config.canvas;
+      return false;
+    }
+    encoders->canvas = it->second;
+  }
+
+  if (config.video_id == AUTO_ENCODER_ID) {
+    ObsEncoderSelection selection;
+    if (!selectVideoEncoder(ObsEncoderSelectOptions(), selection, error))
+      return false;
+    config.video_id = selection.id;
+  }
+
+  obs_data_t* settings;
+  if (!config.video_id.empty()) {
+    settings = dataFromJson(config.video_settings);
+    encoders->video_encoder = obs_video_encoder_create(config.video_id.c_str(),
+        (config.name + "_video").c_str(), settings, nullptr);
+    obs_data_release(settings);
+    if (!encoders->video_encoder) {
+      error = "Error: could not create video encoder " + config.video_id;
+      return false;
+    }
+    if ((config.scale_width || config.fps_divisor) &&
+        !encoders->setScale(config.scale_width, config.scale_height, config.fps_divisor, error))
+      return false;
+    encoders->readVideoBitrate();
+  }
+
+  if (!config.audio_id.empty()) {
+    settings = dataFromJson(config.audio_settings);
+    encoders->audio_encoder = obs_audio_encoder_create(config.audio_id.c_str(),
+        (config.name + "_audio").c_str(), settings, config.audio_mixer, nullptr);
+    obs_data_release(settings);
+    if (!encoders->audio_encoder) {
+      error = "Error: could not create audio encoder " + config.audio_id;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Handle to an encoder pair that outputs can share.
+// Pass it as createOutput({ encoders }) to bind it to any number of outputs;
+// each output starts and stops on its own while the others keep streaming.
+// An output started while the encoders already run joins at the next keyframe.
+//
+// JS: createEncoders({ name, video, audio }) -> Promise<Encoders>
+//     encoders.update({ video: { settings }, audio: { settings } }) -> Promise
+//     encoders.setScale({ width, height, fpsDivisor }) -> Promise<{ width, height,
+//         fpsDivisor, restarted: [name] }>
+//     encoders.isActive(), encoders.release()
+class ObsEncoders : public Napi::ObjectWrap<ObsEncoders> {
+public:
+  static void Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "Encoders", {
+      InstanceMethod("update", &ObsEncoders::Update),
+      InstanceMethod("setScale", &ObsEncoders::SetScale),
+      InstanceMethod("isActive", &ObsEncoders::IsActive),
+      InstanceMethod("release", &ObsEncoders::Release),
+    });
+
+    constructor = Napi::Persistent(func);
+    constructor.SuppressDestruct();
+
+    exports.Set("Encoders", func);
+  }
+
+  static Napi::Object NewInstance(Napi::Env env, std::shared_ptr<ObsEncoderContext>& context) {
+    return constructor.New({ Napi::External<std::shared_ptr<ObsEncoderContext>>::New(env, &context) });
+  }
+
+  // The encoder pair behind a JS value, or nullptr when it is not a live Encoders handle.
+  static std::shared_ptr<ObsEncoderContext> FromValue(Napi::Value value) {
+    if (!value.IsObject() || !value.As<Napi::Object>().InstanceOf(constructor.Value()))
+      return nullptr;
+    return Unwrap(value.As<Napi::Object>())->context;
+  }
+
+  ObsEncoders(const Napi::CallbackInfo& info) : Napi::ObjectWrap<ObsEncoders>(info) {
+    if (info.Length() != 1 || !info[0].IsExternal()) {
+      Napi::TypeError::New(info.Env(), "Use createEncoders() to create encoders")
+          .ThrowAsJavaScriptException();
+      return;
+    }
+
+    context = *info[0].As<Napi::External<std::shared_ptr<ObsEncoderContext>>>().Data();
+  }
+
+  ~ObsEncoders() {
+    releaseContext(Env());
+  }
+
+private:
+  static Napi::FunctionReference constructor;
+
+  Napi::Value Update(const Napi::CallbackInfo& info);
+  Napi::Value SetScale(const Napi::CallbackInfo& info);
+
+  Napi::Value IsActive(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), context && context->active());
+  }
+
+  // Outputs already bound keep the encoders alive after release().
+  Napi::Value Release(const Napi::CallbackInfo& info) {
+    releaseContext(info.Env());
+    return info.Env().Undefined();
+  }
+
+  void releaseContext(napi_env env) {
+    if (!context)
+      return;
+    std::shared_ptr<ObsEncoderContext> released;
+    released.swap(context);
+    ObsTaskWorker::Post(env, [released]() mutable { released.reset(); });
+  }
+
+  std::shared_ptr<ObsEncoderContext> context;
+};
+
+Napi::FunctionReference ObsEncoders::constructor;
+
+// Asynchronously creates a shareable encoder pair.
+//
+class AsyncCreateEncodersWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    ObsEncoderConfig config;
+    config.name = "obsapi_encoders";
+    if (info.Length() != 1 || !info[0].IsObject() ||
+        !getString(info[0].As<Napi::Object>(), "name", config.name) ||
+        !parseEncoderConfig(env, info[0].As<Napi::Object>(), config, true) ||
+        (config.video_id.empty() && config.audio_id.empty())) {
+      Napi::TypeError::New(env, "Expected an encoder config object with video and/or audio")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncCreateEncodersWorker* worker = new AsyncCreateEncodersWorker(env, config);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error) || !createEncoders(config, context, error)) {
+      context.reset();
+      SetError(error);
+      return;
+    }
+    context->shared = true;
+  }
+
+  virtual void OnOK() override {
+    deferredPromise.Resolve(ObsEncoders::NewInstance(Env(), context));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncCreateEncodersWorker(napi_env env, ObsEncoderConfig& config) :
+    ObsCommandWorker(env),
+    config(config),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  ObsEncoderConfig config;
+  std::shared_ptr<ObsEncoderContext> context;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Asynchronously updates the settings of an encoder pair, for every output bound to it.
+//
+class AsyncUpdateEncodersWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(Napi::Env env, std::shared_ptr<ObsEncoderContext> context,
+      const ObsEncoderConfig& config) {
+    if (!context) {
+      Napi::TypeError::New(env, "Error: encoders have been released")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncUpdateEncodersWorker* worker = new AsyncUpdateEncodersWorker(env, context, config);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    context->update(config);
+  }
+
+  virtual void OnOK() override {
+    deferredPromise.Resolve(Napi::String::New(Env(), "ok"));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncUpdateEncodersWorker(napi_env env, std::shared_ptr<ObsEncoderContext>& context,
+      const ObsEncoderConfig& config) :
+    ObsCommandWorker(env),
+    context(context),
+    config(config),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  std::shared_ptr<ObsEncoderContext> context;
+  ObsEncoderConfig config;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+Napi::Value ObsEncoders::Update(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  ObsEncoderConfig config;
+  if (info.Length() != 1 || !info[0].IsObject() ||
+      !parseEncoderConfig(env, info[0].As<Napi::Object>(), config, false)) {
+    Napi::TypeError::New(env, "Expected a settings object")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return AsyncUpdateEncodersWorker::Create(env, context, config);
+}
+
+// RTMP networking options of an "rtmp_output", parsed on the JS thread.
+//   server, key, username, password:
+//                    Create an "rtmp_custom" service when no service is given
+//   bindIp:          Local address to send from ("default" for any)
+//   newSocketLoop:   Send from a dedicated socket thread with its own
+//                    buffer, which cuts send latency and CPU on lossy uplinks
+//                    (Windows only in libobs)
+//   lowLatency:      Smaller send buffer of the new socket loop
+//   dynamicBitrate:  Let libobs lower the bitrate on congestion instead of dropping frames
+//   dropThresholdMs, pframeDropThresholdMs:
+//                    Buffered duration after which frames are dropped
+//   maxShutdownSec:  How long stop() may flush before giving up
+//   reconnect:       { retries, delaySec }; retries 0 disables reconnecting.
+//                    libobs doubles the delay after each failed attempt.
+// Settings only take effect on the next start.
+struct ObsRtmpOptions {
+  bool present = false;
+  std::string server;
+  std::string key;
+  std::string username;
+  std::string password;
+  std::string bind_ip;
+  int new_socket_loop = -1;  // -1: leave the output's setting alone
+  int low_latency = -1;
+  int dynamic_bitrate = -1;
+  double drop_threshold_ms = -1;
+  double pframe_drop_threshold_ms = -1;
+  double max_shutdown_sec = -1;
+  double reconnect_retries = -1;
+  double reconnect_delay_sec = -1;
+};
+
+static bool getFlag(const Napi::Object& obj, const char* key, int& out) {
+  if (obj.Has(key))
+    out = obj.Get(key).ToBoolean() ? 1 : 0;
+  return true;
+}
+
+static bool parseRtmpOptions(const Napi::Object& options, ObsRtmpOptions& rtmp) {
+  if (!options.Has("rtmp"))
+    return true;
+  if (!options.Get("rtmp").IsObject())
+    return false;
+
+  Napi::Object obj = options.Get("rtmp").As<Napi::Object>();
+  rtmp.present = true;
+  if (!getString(obj, "server", rtmp.server) ||
+      !getString(obj, "key", rtmp.key) ||
+      !getString(obj, "username", rtmp.username) ||
+      !getString(obj, "password", rtmp.password) ||
+      !getString(obj, "bindIp", rtmp.bind_ip) ||
+      !getFlag(obj, "newSocketLoop", rtmp.new_socket_loop) ||
+      !getFlag(obj, "lowLatency", rtmp.low_latency) ||
+      !getFlag(obj, "dynamicBitrate", rtmp.dynamic_bitrate) ||
+      !getNumber(obj, "dropThresholdMs", 0, 100000, rtmp.drop_threshold_ms) ||
+      !getNumber(obj, "pframeDropThresholdMs", 0, 100000, rtmp.pframe_drop_threshold_ms) ||
+      !getNumber(obj, "maxShutdownSec", 0, 3600, rtmp.max_shutdown_sec))
+    return false;
+
+  if (obj.Has("reconnect")) {
+    if (!obj.Get("reconnect").IsObject())
+      return false;
+    Napi::Object reconnect = obj.Get("reconnect").As<Napi::Object>();
+    if (!getNumber(reconnect, "retries", 0, 10000, rtmp.reconnect_retries) ||
+        !getNumber(reconnect, "delaySec", 0, 3600, rtmp.reconnect_delay_sec))
+      return false;
+  }
+  return true;
+}
+
+// Writes the rtmp_output settings of the options into settings.
+static void applyRtmpSettings(const ObsRtmpOptions& rtmp, obs_data_t* settings) {
+  if (!rtmp.bind_ip.empty())
+    obs_data_set_string(settings, "bind_ip", rtmp.bind_ip.c_str());
+  if (rtmp.new_socket_loop >= 0)
+    obs_data_set_bool(settings, "new_socket_loop_enabled", rtmp.new_socket_loop == 1);
+  if (rtmp.low_latency >= 0)
+    obs_data_set_bool(settings, "low_latency_mode_enabled", rtmp.low_latency == 1);
+  if (rtmp.dynamic_bitrate >= 0)
+    obs_data_set_bool(settings, "dyn_bitrate", rtmp.dynamic_bitrate == 1);
+  if (rtmp.drop_threshold_ms >= 0)
+    obs_data_set_int(settings, "drop_threshold_ms", (long long)rtmp.drop_threshold_ms);
+  if (rtmp.pframe_drop_threshold_ms >= 0)
+    obs_data_set_int(settings, "pframe_drop_threshold_ms", (long long)rtmp.pframe_drop_threshold_ms);
+  if (rtmp.max_shutdown_sec >= 0)
+    obs_data_set_int(settings, "max_shutdown_time_sec", (long long)rtmp.max_shutdown_sec);
+}
+
+// Applies the reconnect policy of the options, when they set one.
+static void applyRtmpReconnect(const ObsRtmpOptions& rtmp, obs_output_t* output) {
+  if (rtmp.reconnect_retries < 0 && rtmp.reconnect_delay_sec < 0)
+    return;
+  // libobs does not report the current policy, so unset values take its defaults.
+  int retries = rtmp.reconnect_retries >= 0 ? (int)rtmp.reconnect_retries : DEFAULT_RECONNECT_RETRIES;
+  int delay_sec = rtmp.reconnect_delay_sec >= 0 ? (int)rtmp.reconnect_delay_sec : DEFAULT_RECONNECT_DELAY_SEC;
+  obs_output_set_reconnect_settings(output, retries, delay_sec);
+}
+
+// Settings of the "rtmp_custom" service for the options' server and key.
+static obs_data_t* rtmpServiceSettings(const ObsRtmpOptions& rtmp) {
+  obs_data_t* settings = obs_data_create();
+  obs_data_set_string(settings, "server", rtmp.server.c_str());
+  obs_data_set_string(settings, "key", rtmp.key.c_str());
+  if (!rtmp.username.empty() || !rtmp.password.empty()) {
+    obs_data_set_bool(settings, "use_auth", true);
+    obs_data_set_string(settings, "username", rtmp.username.c_str());
+    obs_data_set_string(settings, "password", rtmp.password.c_str());
+  }
+  return settings;
+}
+
+// Configuration of an output session, parsed on the JS thread.
+//   type:     Output id (E.G. "rtmp_output")
+//   name:     Output name
+//   settings: Output settings
+//   video:    { id, settings } of the video encoder; id "auto" uses selectVideoEncoder()
+//   audio:    { id, settings, mixer } of the audio encoder
+//   encoders: Encoders from createEncoders(), instead of video and audio
+//   service:  { id, settings } of the service (E.G. "rtmp_custom" with server/key)
+//   rtmp:     ObsRtmpOptions of an "rtmp_output"
+struct ObsOutputConfig {
+  std::string type;
+  std::string name = "obsapi_output";
+  std::string settings;
+  ObsEncoderConfig encoders;
+  std::shared_ptr<ObsEncoderContext> shared_encoders;
+  std::string service_id;
+  std::string service_settings;
+  ObsRtmpOptions rtmp;
+};
+
+static bool parseOutputConfig(Napi::Env env, const Napi::Object& options, ObsOutputConfig& config) {
+  if (!getString(options, "type", config.type) ||
+      !getString(options, "name", config.name) ||
+      !getSettingsJson(env, options, config.settings) ||
+      !parseEncoderConfig(env, options, config.encoders, true) ||
+      !parseComponent(env, options, "service", config.service_id, config.service_settings, true) ||
+      !parseRtmpOptions(options, config.rtmp))
+    return false;
+
+  config.encoders.name = config.name;
+  if (config.rtmp.present && config.type != RTMP_OUTPUT_ID)
+    return false;
+  if (config.service_id.empty() && !config.rtmp.server.empty())
+    config.service_id = RTMP_SERVICE_ID;
+
+  if (options.Has("encoders")) {
+    config.shared_encoders = ObsEncoders::FromValue(options.Get("encoders"));
+    if (!config.shared_encoders || options.Has("video") || options.Has("audio"))
+      return false;
+  }
+
+  return true;
+}
+
+// Replay buffer
+// A "replay_buffer" output keeps the last max_time_sec / max_size_mb of
+// encoded packets in memory, trimmed to start on a keyframe, and muxes them
+// to a file on its own thread when saved, so saving never stalls the
+// encoders. Bind it to shared encoders to add clips without a second encode.
+//
+// JS: createOutput({ type: 'replay_buffer', encoders,
+//                    settings: { max_time_sec, max_size_mb } }) -> Promise<Output>
+//     output.saveReplay(path) -> Promise<path>
+//
+// libobs does not report how much the buffer holds, so a meter output bound
+// to the same encoders mirrors its trimming with packet sizes only and feeds
+// replay { bytes, seconds } into the stats stream.
+#define REPLAY_OUTPUT_ID ("replay_buffer")
+#define REPLAY_METER_OUTPUT_ID ("obsapi_replay_meter")
+#define DEFAULT_REPLAY_MAX_SECONDS 60
+#define DEFAULT_REPLAY_MAX_SIZE_MB 512
+#define REPLAY_SAVE_TIMEOUT_MS 30000
+
+// Plugin data of the replay meter output.
+struct ObsReplayMeter {
+  struct Packet {
+    size_t size;
+    int64_t dts_usec;
+    bool keyframe;
+  };
+
+  obs_output_t* output = nullptr;
+  std::mutex mutex;
+  std::deque<Packet> packets;
+  uint64_t size = 0;
+  uint64_t max_size = 0;
+  int64_t max_usec = 0;
+
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<int64_t> duration_usec{0};
+
+  void configure(obs_data_t* settings) {
+    std::lock_guard<std::mutex> lock(mutex);
+    max_size = (uint64_t)obs_data_get_int(settings, "max_size_mb") * 1024 * 1024;
+    max_usec = obs_data_get_int(settings, "max_time_sec") * 1000000;
+  }
+
+  // Same trimming as the replay buffer: drop the oldest packet, then
+  // everything up to the next video keyframe.
+  void purgeFront() {
+    size -= packets.front().size;
+    packets.pop_front();
+    while (!packets.empty() && !packets.front().keyframe) {
+      size -= packets.front().size;
+      packets.pop_front();
+    }
+  }
+
+  void add(const struct encoder_packet* packet) {
+    std::lock_guard<std::mutex> lock(mutex);
+    packets.push_back({ packet->size, packet->dts_usec,
+        packet->type == OBS_ENCODER_VIDEO && packet->keyframe });
+    size += packet->size;
+
+    while (!packets.empty() &&
+        ((max_size && size > max_size) ||
+         (max_usec && packets.back().dts_usec - packets.front().dts_usec > max_usec)))
+      purgeFront();
+
+    bytes = size;
+    duration_usec = packets.empty() ? 0 : packets.back().dts_usec - packets.front().dts_usec;
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    packets.clear();
+    size = 0;
+    bytes = 0;
+    duration_usec = 0;
+  }
+};
+
+static const char* replayMeterGetName(void*) {
+  return "obsapi replay meter";
+}
+
+static void replayMeterGet(void* data, calldata_t* cd) {
+  calldata_set_ptr(cd, "meter", data);
+}
+
+static void* replayMeterCreate(obs_data_t* settings, obs_output_t* output) {
+  ObsReplayMeter* meter = new ObsReplayMeter();
+  meter->output = output;
+  meter->configure(settings);
+  proc_handler_add(obs_output_get_proc_handler(output), "void get_meter(out ptr meter)",
+      replayMeterGet, meter);
+  return meter;
+}
+
+static void replayMeterDestroy(void* data) {
+  delete (ObsReplayMeter*)data;
+}
+
+static void replayMeterUpdate(void* data, obs_data_t* settings) {
+  ((ObsReplayMeter*)data)->configure(settings);
+}
+
+static bool replayMeterStart(void* data) {
+  ObsReplayMeter* meter = (ObsReplayMeter*)data;
+  if (!obs_output_can_begin_data_capture(meter->output, 0) ||
+      !obs_output_initialize_encoders(meter->output, 0))
+    return false;
+  return obs_output_begin_data_capture(meter->output, 0);
+}
+
+static void replayMeterStop(void* data, uint64_t) {
+  ObsReplayMeter* meter = (ObsReplayMeter*)data;
+  obs_output_end_data_capture(meter->output);
+  meter->clear();
+}
+
+static void replayMeterPacket(void* data, struct encoder_packet* packet) {
+  if (packet)
+    ((ObsReplayMeter*)data)->add(packet);
+}
+
+// Registers the replay meter output type once per OBS session.
+static void registerReplayMeter() {
+  if (obs_output_get_display_name(REPLAY_METER_OUTPUT_ID))
+    return;
+
+  struct obs_output_info info = {};
+  info.id = REPLAY_METER_OUTPUT_ID;
+  info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED;
+  info.get_name = replayMeterGetName;
+  info.create = replayMeterCreate;
+  info.destroy = replayMeterDestroy;
+  info.update = replayMeterUpdate;
+  info.start = replayMeterStart;
+  info.stop = replayMeterStop;
+  info.encoded_packet = replayMeterPacket;
+  obs_register_output(&info);
+}
+
+// Fills in the buffer limits a replay buffer config leaves out.
+static void setReplayDefaults(obs_data_t* settings) {
+  obs_data_set_default_int(settings, "max_time_sec", DEFAULT_REPLAY_MAX_SECONDS);
+  obs_data_set_default_int(settings, "max_size_mb", DEFAULT_REPLAY_MAX_SIZE_MB);
+}
+
+// Output events
+// Every output created through the addon connects its start, stop, activate,
+// deactivate, reconnect and reconnect_success signals. Events raised while a
+// delivery is pending join the same batch, so a burst such as a reconnect
+// loop costs one JS call per turn of the event loop. start() resolves as
+// soon as libobs begins starting; "start" follows once the output is
+// actually connected and sending.
+//
+// JS: subscribeOutputEvents(cb) -> unsubscribe()
+//     cb([{ output, type, timestamp, code?, reason?, error? }])
+//     code and reason (E.G. "disconnected") come with "stop"; error is the
+//     output's last error, when it has one
+struct ObsOutputEvent {
+  std::string output;
+  const char* type;
+  double timestamp;
+  bool has_code = false;
+  long long code = OBS_OUTPUT_SUCCESS;
+  std::string error;
+};
+
+static const ObsEnumName<long long> STOP_CODE_NAMES[] = {
+  { "success", OBS_OUTPUT_SUCCESS },
+  { "bad_path", OBS_OUTPUT_BAD_PATH },
+  { "connect_failed", OBS_OUTPUT_CONNECT_FAILED },
+  { "invalid_stream", OBS_OUTPUT_INVALID_STREAM },
+  { "error", OBS_OUTPUT_ERROR },
+  { "disconnected", OBS_OUTPUT_DISCONNECTED },
+  { "unsupported", OBS_OUTPUT_UNSUPPORTED },
+  { "no_space", OBS_OUTPUT_NO_SPACE },
+  { "encode_error", OBS_OUTPUT_ENCODE_ERROR },
+};
+
+class ObsOutputEventSubscription {
+public:
+  Napi::ThreadSafeFunction tsfn;
+
+  // Runs on the thread that raised the signal.
+  void push(const ObsOutputEvent& event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(event);
+    if (!scheduled)
+      scheduled = tsfn.NonBlockingCall(this, deliver) == napi_ok;
+  }
+
+private:
+  static void deliver(Napi::Env env, Napi::Function callback, ObsOutputEventSubscription* sub) {
+    std::vector<ObsOutputEvent> batch;
+    {
+      std::lock_guard<std::mutex> lock(sub->mutex);
+      batch.swap(sub->pending);
+      sub->scheduled = false;
+    }
+
+    Napi::Array events = Napi::Array::New(env, batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+      const ObsOutputEvent& event = batch[i];
+      Napi::Object item = Napi::Object::New(env);
+      item.Set("output", Napi::String::New(env, event.output));
+      item.Set("type", Napi::String::New(env, event.type));
+      item.Set("timestamp", Napi::Number::New(env, event.timestamp));
+      if (event.has_code) {
+        item.Set("code", Napi::Number::New(env, (double)event.code));
+        item.Set("reason", Napi::String::New(env, enumName(STOP_CODE_NAMES, event.code)));
+      }
+      if (!event.error.empty())
+        item.Set("error", Napi::String::New(env, event.error));
+      events.Set(i, item);
+    }
+    callback.Call({ events });
+  }
+
+  std::mutex mutex;
+  std::vector<ObsOutputEvent> pending;
+  bool scheduled = false;
+};
+
+static std::mutex output_event_mutex;
+static std::map<uint32_t, std::shared_ptr<ObsOutputEventSubscription>> output_event_subscriptions;
+static uint32_t next_output_event_subscription = 1;
+
+static void publishOutputEvent(calldata_t* cd, const char* type, bool has_code) {
+  std::lock_guard<std::mutex> lock(output_event_mutex);
+  if (output_event_subscriptions.empty())
+    return;
+
+  obs_output_t* output = (obs_output_t*)calldata_ptr(cd, "output");
+  ObsOutputEvent event;
+  event.output = output ? obs_output_get_name(output) : "";
+  event.type = type;
+  event.timestamp = (double)os_gettime_ns() / 1000000.0;
+  event.has_code = has_code;
+  if (has_code)
+    event.code = calldata_int(cd, "code");
+  const char* last_error = output ? obs_output_get_last_error(output) : nullptr;
+  if (last_error)
+    event.error = last_error;
+
+  for (auto& kv : output_event_subscriptions)
+    kv.second->push(event);
+}
+
+static void onOutputStart(void*, calldata_t* cd) { publishOutputEvent(cd, "start", false); }
+static void onOutputStop(void*, calldata_t* cd) { publishOutputEvent(cd, "stop", true); }
+static void onOutputActivate(void*, calldata_t* cd) { publishOutputEvent(cd, "activate", false); }
+static void onOutputDeactivate(void*, calldata_t* cd) { publishOutputEvent(cd, "deactivate", false); }
+static void onOutputReconnect(void*, calldata_t* cd) { publishOutputEvent(cd, "reconnect", false); }
+static void onOutputReconnectSuccess(void*, calldata_t* cd) {
+  publishOutputEvent(cd, "reconnect_success", false);
+}
+
+static const struct {
+  const char* signal;
+  signal_callback_t callback;
+} OUTPUT_EVENT_SIGNALS[] = {
+  { "start", onOutputStart },
+  { "stop", onOutputStop },
+  { "activate", onOutputActivate },
+  { "deactivate", onOutputDeactivate },
+  { "reconnect", onOutputReconnect },
+  { "reconnect_success", onOutputReconnectSuccess },
+};
+
+// Connects or disconnects the event signals of an output. Runs on the command thread.
+static void connectOutputEvents(obs_output_t* output, bool connect) {
+  signal_handler_t* signals = obs_output_get_signal_handler(output);
+  for (const auto& entry : OUTPUT_EVENT_SIGNALS) {
+    if (connect)
+      signal_handler_connect(signals, entry.signal, entry.callback, nullptr);
+    else
+      signal_handler_disconnect(signals, entry.signal, entry.callback, nullptr);
+  }
+}
+
+// Stops every output event subscription. Called from the JS thread before shutdown.
+static void stopOutputEventSubscriptions() {
+  std::map<uint32_t, std::shared_ptr<ObsOutputEventSubscription>> subscriptions;
+  {
+    std::lock_guard<std::mutex> lock(output_event_mutex);
+    subscriptions.swap(output_event_subscriptions);
+  }
+  for (auto& kv : subscriptions)
+    kv.second->tsfn.Release();
+}
+
+Napi::Value obsSubscribeOutputEvents(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!initRequested()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() != 1 || !info[0].IsFunction()) {
+    Napi::TypeError::New(env, "Expected a callback")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // Queued deliveries point at the subscription, so the function keeps it alive.
+  std::shared_ptr<ObsOutputEventSubscription> sub = std::make_shared<ObsOutputEventSubscription>();
+  sub->tsfn = Napi::ThreadSafeFunction::New(env, info[0].As<Napi::Function>(),
+      "obsapi_output_events", 0, 1, new std::shared_ptr<ObsOutputEventSubscription>(sub),
+      [](Napi::Env, std::shared_ptr<ObsOutputEventSubscription>* context) { delete context; });
+
+  uint32_t id = next_output_event_subscription++;
+  {
+    std::lock_guard<std::mutex> lock(output_event_mutex);
+    output_event_subscriptions[id] = sub;
+  }
+
+  return Napi::Function::New(env, [id](const Napi::CallbackInfo& info) {
+    std::shared_ptr<ObsOutputEventSubscription> sub;
+    {
+      std::lock_guard<std::mutex> lock(output_event_mutex);
+      auto it = output_event_subscriptions.find(id);
+      if (it == output_event_subscriptions.end())
+        return info.Env().Undefined();
+      sub = it->second;
+      output_event_subscriptions.erase(it);
+    }
+    sub->tsfn.Release();
+    return info.Env().Undefined();
+  }, "unsubscribe");
+}
+
+// Every live output session, for samplers that run outside the JS thread.
+// A context removes itself before releasing its output, so holding
+// output_registry_mutex keeps the registered outputs valid.
+struct ObsOutputContext;
+static std::mutex output_registry_mutex;
+static std::set<ObsOutputContext*> output_registry;
+
+// A deferred command waiting for an output's "stop" signal.
+struct ObsStopWaiter {
+  virtual void onStopped(long long code) = 0;
+};
+
+// Native state of an output session: the output, the encoder pair it is bound
+// to and the service it owns. Shared between the JS handle and in-flight
+// workers, and released when the last of them lets go. The encoder pair is
+// either the output's own or shared with other outputs through createEncoders().
+struct ObsOutputContext {
+  obs_output_t* output = nullptr;
+  std::shared_ptr<ObsEncoderContext> encoders;
+  obs_service_t* streaming_service = nullptr;
+  size_t audio_index = 0;
+
+  // Set for replay buffers only.
+  obs_output_t* replay_meter = nullptr;
+  ObsReplayMeter* meter = nullptr;
+
+  std::mutex mutex;
+  std::condition_variable stopped_cv;
+  bool stopped = true;
+  long long stop_code = OBS_OUTPUT_SUCCESS;
+  std::vector<ObsStopWaiter*> stop_waiters;
+
+  static void onStop(void* data, calldata_t* cd) {
+    ObsOutputContext* ctx = (ObsOutputContext*)data;
+    {
+      std::lock_guard<std::mutex> lock(ctx->mutex);
+      ctx->stopped = true;
+      ctx->stop_code = calldata_int(cd, "code");
+      for (ObsStopWaiter* waiter : ctx->stop_waiters)
+        waiter->onStopped(ctx->stop_code);
+      ctx->stop_waiters.clear();
+    }
+    ctx->stopped_cv.notify_all();
+  }
+
+  // Starts the output and its replay meter. Runs on the command thread.
+  bool start(std::string& error) {
+    if (obs_output_active(output))
+      return true;
+
+    encoders->rebind();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopped = false;
+    }
+
+    if (!obs_output_start(output)) {
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopped = true;
+      }
+      const char* last_error = obs_output_get_last_error(output);
+      error = std::string("Error: could not start output") +
+          (last_error ? std::string(": ") + last_error : std::string());
+      return false;
+    }
+
+    if (replay_meter && !obs_output_start(replay_meter))
+      blog(LOG_WARNING, "obsapi: could not start replay meter for %s",
+          obs_output_get_name(output));
+    return true;
+  }
+
+  // Asks the output and its replay meter to stop; the output signals "stop"
+  // once it has flushed its last packets.
+  void requestStop() {
+    if (replay_meter)
+      obs_output_stop(replay_meter);
+    obs_output_stop(output);
+  }
+
+  // Waits for the "stop" signal until the deadline and fills in its code.
+  bool waitStopped(std::chrono::steady_clock::time_point deadline, long long& code) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!stopped_cv.wait_until(lock, deadline, [this] { return stopped; }))
+      return false;
+    code = stop_code;
+    return true;
+  }
+
+  // Releases the output, its meter, its encoders and its service; also
+  // called by shutdown for sessions still held.
+  void release() {
+    {
+      std::lock_guard<std::mutex> lock(output_registry_mutex);
+      output_registry.erase(this);
+    }
+
+    if(replay_meter) {
+      if (obs_output_active(replay_meter))
+        obs_output_force_stop(replay_meter);
+      obs_output_release(replay_meter);
+      replay_meter = nullptr;
+      meter = nullptr;
+    }
+
+    if(output) {
+      signal_handler_disconnect(obs_output_get_signal_handler(output), "stop", onStop, this);
+      connectOutputEvents(output, false);
+      if (obs_output_active(output))
+        obs_output_force_stop(output);
+      obs_output_release(output);
+      output = nullptr;
+    }
+
+    encoders.reset();
+
+    if(streaming_service) {
+      obs_service_release(streaming_service);
+      streaming_service = nullptr;
+    }
+  }
+
+  ~ObsOutputContext() {
+    release();
+  }
+};
+
+// Handle to a persistent output session.
+// The output, its encoders and its service live as long as the handle, so
+// stopping and starting again reuses the already-created encoders.
+//
+// JS: createOutput(config) -> Promise<Output>
+//     output.start() / output.stop() / output.update(config) -> Promise
+//     output.saveReplay(path) -> Promise<path>, for replay buffers
+//     output.enableAbr(options, cb) -> Promise<disable()>
+//     output.isActive(), output.release()
+class ObsOutput : public Napi::ObjectWrap<ObsOutput> {
+public:
+  static void Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "Output", {
+      InstanceMethod("start", &ObsOutput::Start),
+      InstanceMethod("stop", &ObsOutput::Stop),
+      InstanceMethod("update", &ObsOutput::Update),
+      InstanceMethod("saveReplay", &ObsOutput::SaveReplay),
+      InstanceMethod("enableAbr", &ObsOutput::EnableAbr),
+      InstanceMethod("isActive", &ObsOutput::IsActive),
+      InstanceMethod("release", &ObsOutput::Release),
+    });
+
+    constructor = Napi::Persistent(func);
+    constructor.SuppressDestruct();
+
+    exports.Set("Output", func);
+  }
+
+  static Napi::Object NewInstance(Napi::Env env, std::shared_ptr<ObsOutputContext>& context) {
+    return constructor.New({ Napi::External<std::shared_ptr<ObsOutputContext>>::New(env, &context) });
+  }
+
+  ObsOutput(const Napi::CallbackInfo& info) : Napi::ObjectWrap<ObsOutput>(info) {
+    if (info.Length() != 1 || !info[0].IsExternal()) {
+      Napi::TypeError::New(info.Env(), "Use createOutput() to create an output")
+          .ThrowAsJavaScriptException();
+      return;
+    }
+
+    context = *info[0].As<Napi::External<std::shared_ptr<ObsOutputContext>>>().Data();
+  }
+
+  ~ObsOutput() {
+    releaseContext(Env());
+  }
+
+  std::shared_ptr<ObsOutputContext> Context() const { return context; }
+
+private:
+  static Napi::FunctionReference constructor;
+
+  Napi::Value Start(const Napi::CallbackInfo& info);
+  Napi::Value Stop(const Napi::CallbackInfo& info);
+  Napi::Value Update(const Napi::CallbackInfo& info);
+  Napi::Value SaveReplay(const Napi::CallbackInfo& info);
+  Napi::Value EnableAbr(const Napi::CallbackInfo& info);
+
+  Napi::Value IsActive(const Napi::CallbackInfo& info) {
+    return Napi::Boolean::New(info.Env(), context && obs_output_active(context->output));
+  }
+
+  Napi::Value Release(const Napi::CallbackInfo& info) {
+    releaseContext(info.Env());
+    return info.Env().Undefined();
+  }
+
+  // Drops the handle's reference on the command thread, where the output,
+  // encoders and service are released if nothing else holds them.
+  void releaseContext(napi_env env) {
+    if (!context)
+      return;
+    std::shared_ptr<ObsOutputContext> released;
+    released.swap(context);
+    ObsTaskWorker::Post(env, [released]() mutable { released.reset(); });
+  }
+
+  std::shared_ptr<ObsOutputContext> context;
+};
+
+Napi::FunctionReference ObsOutput::constructor;
+
+// Creates the replay meter of a replay buffer, bound to its encoders.
+static bool createReplayMeter(ObsOutputContext* context, const std::string& name) {
+  registerReplayMeter();
+
+  obs_data_t* settings = obs_output_get_settings(context->output);
+  context->replay_meter = obs_output_create(REPLAY_METER_OUTPUT_ID,
+      (name + "_meter").c_str(), settings, nullptr);
+  obs_data_release(settings);
+  if (!context->replay_meter)
+    return false;
+
+  if (context->encoders->video_encoder)
+    obs_output_set_video_encoder(context->replay_meter, context->encoders->video_encoder);
+  if (context->encoders->audio_encoder)
+    obs_output_set_audio_encoder(context->replay_meter, context->encoders->audio_encoder, 0);
+
+  calldata_t cd = {};
+  proc_handler_call(obs_output_get_proc_handler(context->replay_meter), "get_meter", &cd);
+  context->meter = (ObsReplayMeter*)calldata_ptr(&cd, "meter");
+  calldata_free(&cd);
+  return context->meter != nullptr;
+}
+
+static void applyServiceSettings(ObsOutputContext* context) {
+  obs_encoder_t* video_encoder = context->encoders->video_encoder;
+  obs_encoder_t* audio_encoder = context->encoders->audio_encoder;
+  obs_data_t* video_settings = video_encoder ? obs_encoder_get_settings(video_encoder) : nullptr;
+  obs_data_t* audio_settings = audio_encoder ? obs_encoder_get_settings(audio_encoder) : nullptr;
+  obs_service_apply_encoder_settings(context->streaming_service, video_settings, audio_settings);
+  obs_data_release(video_settings);
+  obs_data_release(audio_settings);
+}
+
+// Creates the output of a config with its encoders and its service, and
+// registers it. Runs on the command thread.
+static bool createOutput(ObsOutputConfig& config, std::shared_ptr<ObsOutputContext>& context,
+    std::string& error) {
+  context = std::make_shared<ObsOutputContext>();
+
+  bool replay = config.type == REPLAY_OUTPUT_ID;
+  obs_data_t* settings = dataFromJson(config.settings);
+  if (replay)
+    setReplayDefaults(settings);
+  applyRtmpSettings(config.rtmp, settings);
+  context->output = obs_output_create(config.type.c_str(), config.name.c_str(), settings, nullptr);
+  obs_data_release(settings);
+  if (!context->output) {
+    error = "Error: could not create output " + config.type;
+    return false;
+  }
+  applyRtmpReconnect(config.rtmp, context->output);
+  signal_handler_connect(obs_output_get_signal_handler(context->output), "stop",
+      ObsOutputContext::onStop, context.get());
+  connectOutputEvents(context->output, true);
+
+  bool shared = (bool)config.shared_encoders;
+  if (shared) {
+    context->encoders = config.shared_encoders;
+  } else if (!createEncoders(config.encoders, context->encoders, error)) {
+    return false;
+  }
+
+  if (context->encoders->video_encoder)
+    obs_output_set_video_encoder(context->output, context->encoders->video_encoder);
+  if (context->encoders->audio_encoder)
+    obs_output_set_audio_encoder(context->output, context->encoders->audio_encoder,
+        context->audio_index);
+
+  if (replay && !createReplayMeter(context.get(), config.name)) {
+    error = "Error: could not create replay meter";
+    return false;
+  }
+
+  if (!config.service_id.empty()) {
+    settings = config.service_settings.empty() && !config.rtmp.server.empty() ?
+        rtmpServiceSettings(config.rtmp) : dataFromJson(config.service_settings);
+    context->streaming_service = obs_service_create(config.service_id.c_str(),
+        (config.name + "_service").c_str(), settings, nullptr);
+    obs_data_release(settings);
+    if (!context->streaming_service) {
+      error = "Error: could not create service " + config.service_id;
+      return false;
+    }
+    // Applying service limits rewrites the encoder settings in place, so
+    // shared encoders are left as configured for all of their outputs.
+    if (!shared) {
+      applyServiceSettings(context.get());
+      context->encoders->readVideoBitrate();
+    }
+    obs_output_set_service(context->output, context->streaming_service);
+  }
+
+  std::lock_guard<std::mutex> lock(output_registry_mutex);
+  output_registry.insert(context.get());
+  return true;
+}
+
+// Asynchronously creates the output, its encoders and its service.
+//
+class AsyncCreateOutputWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    ObsOutputConfig config;
+    if (info.Length() != 1 || !info[0].IsObject() ||
+        !parseOutputConfig(env, info[0].As<Napi::Object>(), config) || config.type.empty()) {
+      Napi::TypeError::New(env, "Expected an output config object with a type")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncCreateOutputWorker* worker = new AsyncCreateOutputWorker(info.Env(), config);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error) || !createOutput(config, context, error)) {
+      context.reset();
+      SetError(error);
+    }
+  }
+
+  virtual void OnOK() override {
+    deferredPromise.Resolve(ObsOutput::NewInstance(Env(), context));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncCreateOutputWorker(napi_env env, ObsOutputConfig& config) :
+    ObsCommandWorker(env),
+    config(config),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  ObsOutputConfig config;
+  std::shared_ptr<ObsOutputContext> context;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Asynchronously starts, stops or updates an output session.
+// stop() resolves once the output has signalled "stop", with its stop code;
+// the command thread does not wait for it in the meantime.
+// Outputs sharing encoders start and stop independently; the encoders keep
+// running while any of them is active.
+//
+class AsyncOutputWorker : public ObsCommandWorker, public ObsStopWaiter {
+public:
+  enum class Op { START, STOP, UPDATE };
+
+  static Napi::Value Create(Napi::Env env, std::shared_ptr<ObsOutputContext> context,
+      Op op, const ObsOutputConfig& config = ObsOutputConfig()) {
+    if (!context) {
+      Napi::TypeError::New(env, "Error: output has been released")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncOutputWorker* worker = new AsyncOutputWorker(env, context, op, config);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    if (!context->output) {
+      SetError("Error: output has been released");
+      return;
+    }
+
+    switch (op) {
+    case Op::START:
+      start();
+      break;
+    case Op::STOP:
+      stop();
+      break;
+    case Op::UPDATE:
+      update();
+      break;
+    }
+  }
+
+  virtual void OnOK() override {
+    Napi::Env env = Env();
+    if (op == Op::STOP)
+      deferredPromise.Resolve(Napi::Number::New(env, (double)stop_code));
+    else
+      deferredPromise.Resolve(Napi::String::New(env, "ok"));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+  void OnTimeout() override {
+    {
+      std::lock_guard<std::mutex> lock(context->mutex);
+      std::vector<ObsStopWaiter*>& waiters = context->stop_waiters;
+      waiters.erase(std::remove(waiters.begin(), waiters.end(), this), waiters.end());
+    }
+    SetError("Error: timed out waiting for the output to stop");
+  }
+
+  // Called from the "stop" signal with the context's mutex held.
+  void onStopped(long long code) override {
+    stop_code = code;
+    Finish();
+  }
+
+private:
+  AsyncOutputWorker(napi_env env, std::shared_ptr<ObsOutputContext>& context,
+      Op op, const ObsOutputConfig& config) :
+    ObsCommandWorker(env),
+    context(context),
+    op(op),
+    config(config),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  void start() {
+    std::string error;
+    if (!context->start(error))
+      SetError(error);
+  }
+
+  void stop() {
+    context->requestStop();
+    std::lock_guard<std::mutex> lock(context->mutex);
+    if (context->stopped) {
+      stop_code = context->stop_code;
+      return;
+    }
+    Defer(std::chrono::milliseconds(OUTPUT_STOP_TIMEOUT_MS));
+    context->stop_waiters.push_back(this);
+  }
+
+  void update() {
+    if (config.rtmp.present && strcmp(obs_output_get_id(context->output), RTMP_OUTPUT_ID) != 0) {
+      SetError("Error: rtmp options only apply to an rtmp_output");
+      return;
+    }
+
+    obs_data_t* settings;
+    if (!config.settings.empty() || config.rtmp.present) {
+      settings = dataFromJson(config.settings);
+      applyRtmpSettings(config.rtmp, settings);
+      obs_output_update(context->output, settings);
+      if (context->replay_meter)
+        obs_output_update(context->replay_meter, settings);
+      obs_data_release(settings);
+    }
+    applyRtmpReconnect(config.rtmp, context->output);
+    context->encoders->update(config.encoders);
+    if (!context->streaming_service)
+      return;
+    if (!config.service_settings.empty()) {
+      settings = dataFromJson(config.service_settings);
+      obs_service_update(context->streaming_service, settings);
+      obs_data_release(settings);
+    }
+    if (!config.rtmp.server.empty()) {
+      settings = rtmpServiceSettings(config.rtmp);
+      obs_service_update(context->streaming_service, settings);
+      obs_data_release(settings);
+    }
+  }
+
+  std::shared_ptr<ObsOutputContext> context;
+  Op op;
+  ObsOutputConfig config;
+  long long stop_code = OBS_OUTPUT_SUCCESS;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Asynchronously saves the contents of a running replay buffer to path.
+// The replay buffer muxes on its own thread; this resolves with the written
+// path once it signals "saved", and the command thread moves on meanwhile.
+//
+class AsyncSaveReplayWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(Napi::Env env, std::shared_ptr<ObsOutputContext> context,
+      const std::string& path) {
+    if (!context) {
+      Napi::TypeError::New(env, "Error: output has been released")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncSaveReplayWorker* worker = new AsyncSaveReplayWorker(env, context, path);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    obs_output_t* output = context->output;
+    if (!output || strcmp(obs_output_get_id(output), REPLAY_OUTPUT_ID) != 0) {
+      SetError("Error: output is not a replay buffer");
+      return;
+    }
+    if (!obs_output_active(output)) {
+      SetError("Error: replay buffer is not running");
+      return;
+    }
+
+    // The replay buffer names the file from its settings when it saves.
+    size_t slash = path.find_last_of("/\\");
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    std::string file = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = file.find_last_of('.');
+    std::string extension = dot == std::string::npos ? "mp4" : file.substr(dot + 1);
+    file = file.substr(0, dot);
+
+    // The format is expanded like strftime, so a literal '%' is doubled.
+    std::string format;
+    for (char c : file)
+      format += c == '%' ? std::string("%%") : std::string(1, c);
+
+    obs_data_t* settings = obs_output_get_settings(output);
+    obs_data_set_string(settings, "directory", directory.c_str());
+    obs_data_set_string(settings, "format", format.c_str());
+    obs_data_set_string(settings, "extension", extension.c_str());
+    obs_data_set_bool(settings, "allow_spaces", true);
+    obs_output_update(output, settings);
+    obs_data_release(settings);
+
+    Defer(std::chrono::milliseconds(REPLAY_SAVE_TIMEOUT_MS));
+    signal_handler_connect(obs_output_get_signal_handler(output), "saved", onSaved, this);
+
+    calldata_t cd = {};
+    proc_handler_call(obs_output_get_proc_handler(output), "save", &cd);
+    calldata_free(&cd);
+  }
+
+  virtual void OnOK() override {
+    deferredPromise.Resolve(Napi::String::New(Env(), path));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+  // Disconnecting waits for a "saved" signal in progress, so onSaved() is
+  // done with the worker when this returns.
+  void OnTimeout() override {
+    if (context->output)
+      signal_handler_disconnect(obs_output_get_signal_handler(context->output), "saved",
+          onSaved, this);
+    SetError("Error: timed out waiting for the replay to save");
+  }
+
+private:
+  AsyncSaveReplayWorker(napi_env env, std::shared_ptr<ObsOutputContext>& context,
+      const std::string& path) :
+    ObsCommandWorker(env),
+    context(context),
+    path(path),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  // Runs on the replay buffer's mux thread. The worker may be completed and
+  // deleted as soon as Finish() is called, so that comes last.
+  static void onSaved(void* data, calldata_t*) {
+    AsyncSaveReplayWorker* worker = (AsyncSaveReplayWorker*)data;
+    obs_output_t* output = worker->context->output;
+
+    calldata_t cd = {};
+    proc_handler_call(obs_output_get_proc_handler(output), "get_last_replay", &cd);
+    const char* last_replay = calldata_string(&cd, "path");
+    if (last_replay)
+      worker->path = last_replay;
+    calldata_free(&cd);
+
+    signal_handler_disconnect(obs_output_get_signal_handler(output), "saved", onSaved, worker);
+    worker->Finish();
+  }
+
+  std::shared_ptr<ObsOutputContext> context;
+  std::string path;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+Napi::Value ObsOutput::Start(const Napi::CallbackInfo& info) {
+  return AsyncOutputWorker::Create(info.Env(), context, AsyncOutputWorker::Op::START);
+}
+
+Napi::Value ObsOutput::Stop(const Napi::CallbackInfo& info) {
+  return AsyncOutputWorker::Create(info.Env(), context, AsyncOutputWorker::Op::STOP);
+}
+
+// Updates output, encoder and service settings:
+//   { settings, video: { settings }, audio: { settings }, service: { settings }, rtmp }
+// Encoder settings of shared encoders apply to every output bound to them.
+Napi::Value ObsOutput::Update(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  ObsOutputConfig config;
+  std::string service_id;
+  Napi::Object options = info.Length() == 1 && info[0].IsObject() ?
+      info[0].As<Napi::Object>() : Napi::Object();
+  if (options.IsEmpty() ||
+      !getSettingsJson(env, options, config.settings) ||
+      !parseEncoderConfig(env, options, config.encoders, false) ||
+      !parseComponent(env, options, "service", service_id, config.service_settings, false) ||
+      !parseRtmpOptions(options, config.rtmp)) {
+    Napi::TypeError::New(env, "Expected a settings object")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return AsyncOutputWorker::Create(env, context, AsyncOutputWorker::Op::UPDATE, config);
+}
+
+Napi::Value ObsOutput::SaveReplay(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (info.Length() != 1 || !info[0].IsString() || info[0].As<Napi::String>().Utf8Value().empty()) {
+    Napi::TypeError::New(env, "Expected a file path")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return AsyncSaveReplayWorker::Create(env, context, info[0].As<Napi::String>().Utf8Value());
+}
+
+// Live rendition changes
+// libobs only changes an encoder's scaled size or the canvas while nothing
+// encodes, so the outputs involved are cycled: stopped together, changed,
+// and started again on the same output, encoder and service objects. A
+// stream reconnects within about a second instead of being torn down and
+// rebuilt from JS. Packet taps and latency traces are not cycled, since
+// their consumers would need new codec headers: the change is refused while
+// one of them is attached to the encoders involved.
+
+// Names the packet tap or latency trace that has an active output on the
+// encoders (on any encoders when bound is nullptr). Runs on the command thread.
+static bool findInternalEncoderUser(const ObsEncoderContext* bound, std::string& user) {
+  struct Search {
+    const ObsEncoderContext* bound;
+    std::string* user;
+  } search = { bound, &user };
+
+  obs_enum_outputs([](void* data, obs_output_t* output) {
+    Search* search = (Search*)data;
+    const char* name = internalOutputUser(output);
+    if (!name || !obs_output_active(output))
+      return true;
+    obs_encoder_t* video = obs_output_get_video_encoder(output);
+    obs_encoder_t* audio = obs_output_get_audio_encoder(output, 0);
+    if (search->bound && !(video && video == search->bound->video_encoder) &&
+        !(audio && audio == search->bound->audio_encoder))
+      return true;
+    *search->user = name;
+    return false;
+  }, &search);
+  return !user.empty();
+}
+
+// Stops the active outputs bound to the encoders (all outputs when bound is
+// nullptr), runs change while they are down and starts them again, whether
+// change succeeded or not. Runs on the command thread.
+static bool cycleOutputs(const ObsEncoderContext* bound,
+    const std::function<bool(std::string&)>& change,
+    std::vector<std::string>& restarted, std::string& error) {
+  std::string user;
+  if (findInternalEncoderUser(bound, user)) {
+    error = "Error: " + user + " is still attached to the encoders; stop it first";
+    return false;
+  }
+
+  std::vector<ObsOutputContext*> cycled;
+  {
+    std::lock_guard<std::mutex> lock(output_registry_mutex);
+    for (ObsOutputContext* context : output_registry)
+      if (context->output && obs_output_active(context->output) &&
+          (!bound || context->encoders.get() == bound))
+        cycled.push_back(context);
+  }
+
+  for (ObsOutputContext* context : cycled)
+    context->requestStop();
+
+  auto deadline = std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(OUTPUT_STOP_TIMEOUT_MS);
+  for (ObsOutputContext* context : cycled) {
+    long long code;
+    if (!context->waitStopped(deadline, code))
+      obs_output_force_stop(context->output);
+  }
+
+  bool changed = change(error);
+
+  for (ObsOutputContext* context : cycled) {
+    std::string start_error;
+    if (context->start(start_error)) {
+      restarted.push_back(obs_output_get_name(context->output));
+      continue;
+    }
+    blog(LOG_WARNING, "obsapi: could not restart %s: %s",
+        obs_output_get_name(context->output), start_error.c_str());
+    if (changed) {
+      error = start_error;
+      changed = false;
+    }
+  }
+  return changed;
+}
+
+// Asynchronously changes the scaled size and frame rate divisor of an
+// encoder pair, cycling the outputs bound to it when they are running.
+//
+class AsyncScaleEncodersWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(Napi::Env env, std::shared_ptr<ObsEncoderContext> context,
+      uint32_t width, uint32_t height, uint32_t fps_divisor) {
+    if (!context) {
+      Napi::TypeError::New(env, "Error: encoders have been released")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncScaleEncodersWorker* worker =
+        new AsyncScaleEncodersWorker(env, context, width, height, fps_divisor);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    auto scale = [this](std::string& scale_error) {
+      return context->setScale(width, height, fps_divisor, scale_error);
+    };
+
+    bool active = context->video_encoder && obs_encoder_active(context->video_encoder);
+    if (!(active ? cycleOutputs(context.get(), scale, restarted, error) : scale(error))) {
+      SetError(error);
+      return;
+    }
+
+    width = obs_encoder_get_width(context->video_encoder);
+    height = obs_encoder_get_height(context->video_encoder);
+#if LIBOBS_API_MAJOR_VER >= 30
+    fps_divisor = obs_encoder_get_frame_rate_divisor(context->video_encoder);
+#else
+    fps_divisor = 1;
+#endif
+  }
+
+  virtual void OnOK() override {
+    Napi::Env env = Env();
+    Napi::Array names = Napi::Array::New(env, restarted.size());
+    for (size_t i = 0; i < restarted.size(); i++)
+      names.Set(i, Napi::String::New(env, restarted[i]));
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("width", Napi::Number::New(env, width));
+    result.Set("height", Napi::Number::New(env, height));
+    result.Set("fpsDivisor", Napi::Number::New(env, fps_divisor));
+    result.Set("restarted", names);
+    deferredPromise.Resolve(result);
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncScaleEncodersWorker(napi_env env, std::shared_ptr<ObsEncoderContext>& context,
+      uint32_t width, uint32_t height, uint32_t fps_divisor) :
+    ObsCommandWorker(env),
+    context(context),
+    width(width),
+    height(height),
+    fps_divisor(fps_divisor),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  std::shared_ptr<ObsEncoderContext> context;
+  uint32_t width;
+  uint32_t height;
+  uint32_t fps_divisor;
+  std::vector<std::string> restarted;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Rescales the video encoder: { width, height, fpsDivisor }. An empty object
+// goes back to the canvas output size and frame rate.
+Napi::Value ObsEncoders::SetScale(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint32_t fps_divisor = 0;
+  if (info.Length() != 1 || !info[0].IsObject() ||
+      !parseVideoScale(info[0].As<Napi::Object>(), width, height, fps_divisor)) {
+    Napi::TypeError::New(env, "Expected a scale object with width and height")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return AsyncScaleEncodersWorker::Create(env, context, width, height, fps_divisor);
+}
+
+// Profiles
+// A profile is an obs_data JSON file holding the video and audio config
+// (the same keys as resetVideo() and resetAudio()), the shared encoder pairs
+// and the outputs with their encoders and services:
+//   { video, audio, encoders: [{ name, video, audio }],
+//     outputs: [{ type, name, settings, encoders: name | video, audio, service }] }
+// Settings are read live from libobs, so updates since creation are kept.
+// Canvases and the scene graph are not part of it, so encoders on a canvas
+// and their outputs are left out.
+//
+// JS: saveProfile(path) -> Promise<path>
+//     loadProfile(path) -> Promise<{ video, audio, encoders: { name: Encoders },
+//                                    outputs: { name: Output } }>
+//     initialize({ profile: path }) applies it natively during startup
+#define PROFILE_BACKUP_EXT ("bak")
+
+struct ObsProfile {
+  obs_data_t* data = nullptr;
+
+  bool has_video = false;
+  struct obs_video_info ovi;
+  bool has_audio = false;
+  ObsAudioConfig audio;
+  std::vector<std::shared_ptr<ObsEncoderContext>> encoders;
+  std::vector<std::shared_ptr<ObsOutputContext>> outputs;
+
+  ~ObsProfile() {
+    obs_data_release(data);
+  }
+};
+
+template <typename T, size_t N>
+static bool dataEnum(obs_data_t* data, const char* key, const ObsEnumName<T> (&names)[N], T& out) {
+  if (!obs_data_has_user_value(data, key))
+    return true;
+
+  const char* name = obs_data_get_string(data, key);
+  for (const ObsEnumName<T>& entry : names) {
+    if (strcmp(name, entry.name) == 0) {
+      out = entry.value;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void dataUint(obs_data_t* data, const char* key, uint32_t& out) {
+  if (obs_data_has_user_value(data, key))
+    out = (uint32_t)obs_data_get_int(data, key);
+}
+
+// JSON of a nested object, empty when absent.
+static std::string dataObjJson(obs_data_t* data, const char* key) {
+  obs_data_t* obj = obs_data_get_obj(data, key);
+  std::string json = obj ? obs_data_get_json(obj) : "";
+  obs_data_release(obj);
+  return json;
+}
+
+// Sets a nested object and drops the caller's reference to it.
+static void setDataObj(obs_data_t* data, const char* key, obs_data_t* obj) {
+  obs_data_set_obj(data, key, obj);
+  obs_data_release(obj);
+}
+
+static obs_data_t* videoInfoToData(const struct obs_video_info& ovi) {
+  obs_data_t* video = obs_data_create();
+  obs_data_set_int(video, "baseWidth", ovi.base_width);
+  obs_data_set_int(video, "baseHeight", ovi.base_height);
+  obs_data_set_int(video, "outputWidth", ovi.output_width);
+  obs_data_set_int(video, "outputHeight", ovi.output_height);
+  obs_data_set_int(video, "fpsNum", ovi.fps_num);
+  obs_data_set_int(video, "fpsDen", ovi.fps_den);
+  obs_data_set_string(video, "format", enumName(VIDEO_FORMAT_NAMES, ovi.output_format));
+  obs_data_set_string(video, "scaleType", enumName(SCALE_TYPE_NAMES, ovi.scale_type));
+  obs_data_set_string(video, "colorspace", enumName(COLORSPACE_NAMES, ovi.colorspace));
+  obs_data_set_string(video, "range", enumName(RANGE_NAMES, ovi.range));
+  obs_data_set_bool(video, "gpuConversion", ovi.gpu_conversion);
+  return video;
+}
+
+static bool videoInfoFromData(obs_data_t* video, struct obs_video_info& ovi) {
+  ovi = create_ovi();
+  uint32_t base_width = ovi.base_width;
+  uint32_t base_height = ovi.base_height;
+  uint32_t fps_num = ovi.fps_num;
+  uint32_t fps_den = ovi.fps_den;
+  dataUint(video, "baseWidth", base_width);
+  dataUint(video, "baseHeight", base_height);
+  dataUint(video, "fpsNum", fps_num);
+  dataUint(video, "fpsDen", fps_den);
+  uint32_t output_width = base_width;
+  uint32_t output_height = base_height;
+  dataUint(video, "outputWidth", output_width);
+  dataUint(video, "outputHeight", output_height);
+
+  ovi.base_width = base_width;
+  ovi.base_height = base_height;
+  ovi.output_width = output_width;
+  ovi.output_height = output_height;
+  ovi.fps_num = fps_num;
+  ovi.fps_den = fps_den;
+  if (obs_data_has_user_value(video, "gpuConversion"))
+    ovi.gpu_conversion = obs_data_get_bool(video, "gpuConversion");
+  return base_width && base_height && output_width && output_height && fps_num && fps_den &&
+      dataEnum(video, "format", VIDEO_FORMAT_NAMES, ovi.output_format) &&
+      dataEnum(video, "scaleType", SCALE_TYPE_NAMES, ovi.scale_type) &&
+      dataEnum(video, "colorspace", COLORSPACE_NAMES, ovi.colorspace) &&
+      dataEnum(video, "range", RANGE_NAMES, ovi.range);
+}
+
+static obs_data_t* audioConfigToData(const ObsAudioConfig& config) {
+  obs_data_t* audio = obs_data_create();
+  obs_data_set_int(audio, "sampleRate", config.sample_rate);
+  obs_data_set_string(audio, "speakers", enumName(SPEAKER_LAYOUT_NAMES, config.speakers));
+  obs_data_set_bool(audio, "fixedBuffering", config.fixed_buffering);
+  obs_data_set_int(audio, "maxBufferingMs", config.max_buffering_ms);
+  return audio;
+}
+
+static bool audioConfigFromData(obs_data_t* audio, ObsAudioConfig& config) {
+  dataUint(audio, "sampleRate", config.sample_rate);
+  dataUint(audio, "maxBufferingMs", config.max_buffering_ms);
+  if (obs_data_has_user_value(audio, "fixedBuffering"))
+    config.fixed_buffering = obs_data_get_bool(audio, "fixedBuffering");
+  return config.sample_rate && dataEnum(audio, "speakers", SPEAKER_LAYOUT_NAMES, config.speakers);
+}
+
+static obs_data_t* encoderToData(obs_encoder_t* encoder) {
+  obs_data_t* component = obs_data_create();
+  obs_data_set_string(component, "id", obs_encoder_get_id(encoder));
+  setDataObj(component, "settings", obs_encoder_get_settings(encoder));
+  return component;
+}
+
+// Writes the video and audio components of an encoder pair into data.
+static void encoderPairToData(const ObsEncoderContext& pair, obs_data_t* data) {
+  if (pair.video_encoder) {
+    obs_data_t* video = encoderToData(pair.video_encoder);
+    if (pair.scale_width || pair.fps_divisor) {
+      obs_data_t* scale = obs_data_create();
+      if (pair.scale_width) {
+        obs_data_set_int(scale, "width", pair.scale_width);
+        obs_data_set_int(scale, "height", pair.scale_height);
+      }
+      if (pair.fps_divisor)
+        obs_data_set_int(scale, "fpsDivisor", pair.fps_divisor);
+      setDataObj(video, "scale", scale);
+    }
+    setDataObj(data, "video", video);
+  }
+  if (pair.audio_encoder) {
+    obs_data_t* audio = encoderToData(pair.audio_encoder);
+    obs_data_set_int(audio, "mixer", pair.audio_mixer);
+    setDataObj(data, "audio", audio);
+  }
+}
+
+static void encoderConfigFromData(obs_data_t* data, ObsEncoderConfig& config) {
+  obs_data_t* video = obs_data_get_obj(data, "video");
+  if (video) {
+    config.video_id = obs_data_get_string(video, "id");
+    config.video_settings = dataObjJson(video, "settings");
+    obs_data_t* scale = obs_data_get_obj(video, "scale");
+    if (scale) {
+      dataUint(scale, "width", config.scale_width);
+      dataUint(scale, "height", config.scale_height);
+      dataUint(scale, "fpsDivisor", config.fps_divisor);
+      obs_data_release(scale);
+    }
+    obs_data_release(video);
+  }
+
+  obs_data_t* audio = obs_data_get_obj(data, "audio");
+  if (audio) {
+    config.audio_id = obs_data_get_string(audio, "id");
+    config.audio_settings = dataObjJson(audio, "settings");
+    dataUint(audio, "mixer", config.audio_mixer);
+    obs_data_release(audio);
+  }
+}
+
+// Calls fn for every object of an array member until it returns false.
+static bool forEachDataItem(obs_data_t* data, const char* key,
+    const std::function<bool(obs_data_t*)>& fn) {
+  obs_data_array_t* array = obs_data_get_array(data, key);
+  bool ok = true;
+  for (size_t i = 0; ok && i < obs_data_array_count(array); i++) {
+    obs_data_t* item = obs_data_array_item(array, i);
+    ok = fn(item);
+    obs_data_release(item);
+  }
+  obs_data_array_release(array);
+  return ok;
+}
+
+// Captures the current state as a profile. Runs on the command thread.
+static obs_data_t* captureProfile(std::string& error) {
+  obs_data_t* data = obs_data_create();
+
+  struct obs_video_info ovi;
+  if (obs_get_video_info(&ovi))
+    setDataObj(data, "video", videoInfoToData(ovi));
+
+  struct obs_audio_info oai;
+  if (obs_get_audio_info(&oai)) {
+    ObsAudioConfig config = audio_config;
+    config.sample_rate = oai.samples_per_sec;
+    config.speakers = oai.speakers;
+    setDataObj(data, "audio", audioConfigToData(config));
+  }
+
+  std::set<std::string> names;
+  obs_data_array_t* encoders = obs_data_array_create();
+  {
+    std::lock_guard<std::mutex> lock(encoder_registry_mutex);
+    for (ObsEncoderContext* pair : encoder_registry) {
+      if (!pair->shared || pair->canvas)
+        continue;
+      if (!names.insert(pair->name).second) {
+        error = "Error: more than one encoder pair is named " + pair->name;
+        break;
+      }
+      obs_data_t* item = obs_data_create();
+      obs_data_set_string(item, "name", pair->name.c_str());
+      encoderPairToData(*pair, item);
+      obs_data_array_push_back(encoders, item);
+      obs_data_release(item);
+    }
+  }
+  obs_data_set_array(data, "encoders", encoders);
+  obs_data_array_release(encoders);
+
+  obs_data_array_t* outputs = obs_data_array_create();
+  {
+    std::lock_guard<std::mutex> lock(output_registry_mutex);
+    for (ObsOutputContext* context : output_registry) {
+      if (!context->output || !context->encoders || context->encoders->canvas)
+        continue;
+
+      obs_data_t* item = obs_data_create();
+      obs_data_set_string(item, "type", obs_output_get_id(context->output));
+      obs_data_set_string(item, "name", obs_output_get_name(context->output));
+      setDataObj(item, "settings", obs_output_get_settings(context->output));
+      if (context->encoders->shared)
+        obs_data_set_string(item, "encoders", context->encoders->name.c_str());
+      else
+        encoderPairToData(*context->encoders, item);
+
+      if (context->streaming_service) {
+        obs_data_t* service = obs_data_create();
+        obs_data_set_string(service, "id", obs_service_get_id(context->streaming_service));
+        setDataObj(service, "settings", obs_service_get_settings(context->streaming_service));
+        setDataObj(item, "service", service);
+      }
+      obs_data_array_push_back(outputs, item);
+      obs_data_release(item);
+    }
+  }
+  obs_data_set_array(data, "outputs", outputs);
+  obs_data_array_release(outputs);
+
+  if (!error.empty()) {
+    obs_data_release(data);
+    return nullptr;
+  }
+  return data;
+}
+
+static bool readProfile(const std::string& path, std::shared_ptr<ObsProfile>& profile,
+    std::string& error) {
+  obs_data_t* data = obs_data_create_from_json_file_safe(path.c_str(), PROFILE_BACKUP_EXT);
+  if (!data) {
+    error = "Error: could not read profile " + path;
+    return false;
+  }
+  profile = std::make_shared<ObsProfile>();
+  profile->data = data;
+  return true;
+}
+
+// The encoder, output and service ids a profile needs, for module loading.
+static std::vector<std::string> profileIds(const ObsProfile& profile) {
+  std::set<std::string> ids;
+  auto addComponent = [&ids](obs_data_t* data, const char* key) {
+    obs_data_t* component = obs_data_get_obj(data, key);
+    if (!component)
+      return;
+    std::string id = obs_data_get_string(component, "id");
+    if (!id.empty() && id != AUTO_ENCODER_ID)
+      ids.insert(id);
+    obs_data_release(component);
+  };
+  auto addItem = [&](obs_data_t* item) {
+    addComponent(item, "video");
+    addComponent(item, "audio");
+    addComponent(item, "service");
+    std::string type = obs_data_get_string(item, "type");
+    if (!type.empty())
+      ids.insert(type);
+    return true;
+  };
+
+  forEachDataItem(profile.data, "encoders", addItem);
+  forEachDataItem(profile.data, "outputs", addItem);
+  return std::vector<std::string>(ids.begin(), ids.end());
+}
+
+// Resets video and audio and creates the encoders and outputs of a profile.
+// Runs on the command thread; nothing created is kept on failure.
+static bool applyProfile(ObsProfile& profile, std::string& error) {
+  obs_data_t* video = obs_data_get_obj(profile.data, "video");
+  if (video) {
+    bool valid = videoInfoFromData(video, profile.ovi);
+    obs_data_release(video);
+    if (!valid) {
+      error = "Error: invalid video settings in profile";
+      return false;
+    }
+    if (!selectGraphics(profile.ovi, ADAPTER_UNSET, "", error))
+      return false;
+    int code = obs_reset_video(&profile.ovi);
+    if (code != OBS_VIDEO_SUCCESS) {
+      error = resetVideoError(code);
+      return false;
+    }
+    obs_get_video_info(&profile.ovi);
+    profile.has_video = true;
+  }
+
+  obs_data_t* audio = obs_data_get_obj(profile.data, "audio");
+  if (audio) {
+    bool valid = audioConfigFromData(audio, profile.audio);
+    obs_data_release(audio);
+    if (!valid) {
+      error = "Error: invalid audio settings in profile";
+      return false;
+    }
+    if (!resetAudio(profile.audio, error))
+      return false;
+    profile.has_audio = true;
+  }
+
+  std::map<std::string, std::shared_ptr<ObsEncoderContext>> shared;
+  bool ok = forEachDataItem(profile.data, "encoders", [&](obs_data_t* item) {
+    ObsEncoderConfig config;
+    config.name = obs_data_get_string(item, "name");
+    encoderConfigFromData(item, config);
+    if (config.name.empty() || shared.count(config.name)) {
+      error = "Error: profile encoders need unique names";
+      return false;
+    }
+
+    std::shared_ptr<ObsEncoderContext> pair;
+    if (!createEncoders(config, pair, error))
+      return false;
+    pair->shared = true;
+    shared[config.name] = pair;
+    profile.encoders.push_back(pair);
+    return true;
+  });
+
+  ok = ok && forEachDataItem(profile.data, "outputs", [&](obs_data_t* item) {
+    ObsOutputConfig config;
+    config.type = obs_data_get_string(item, "type");
+    config.name = obs_data_get_string(item, "name");
+    config.settings = dataObjJson(item, "settings");
+    if (config.type.empty() || config.name.empty()) {
+      error = "Error: profile outputs need a type and a name";
+      return false;
+    }
+
+    std::string encoders = obs_data_get_string(item, "encoders");
+    if (!encoders.empty()) {
+      auto it = shared.find(encoders);
+      if (it == shared.end()) {
+        error = "Error: no encoders named " + encoders + " in profile";
+        return false;
+      }
+      config.shared_encoders = it->second;
+    } else {
+      encoderConfigFromData(item, config.encoders);
+      config.encoders.name = config.name;
+    }
+
+    obs_data_t* service = obs_data_get_obj(item, "service");
+    if (service) {
+      config.service_id = obs_data_get_string(service, "id");
+      config.service_settings = dataObjJson(service, "settings");
+      obs_data_release(service);
+    }
+
+    std::shared_ptr<ObsOutputContext> context;
+    if (!createOutput(config, context, error))
+      return false;
+    profile.outputs.push_back(context);
+    return true;
+  });
+
+  if (!ok) {
+    profile.outputs.clear();
+    profile.encoders.clear();
+  }
+  return ok;
+}
+
+static Napi::Object profileToJs(Napi::Env env, ObsProfile& profile) {
+  Napi::Object encoders = Napi::Object::New(env);
+  for (std::shared_ptr<ObsEncoderContext>& pair : profile.encoders)
+    encoders.Set(pair->name, ObsEncoders::NewInstance(env, pair));
+
+  Napi::Object outputs = Napi::Object::New(env);
+  for (std::shared_ptr<ObsOutputContext>& context : profile.outputs)
+    outputs.Set(obs_output_get_name(context->output), ObsOutput::NewInstance(env, context));
+
+  Napi::Object result = Napi::Object::New(env);
+  if (profile.has_video)
+    result.Set("video", videoInfoToJs(env, profile.ovi));
+  if (profile.has_audio)
+    result.Set("audio", audioConfigToJs(env, profile.audio));
+  result.Set("encoders", encoders);
+  result.Set("outputs", outputs);
+  return result;
+}
+
+// Asynchronously saves the current state to a profile, or loads one.
+// Saving writes through a temporary file and keeps the previous profile as
+// a backup, which loading falls back to when the profile is unreadable.
+//
+class AsyncProfileWorker : public ObsCommandWorker {
+public:
+  enum class Op { SAVE, LOAD };
+
+  static Napi::Value Save(const Napi::CallbackInfo& info) {
+    return Create(info, Op::SAVE);
+  }
+
+  static Napi::Value Load(const Napi::CallbackInfo& info) {
+    return Create(info, Op::LOAD);
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error)) {
+      SetError(error);
+      return;
+    }
+
+    if (op == Op::LOAD) {
+      if (!readProfile(path, profile, error) || !applyProfile(*profile, error)) {
+        profile.reset();
+        SetError(error);
+      }
+      return;
+    }
+
+    obs_data_t* data = captureProfile(error);
+    if (!data) {
+      SetError(error);
+      return;
+    }
+    if (!obs_data_save_json_safe(data, path.c_str(), "tmp", PROFILE_BACKUP_EXT))
+      SetError("Error: could not write profile to " + path);
+    obs_data_release(data);
+  }
+
+  virtual void OnOK() override {
+    Napi::Env env = Env();
+    if (op == Op::LOAD)
+      deferredPromise.Resolve(profileToJs(env, *profile));
+    else
+      deferredPromise.Resolve(Napi::String::New(env, path));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncProfileWorker(napi_env env, Op op, const std::string& path) :
+    ObsCommandWorker(env),
+    op(op),
+    path(path),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  static Napi::Value Create(const Napi::CallbackInfo& info, Op op) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    if (info.Length() != 1 || !info[0].IsString() || info[0].As<Napi::String>().Utf8Value().empty()) {
+      Napi::TypeError::New(env, "Expected a profile path")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncProfileWorker* worker =
+        new AsyncProfileWorker(env, op, info[0].As<Napi::String>().Utf8Value());
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+  Op op;
+  std::string path;
+  std::shared_ptr<ObsProfile> profile;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Output statistics stream
+// Each subscription owns a native timer thread that samples global and
+// per-output counters and hands one batched sample per interval to JS
+// through a ThreadSafeFunction, so sampling never runs on the event loop.
+//
+// JS: subscribeStats(intervalMs, cb) -> unsubscribe()
+//     getStats() -> the same sample, read synchronously
+//     cb({ timestamp, renderFps, laggedFrames, totalFrames, skippedFrames, averageFrameTimeMs,
+//          outputs: [{ name, active, totalBytes, kbps, framesDropped,
+//                      totalFrames, fps, congestion, replay?: { bytes, seconds } }] })
+#define MIN_STATS_INTERVAL_MS 50
+
+struct ObsOutputStats {
+  std::string name;
+  bool active;
+  uint64_t total_bytes;
+  double kbps;
+  int frames_dropped;
+  int total_frames;
+  double fps;
+  float congestion;
+  int64_t replay_bytes = -1;
+  double replay_seconds = 0;
+};
+
+struct ObsStatsSample {
+  double timestamp_ms;
+  double render_fps;
+  uint32_t lagged_frames;
+  uint32_t total_frames;
+  uint32_t skipped_frames;
+  double average_frame_time_ms;
+  std::vector<ObsOutputStats> outputs;
+};
+
+// Samples the counters and derives rates from the previous sample.
+class ObsStatsSampler {
+public:
+  void collect(ObsStatsSample& sample) {
+    uint64_t now_ns = os_gettime_ns();
+    double seconds = last_ns ? (double)(now_ns - last_ns) / 1e9 : 0;
+    last_ns = now_ns;
+
+    sample.timestamp_ms = (double)now_ns / 1e6;
+    sample.render_fps = obs_get_active_fps();
+    sample.lagged_frames = obs_get_lagged_frames();
+    sample.total_frames = obs_get_total_frames();
+    video_t* video = obs_get_video();
+    sample.skipped_frames = video ? video_output_get_skipped_frames(video) : 0;
+    sample.average_frame_time_ms = (double)obs_get_average_frame_time_ns() / 1e6;
+
+    std::lock_guard<std::mutex> registry_lock(output_registry_mutex);
+    for (ObsOutputContext* context : output_registry) {
+      obs_output_t* output = context->output;
+      ObsOutputStats stats;
+      stats.name = obs_output_get_name(output);
+      stats.active = obs_output_active(output);
+      stats.total_bytes = obs_output_get_total_bytes(output);
+      stats.frames_dropped = obs_output_get_frames_dropped(output);
+      stats.total_frames = obs_output_get_total_frames(output);
+      stats.congestion = obs_output_get_congestion(output);
+      if (context->meter) {
+        stats.replay_bytes = (int64_t)context->meter->bytes.load();
+        stats.replay_seconds = (double)context->meter->duration_usec.load() / 1e6;
+      }
+
+      Previous& prev = previous[context];
+      bool has_prev = prev.seen && prev.total_bytes <= stats.total_bytes &&
+          prev.total_frames <= stats.total_frames;
+      stats.kbps = has_prev && seconds > 0 ?
+          (double)(stats.total_bytes - prev.total_bytes) * 8 / 1000 / seconds : 0;
+      stats.fps = has_prev && seconds > 0 ?
+          (double)(stats.total_frames - prev.total_frames) / seconds : 0;
+      prev.seen = true;
+      prev.total_bytes = stats.total_bytes;
+      prev.total_frames = stats.total_frames;
+
+      sample.outputs.push_back(stats);
+    }
+
+    for (auto it = previous.begin(); it != previous.end();)
+      it = output_registry.count(it->first) ? std::next(it) : previous.erase(it);
+  }
+
+private:
+  struct Previous {
+    bool seen = false;
+    uint64_t total_bytes = 0;
+    int total_frames = 0;
+  };
+
+  uint64_t last_ns = 0;
+  std::map<ObsOutputContext*, Previous> previous;
+};
+
+static Napi::Object statsToJs(Napi::Env env, const ObsStatsSample& sample) {
+  Napi::Array outputs = Napi::Array::New(env, sample.outputs.size());
+  for (size_t i = 0; i < sample.outputs.size(); i++) {
+    const ObsOutputStats& stats = sample.outputs[i];
+    Napi::Object item = Napi::Object::New(env);
+    item.Set("name", Napi::String::New(env, stats.name));
+    item.Set("active", Napi::Boolean::New(env, stats.active));
+    item.Set("totalBytes", Napi::Number::New(env, (double)stats.total_bytes));
+    item.Set("kbps", Napi::Number::New(env, stats.kbps));
+    item.Set("framesDropped", Napi::Number::New(env, stats.frames_dropped));
+    item.Set("totalFrames", Napi::Number::New(env, stats.total_frames));
+    item.Set("fps", Napi::Number::New(env, stats.fps));
+    item.Set("congestion", Napi::Number::New(env, stats.congestion));
+    if (stats.replay_bytes >= 0) {
+      Napi::Object replay = Napi::Object::New(env);
+      replay.Set("bytes", Napi::Number::New(env, (double)stats.replay_bytes));
+      replay.Set("seconds", Napi::Number::New(env, stats.replay_seconds));
+      item.Set("replay", replay);
+    }
+    outputs.Set(i, item);
+  }
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("timestamp", Napi::Number::New(env, sample.timestamp_ms));
+  result.Set("renderFps", Napi::Number::New(env, sample.render_fps));
+  result.Set("laggedFrames", Napi::Number::New(env, sample.lagged_frames));
+  result.Set("totalFrames", Napi::Number::New(env, sample.total_frames));
+  result.Set("skippedFrames", Napi::Number::New(env, sample.skipped_frames));
+  result.Set("averageFrameTimeMs", Napi::Number::New(env, sample.average_frame_time_ms));
+  result.Set("outputs", outputs);
+  return result;
+}
+
+class ObsStatsSubscription {
+public:
+  ObsStatsSubscription(Napi::Env env, Napi::Function callback, uint32_t interval_ms) :
+    interval_ms(interval_ms) {
+    tsfn = Napi::ThreadSafeFunction::New(env, callback, "obsapi_stats", 2, 1);
+    thread = std::thread(&ObsStatsSubscription::run, this);
+  }
+
+  ~ObsStatsSubscription() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    cv.notify_all();
+    thread.join();
+    tsfn.Release();
+  }
+
+private:
+  void run() {
+    ObsStatsSample first;
+    sampler.collect(first);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+      cv.wait_for(lock, std::chrono::milliseconds(interval_ms), [this] { return !running; });
+      if (!running)
+        break;
+
+      ObsStatsSample* sample = new ObsStatsSample();
+      sampler.collect(*sample);
+
+      if (tsfn.NonBlockingCall(sample, deliver) != napi_ok)
+        delete sample;
+    }
+  }
+
+  static void deliver(Napi::Env env, Napi::Function callback, ObsStatsSample* sample) {
+    Napi::Object result = statsToJs(env, *sample);
+    delete sample;
+
+    callback.Call({ result });
+  }
+
+  uint32_t interval_ms;
+  bool running = true;
+  std::mutex mutex;
+  std::condition_variable cv;
+  ObsStatsSampler sampler;
+  Napi::ThreadSafeFunction tsfn;
+  std::thread thread;
+};
+
+static std::map<uint32_t, std::unique_ptr<ObsStatsSubscription>> stats_subscriptions;
+static uint32_t next_stats_subscription = 1;
+
+// Stops every stats subscription. Called from the JS thread before shutdown.
+static void stopStatsSubscriptions() {
+  stats_subscriptions.clear();
+}
+
+// Reads one sample directly on the JS thread. Every value read is a counter
+// libobs keeps atomically, so this fast path never waits on the command thread.
+// Rates are relative to the previous getStats() call.
+Napi::Value obsGetStats(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  static ObsStatsSampler sampler;
+
+  if (!initReady()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  ObsStatsSample sample;
+  sampler.collect(sample);
+  return statsToJs(env, sample);
+}
+
+Napi::Value obsSubscribeStats(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!initReady()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsFunction()) {
+    Napi::TypeError::New(env, "Expected an interval in milliseconds and a callback")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  uint32_t interval_ms = std::max((uint32_t)MIN_STATS_INTERVAL_MS,
+      info[0].As<Napi::Number>().Uint32Value());
+  uint32_t id = next_stats_subscription++;
+  stats_subscriptions[id].reset(
+      new ObsStatsSubscription(env, info[1].As<Napi::Function>(), interval_ms));
+
+  return Napi::Function::New(env, [id](const Napi::CallbackInfo& info) {
+    stats_subscriptions.erase(id);
+    return info.Env().Undefined();
+  }, "unsubscribe");
+}
+
+// Adaptive bitrate
+// A controller owns a native thread that watches the congestion and dropped
+// frames of one output. It steps the video bitrate down by stepDown (a
+// fraction) when congestion reaches highCongestion or more than dropRatio of
+// the frames were dropped, and back up by stepUp kbps once congestion has
+// stayed below lowCongestion with no drops for recoverMs. Each change goes
+// through a ThreadSafeFunction: the JS thread queues the obs_encoder_update
+// on the command thread and then calls cb with the change.
+//
+// A bitrate set later through output.update() or encoders.update() restarts
+// the controller from it; floor and ceiling, when left out, follow it.
+//
+// JS: output.enableAbr({ floor, ceiling, intervalMs, highCongestion,
+//                        lowCongestion, dropRatio, stepDown, stepUp, recoverMs }, cb)
+//     -> Promise<disable()>
+//     cb({ name, bitrate, previous, reason, congestion, droppedFrames })
+//     where reason is "congestion", "dropped" or "recovered"
+#define DEFAULT_ABR_INTERVAL_MS 1000
+#define DEFAULT_ABR_HIGH_CONGESTION 0.5
+#define DEFAULT_ABR_LOW_CONGESTION 0.1
+#define DEFAULT_ABR_DROP_RATIO 0.01
+#define DEFAULT_ABR_STEP_DOWN 0.25
+#define DEFAULT_ABR_STEP_UP_KBPS 250
+#define DEFAULT_ABR_RECOVER_MS 10000
+
+struct ObsAbrOptions {
+  uint32_t floor = 0;
+  uint32_t ceiling = 0;
+  uint32_t interval_ms = DEFAULT_ABR_INTERVAL_MS;
+  double high_congestion = DEFAULT_ABR_HIGH_CONGESTION;
+  double low_congestion = DEFAULT_ABR_LOW_CONGESTION;
+  double drop_ratio = DEFAULT_ABR_DROP_RATIO;
+  double step_down = DEFAULT_ABR_STEP_DOWN;
+  uint32_t step_up = DEFAULT_ABR_STEP_UP_KBPS;
+  uint32_t recover_ms = DEFAULT_ABR_RECOVER_MS;
+};
+
+struct ObsAbrEvent {
+  std::shared_ptr<ObsEncoderContext> encoders;
+  std::string name;
+  uint32_t bitrate;
+  uint32_t previous;
+  const char* reason;
+  float congestion;
+  int dropped_frames;
+};
+
+static bool parseAbrOptions(const Napi::Object& options, ObsAbrOptions& abr) {
+  if (!getUint(options, "floor", abr.floor) ||
+      !getUint(options, "ceiling", abr.ceiling) ||
+      !getUint(options, "intervalMs", abr.interval_ms) ||
+      !getNumber(options, "highCongestion", 0, 1, abr.high_congestion) ||
+      !getNumber(options, "lowCongestion", 0, 1, abr.low_congestion) ||
+      !getNumber(options, "dropRatio", 0, 1, abr.drop_ratio) ||
+      !getNumber(options, "stepDown", 0.01, 0.9, abr.step_down) ||
+      !getUint(options, "stepUp", abr.step_up) ||
+      !getUint(options, "recoverMs", abr.recover_ms))
+    return false;
+
+  abr.interval_ms = std::max((uint32_t)MIN_STATS_INTERVAL_MS, abr.interval_ms);
+  return abr.low_congestion < abr.high_congestion;
+}
+
+// Limits for a configured bitrate: the ceiling defaults to it and the floor
+// to a quarter of the ceiling.
+static bool abrLimits(const ObsAbrOptions& options, uint32_t configured,
+    uint32_t& floor, uint32_t& ceiling) {
+  ceiling = options.ceiling ? options.ceiling : configured;
+  floor = options.floor ? options.floor : ceiling / 4;
+  return configured && floor <= ceiling;
+}
+
+class ObsAbrController {
+public:
+  ObsAbrController(Napi::Env env, Napi::Function callback,
+      std::shared_ptr<ObsOutputContext>& context, std::shared_ptr<ObsEncoderContext>& encoders,
+      const ObsAbrOptions& options, uint32_t configured) :
+    env(env),
+    context(context),
+    encoders(encoders),
+    options(options) {
+    follow(configured);
+    tsfn = Napi::ThreadSafeFunction::New(env, callback, "obsapi_abr", 0, 1);
+    thread = std::thread(&ObsAbrController::run, this);
+  }
+
+  // Runs on the JS thread; the output and encoders are released on the
+  // command thread.
+  ~ObsAbrController() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    cv.notify_all();
+    thread.join();
+    tsfn.Release();
+
+    std::shared_ptr<ObsOutputContext> released;
+    std::shared_ptr<ObsEncoderContext> released_encoders;
+    released.swap(context);
+    released_encoders.swap(encoders);
+    ObsTaskWorker::Post(env, [released, released_encoders]() mutable {
+      released.reset();
+      released_encoders.reset();
+    });
+  }
+
+private:
+  // Restarts from a newly configured bitrate and derives the limits again.
+  void follow(uint32_t bitrate_now) {
+    configured = bitrate_now;
+    abrLimits(options, configured, floor, ceiling);
+    floor = std::min(floor, ceiling);
+    bitrate = std::min(std::max(configured, floor), ceiling);
+  }
+
+  void run() {
+    obs_output_t* output = context->output;
+    int last_dropped = 0;
+    int last_total = 0;
+    uint64_t clean_since_ms = os_gettime_ns() / 1000000;
+    bool was_active = false;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (running) {
+      cv.wait_for(lock, std::chrono::milliseconds(options.interval_ms), [this] { return !running; });
+      if (!running)
+        break;
+
+      uint64_t now_ms = os_gettime_ns() / 1000000;
+      uint32_t configured_now = encoders->video_bitrate;
+      if (configured_now && configured_now != configured) {
+        follow(configured_now);
+        clean_since_ms = now_ms;
+      }
+
+      if (!obs_output_active(output)) {
+        was_active = false;
+        continue;
+      }
+
+      float congestion = obs_output_get_congestion(output);
+      int dropped = obs_output_get_frames_dropped(output);
+      int total = obs_output_get_total_frames(output);
+      if (!was_active || dropped < last_dropped || total < last_total) {
+        // Counters restart with the output.
+        was_active = true;
+        last_dropped = dropped;
+        last_total = total;
+        clean_since_ms = now_ms;
+        continue;
+      }
+
+      int dropped_delta = dropped - last_dropped;
+      int total_delta = total - last_total;
+      last_dropped = dropped;
+      last_total = total;
+
+      bool dropping = dropped_delta > 0 &&
+          (double)dropped_delta / std::max(1, total_delta + dropped_delta) > options.drop_ratio;
+      uint32_t previous = bitrate;
+      const char* reason = nullptr;
+
+      if (congestion >= options.high_congestion || dropping) {
+        clean_since_ms = now_ms;
+        bitrate = std::max(floor, (uint32_t)(bitrate * (1.0 - options.step_down)));
+        reason = dropping ? "dropped" : "congestion";
+      } else if (congestion > options.low_congestion || dropped_delta > 0) {
+        clean_since_ms = now_ms;
+      } else if (now_ms - clean_since_ms >= options.recover_ms && bitrate < ceiling) {
+        clean_since_ms = now_ms;
+        bitrate = std::min(ceiling, bitrate + options.step_up);
+        reason = "recovered";
+      }
+
+      if (!reason || bitrate == previous)
+        continue;
+
+      ObsAbrEvent* event = new ObsAbrEvent();
+      event->encoders = encoders;
+      event->name = obs_output_get_name(output);
+      event->bitrate = bitrate;
+      event->previous = previous;
+      event->reason = reason;
+      event->congestion = congestion;
+      event->dropped_frames = dropped_delta;
+      if (tsfn.NonBlockingCall(event, deliver) != napi_ok)
+        delete event;
+    }
+  }
+
+  static void deliver(Napi::Env env, Napi::Function callback, ObsAbrEvent* event) {
+    std::shared_ptr<ObsEncoderContext> encoders;
+    encoders.swap(event->encoders);
+    uint32_t bitrate = event->bitrate;
+    ObsTaskWorker::Post(env, [encoders, bitrate]() mutable {
+      obs_data_t* settings = obs_data_create();
+      obs_data_set_int(settings, "bitrate", bitrate);
+      obs_encoder_update(encoders->video_encoder, settings);
+      obs_data_release(settings);
+      encoders.reset();
+    }, ObsPriority::HIGH);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("name", Napi::String::New(env, event->name));
+    result.Set("bitrate", Napi::Number::New(env, event->bitrate));
+    result.Set("previous", Napi::Number::New(env, event->previous));
+    result.Set("reason", Napi::String::New(env, event->reason));
+    result.Set("congestion", Napi::Number::New(env, event->congestion));
+    result.Set("droppedFrames", Napi::Number::New(env, event->dropped_frames));
+    delete event;
+
+    callback.Call({ result });
+  }
+
+  napi_env env;
+  std::shared_ptr<ObsOutputContext> context;
+  std::shared_ptr<ObsEncoderContext> encoders;
+  ObsAbrOptions options;
+  uint32_t configured = 0;
+  uint32_t floor = 0;
+  uint32_t ceiling = 0;
+  uint32_t bitrate = 0;
+  bool running = true;
+  std::mutex mutex;
+  std::condition_variable cv;
+  Napi::ThreadSafeFunction tsfn;
+  std::thread thread;
+};
+
+static std::map<uint32_t, std::unique_ptr<ObsAbrController>> abr_controllers;
+static uint32_t next_abr_controller = 1;
+
+// Stops every ABR controller. Called from the JS thread before shutdown.
+static void stopAbrControllers() {
+  abr_controllers.clear();
+}
+
+// Asynchronously checks that the video encoder takes bitrate changes while
+// running and reads its configured bitrate, then starts the controller.
+//
+class AsyncEnableAbrWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(Napi::Env env, std::shared_ptr<ObsOutputContext> context,
+      const ObsAbrOptions& options, Napi::Function callback) {
+    AsyncEnableAbrWorker* worker = new AsyncEnableAbrWorker(env, context, options, callback);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    if (!context->output || !context->encoders) {
+      SetError("Error: output has been released");
+      return;
+    }
+
+    obs_encoder_t* encoder = context->encoders->video_encoder;
+    if (!encoder ||
+        !(obs_get_encoder_caps(obs_encoder_get_id(encoder)) & OBS_ENCODER_CAP_DYN_BITRATE)) {
+      SetError("Error: video encoder does not support dynamic bitrate");
+      return;
+    }
+
+    encoders = context->encoders;
+    configured = encoders->video_bitrate;
+    if (!configured) {
+      encoders->readVideoBitrate();
+      configured = encoders->video_bitrate;
+    }
+    uint32_t floor, ceiling;
+    if (!abrLimits(options, configured, floor, ceiling))
+      SetError("Error: ABR needs a bitrate and floor <= ceiling");
+  }
+
+  virtual void OnOK() override {
+    Napi::Env env = Env();
+    uint32_t id = next_abr_controller++;
+    abr_controllers[id].reset(new ObsAbrController(env, callback.Value(), context, encoders,
+        options, configured));
+    encoders.reset();
+
+    deferredPromise.Resolve(Napi::Function::New(env, [id](const Napi::CallbackInfo& info) {
+      abr_controllers.erase(id);
+      return info.Env().Undefined();
+    }, "disable"));
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncEnableAbrWorker(napi_env env, std::shared_ptr<ObsOutputContext>& context,
+      const ObsAbrOptions& options, Napi::Function callback) :
+    ObsCommandWorker(env),
+    context(context),
+    options(options),
+    callback(Napi::Persistent(callback)),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  std::shared_ptr<ObsOutputContext> context;
+  std::shared_ptr<ObsEncoderContext> encoders;
+  ObsAbrOptions options;
+  uint32_t configured = 0;
+  Napi::FunctionReference callback;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+Napi::Value ObsOutput::EnableAbr(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!context) {
+    Napi::TypeError::New(env, "Error: output has been released")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  ObsAbrOptions options;
+  if (info.Length() != 2 || !info[0].IsObject() || !info[1].IsFunction() ||
+      !parseAbrOptions(info[0].As<Napi::Object>(), options)) {
+    Napi::TypeError::New(env, "Expected ABR options and a callback")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  return AsyncEnableAbrWorker::Create(env, context, options, info[1].As<Napi::Function>());
+}
+
+// Raw video tap
+// Frames from obs_add_raw_video_callback (optionally scaled and converted by
+// libobs through video_scale_info) are written into a ring of slots that is
+// allocated once. JS sees every slot as an external ArrayBuffer over that
+// memory and is only told "slot N ready"; it hands the slot back with
+// release(N). When no slot is free the frame is dropped instead of blocking
+// the video thread.
+//
+// Nothing is allocated per frame, but every delivered frame is copied once
+// into its slot on the video thread: libobs only lends the frame for the
+// duration of the callback. That is width * height * 1.5 bytes for NV12 or
+// I420 and * 4 for RGBA/BGRA, so about 3 MB (90 MB/s) per 1080p30 NV12
+// frame, or 8 MB (250 MB/s) in BGRA. Scaling the tap down in libobs cuts
+// the copy with the frame.
+//
+// JS: createVideoTap({ slots, width, height, format }, cb(slot, timestampNs))
+//     -> { width, height, format, planes: [{ offset, linesize, height }],
+//          buffers: [ArrayBuffer], release(slot), stats(), stop() }
+#define DEFAULT_TAP_SLOTS 3
+#define MAX_TAP_SLOTS 16
+
+enum class ObsSlotState { FREE, WRITING, READY };
+
+struct ObsVideoTapPlane {
+  size_t offset;
+  uint32_t linesize;
+  uint32_t height;
+};
+
+struct ObsVideoTapSlot {
+  uint32_t index;
+  uint8_t* data;
+  uint64_t timestamp;
+  std::atomic<ObsSlotState> state{ ObsSlotState::FREE };
+};
+
+struct ObsVideoTap {
+  struct video_scale_info conversion;
+  std::vector<ObsVideoTapPlane> planes;
+  size_t slot_size = 0;
+  std::vector<std::unique_ptr<ObsVideoTapSlot>> slots;
+  std::atomic<uint64_t> delivered{ 0 };
+  std::atomic<uint64_t> dropped{ 0 };
+  Napi::ThreadSafeFunction tsfn;
+  bool connected = false;
+
+  ~ObsVideoTap() {
+    for (auto& slot : slots)
+      bfree(slot->data);
+  }
+
+  // Packed plane layout of one frame in the given format.
+  bool layout() {
+    uint32_t w = conversion.width;
+    uint32_t h = conversion.height;
+    planes.clear();
+
+    switch (conversion.format) {
+    case VIDEO_FORMAT_RGBA:
+    case VIDEO_FORMAT_BGRA:
+      planes.push_back({ 0, w * 4, h });
+      break;
+    case VIDEO_FORMAT_NV12:
+      planes.push_back({ 0, w, h });
+      planes.push_back({ (size_t)w * h, w, h / 2 });
+      break;
+    case VIDEO_FORMAT_I420:
+      planes.push_back({ 0, w, h });
+      planes.push_back({ (size_t)w * h, w / 2, h / 2 });
+      planes.push_back({ (size_t)w * h + (size_t)(w / 2) * (h / 2), w / 2, h / 2 });
+      break;
+    default:
+      return false;
+    }
+
+    const ObsVideoTapPlane& last = planes.back();
+    slot_size = last.offset + (size_t)last.linesize * last.height;
+    return true;
+  }
+
+  size_t count(ObsSlotState state) const {
+    size_t n = 0;
+    for (const auto& slot : slots)
+      n += slot->state.load() == state;
+    return n;
+  }
+
+  static void onFrame(void* param, struct video_data* frame) {
+    ObsVideoTap* tap = (ObsVideoTap*)param;
+
+    ObsVideoTapSlot* slot = nullptr;
+    for (auto& candidate : tap->slots) {
+      ObsSlotState expected = ObsSlotState::FREE;
+      if (candidate->state.compare_exchange_strong(expected, ObsSlotState::WRITING)) {
+        slot = candidate.get();
+        break;
+      }
+    }
+    if (!slot) {
+      tap->dropped++;
+      return;
+    }
+
+    for (size_t p = 0; p < tap->planes.size(); p++) {
+      const ObsVideoTapPlane& plane = tap->planes[p];
+      uint8_t* dst = slot->data + plane.offset;
+      const uint8_t* src = frame->data[p];
+      if (frame->linesize[p] == plane.linesize) {
+        memcpy(dst, src, (size_t)plane.linesize * plane.height);
+        continue;
+      }
+      uint32_t row = std::min(plane.linesize, frame->linesize[p]);
+      for (uint32_t y = 0; y < plane.height; y++)
+        memcpy(dst + (size_t)y * plane.linesize, src + (size_t)y * frame->linesize[p], row);
+    }
+
+    slot->timestamp = frame->timestamp;
+    slot->state = ObsSlotState::READY;
+
+    if (tap->tsfn.NonBlockingCall(slot, notify) != napi_ok) {
+      slot->state = ObsSlotState::FREE;
+      tap->dropped++;
+      return;
+    }
+    tap->delivered++;
+  }
+
+  static void notify(Napi::Env env, Napi::Function callback, ObsVideoTapSlot* slot) {
+    callback.Call({ Napi::Number::New(env, slot->index),
+        Napi::Number::New(env, (double)slot->timestamp) });
+  }
+
+  void disconnect() {
+    if (!connected)
+      return;
+    obs_remove_raw_video_callback(onFrame, this);
+    tsfn.Release();
+    connected = false;
+  }
+};
+
+static std::map<uint32_t, std::shared_ptr<ObsVideoTap>> video_taps;
+static uint32_t next_video_tap = 1;
+
+static bool parseVideoFormat(const std::string& name, enum video_format& format) {
+  if (name == "rgba")
+    format = VIDEO_FORMAT_RGBA;
+  else if (name == "bgra")
+    format = VIDEO_FORMAT_BGRA;
+  else if (name == "nv12")
+    format = VIDEO_FORMAT_NV12;
+  else if (name == "i420")
+    format = VIDEO_FORMAT_I420;
+  else
+    return false;
+  return true;
+}
+
+Napi::Value obsCreateVideoTap(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!initReady()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() != 2 || !info[0].IsObject() || !info[1].IsFunction()) {
+    Napi::TypeError::New(env, "Expected an options object and a callback")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  struct obs_video_info ovi;
+  if (!obs_get_video_info(&ovi)) {
+    Napi::Error::New(env, "Error: video must be reset before creating a video tap")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  Napi::Object options = info[0].As<Napi::Object>();
+  std::string format_name = "rgba";
+  uint32_t slot_count = DEFAULT_TAP_SLOTS;
+
+  std::shared_ptr<ObsVideoTap> tap = std::make_shared<ObsVideoTap>();
+  tap->conversion.width = ovi.output_width;
+  tap->conversion.height = ovi.output_height;
+  tap->conversion.colorspace = ovi.colorspace;
+  tap->conversion.range = ovi.range;
+
+  if (!getString(options, "format", format_name) ||
+      !parseVideoFormat(format_name, tap->conversion.format)) {
+    Napi::TypeError::New(env, "Expected format to be one of rgba, bgra, nv12, i420")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (options.Has("width") && options.Get("width").IsNumber())
+    tap->conversion.width = options.Get("width").As<Napi::Number>().Uint32Value() & ~1u;
+  if (options.Has("height") && options.Get("height").IsNumber())
+    tap->conversion.height = options.Get("height").As<Napi::Number>().Uint32Value() & ~1u;
+  if (options.Has("slots") && options.Get("slots").IsNumber())
+    slot_count = std::min((uint32_t)MAX_TAP_SLOTS,
+        std::max(2u, options.Get("slots").As<Napi::Number>().Uint32Value()));
+
+  if (!tap->conversion.width || !tap->conversion.height || !tap->layout()) {
+    Napi::TypeError::New(env, "Invalid video tap size")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (tap->conversion.format == VIDEO_FORMAT_RGBA || tap->conversion.format == VIDEO_FORMAT_BGRA)
+    tap->conversion.range = VIDEO_RANGE_FULL;
+
+  Napi::Array buffers = Napi::Array::New(env, slot_count);
+  for (uint32_t i = 0; i < slot_count; i++) {
+    std::unique_ptr<ObsVideoTapSlot> slot(new ObsVideoTapSlot());
+    slot->index = i;
+    slot->data = (uint8_t*)bzalloc(tap->slot_size);
+
+    // Every buffer keeps the ring alive until it is garbage collected.
+    buffers.Set(i, Napi::ArrayBuffer::New(env, slot->data, tap->slot_size,
+        [](Napi::Env, void*, std::shared_ptr<ObsVideoTap>* hint) { delete hint; },
+        new std::shared_ptr<ObsVideoTap>(tap)));
+    tap->slots.push_back(std::move(slot));
+  }
+
+  // Queued notifications point into the ring, so the function keeps it alive too.
+  tap->tsfn = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(),
+      "obsapi_video_tap", slot_count, 1, new std::shared_ptr<ObsVideoTap>(tap),
+      [](Napi::Env, std::shared_ptr<ObsVideoTap>* context) { delete context; });
+  ObsTaskWorker::Post(env, [tap]() {
+    obs_add_raw_video_callback(&tap->conversion, ObsVideoTap::onFrame, tap.get());
+    tap->connected = true;
+  });
+
+  uint32_t id = next_video_tap++;
+  video_taps[id] = tap;
+
+  Napi::Array planes = Napi::Array::New(env, tap->planes.size());
+  for (size_t i = 0; i < tap->planes.size(); i++) {
+    Napi::Object plane = Napi::Object::New(env);
+    plane.Set("offset", Napi::Number::New(env, (double)tap->planes[i].offset));
+    plane.Set("linesize", Napi::Number::New(env, tap->planes[i].linesize));
+    plane.Set("height", Napi::Number::New(env, tap->planes[i].height));
+    planes.Set(i, plane);
+  }
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("width", Napi::Number::New(env, tap->conversion.width));
+  result.Set("height", Napi::Number::New(env, tap->conversion.height));
+  result.Set("format", Napi::String::New(env, format_name));
+  result.Set("planes", planes);
+  result.Set("buffers", buffers);
+  result.Set("release", Napi::Function::New(env, [tap](const Napi::CallbackInfo& info) {
+    if (info.Length() == 1 && info[0].IsNumber()) {
+      uint32_t index = info[0].As<Napi::Number>().Uint32Value();
+      if (index < tap->slots.size()) {
+        ObsSlotState expected = ObsSlotState::READY;
+        tap->slots[index]->state.compare_exchange_strong(expected, ObsSlotState::FREE);
+      }
+    }
+    return info.Env().Undefined();
+  }, "release"));
+  result.Set("stats", Napi::Function::New(env, [tap](const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("delivered", Napi::Number::New(env, (double)tap->delivered.load()));
+    stats.Set("dropped", Napi::Number::New(env, (double)tap->dropped.load()));
+    stats.Set("slotsFree", Napi::Number::New(env, (double)tap->count(ObsSlotState::FREE)));
+    stats.Set("slotsHeld", Napi::Number::New(env, (double)tap->count(ObsSlotState::READY)));
+    return stats;
+  }, "stats"));
+  result.Set("stop", Napi::Function::New(env, [id](const Napi::CallbackInfo& info) {
+    auto it = video_taps.find(id);
+    if (it != video_taps.end()) {
+      std::shared_ptr<ObsVideoTap> tap = it->second;
+      video_taps.erase(it);
+      ObsTaskWorker::Post(info.Env(), [tap]() { tap->disconnect(); });
+    }
+    return info.Env().Undefined();
+  }, "stop"));
+  return result;
+}
+
+// Audio tap
+// Meters a mix natively from obs_add_raw_audio_callback. Every callback
+// block is reduced to per-channel peak and sum of squares with vectorized
+// kernels (SSE2/NEON, scalar fallback) over the float planar buffers, and a
+// K-weighted momentary loudness (400 ms, BS.1770 style) is kept alongside.
+// Only the aggregated levels reach JS, once per interval. Optionally the raw
+// samples are also copied into a single-producer PCM ring that JS reads
+// through external ArrayBuffers.
+//
+// JS: createAudioTap({ mix, intervalMs, pcmFrames }, cb(levels)) -> { stop(), pcm }
+//     intervalMs: 10-10000, default 50
+//     levels: { mix, timestamp, loudness, channels: [{ peak, rms }] }  (dBFS / LUFS)
+//     pcm:    { frames, channels: [ArrayBuffer of float], position: ArrayBuffer }
+//             position holds the total frames written (uint32, wrapping)
+#define DEFAULT_AUDIO_TAP_INTERVAL_MS 50
+#define MIN_AUDIO_TAP_INTERVAL_MS 10
+#define MAX_AUDIO_TAP_INTERVAL_MS 10000
+#define LOUDNESS_BLOCK_MS 100
+#define LOUDNESS_BLOCKS 4
+
+// Peak magnitude and sum of squares of a block of float samples.
+static void meterSamples(const float* samples, size_t count, float& peak, double& sum_squares) {
+  size_t i = 0;
+  float block_peak = 0.0f;
+  double block_sum = 0.0;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  __m128 vpeak = _mm_setzero_ps();
+  __m128 vsum = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(samples + i);
+    vpeak = _mm_max_ps(vpeak, _mm_and_ps(x, abs_mask));
+    vsum = _mm_add_ps(vsum, _mm_mul_ps(x, x));
+  }
+  float lanes[4];
+  _mm_storeu_ps(lanes, vpeak);
+  block_peak = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+  _mm_storeu_ps(lanes, vsum);
+  block_sum = (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  float32x4_t vpeak = vdupq_n_f32(0.0f);
+  float32x4_t vsum = vdupq_n_f32(0.0f);
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t x = vld1q_f32(samples + i);
+    vpeak = vmaxq_f32(vpeak, vabsq_f32(x));
+    vsum = vmlaq_f32(vsum, x, x);
+  }
+  block_peak = vmaxvq_f32(vpeak);
+  block_sum = vaddvq_f32(vsum);
+#endif
+
+  for (; i < count; i++) {
+    float x = samples[i];
+    block_peak = std::max(block_peak, std::fabs(x));
+    block_sum += (double)x * x;
+  }
+
+  peak = std::max(peak, block_peak);
+  sum_squares += block_sum;
+}
+
+// Second order IIR section (direct form II transposed).
+struct ObsBiquad {
+  double b0 = 1, b1 = 0, b2 = 0, a1 = 0, a2 = 0;
+  double z1 = 0, z2 = 0;
+
+  inline double process(double x) {
+    double y = b0 * x + z1;
+    z1 = b1 * x - a1 * y + z2;
+    z2 = b2 * x - a2 * y;
+    return y;
+  }
+};
+
+// K-weighting filter of ITU-R BS.1770: high shelf followed by high pass.
+static void kWeighting(double rate, ObsBiquad& shelf, ObsBiquad& highpass) {
+  const double pi = 3.14159265358979323846;
+  double f0 = 1681.974450955533;
+  double gain = 3.999843853973347;
+  double q = 0.7071752369554196;
+  double k = std::tan(pi * f0 / rate);
+  double vh = std::pow(10.0, gain / 20.0);
+  double vb = std::pow(vh, 0.4996667741545416);
+  double a0 = 1.0 + k / q + k * k;
+  shelf.b0 = (vh + vb * k / q + k * k) / a0;
+  shelf.b1 = 2.0 * (k * k - vh) / a0;
+  shelf.b2 = (vh - vb * k / q + k * k) / a0;
+  shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+  shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+  f0 = 38.13547087602444;
+  q = 0.5003270373238773;
+  k = std::tan(pi * f0 / rate);
+  a0 = 1.0 + k / q + k * k;
+  highpass.b0 = 1.0;
+  highpass.b1 = -2.0;
+  highpass.b2 = 1.0;
+  highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+  highpass.a2 = (1.0 - k / q + k * k) / a0;
+}
+
+static double toDb(double magnitude) {
+  return magnitude > 0.0 ? 20.0 * std::log10(magnitude) : -INFINITY;
+}
+
+struct ObsAudioLevels {
+  size_t mix;
+  double timestamp_ms;
+  double loudness;
+  std::vector<float> peak;
+  std::vector<double> rms;
+};
+
+struct ObsAudioTap {
+  size_t mix = 0;
+  size_t channels = 0;
+  uint32_t sample_rate = 0;
+  uint32_t interval_frames = 0;
+  uint32_t block_frames = 0;
+
+  // Interval accumulators.
+  std::vector<float> peak;
+  std::vector<double> sum_squares;
+  uint32_t interval_count = 0;
+
+  // Loudness state.
+  std::vector<ObsBiquad> shelf;
+  std::vector<ObsBiquad> highpass;
+  std::vector<double> weights;
+  double block_energy = 0;
+  uint32_t block_count = 0;
+  double blocks[LOUDNESS_BLOCKS] = {};
+  size_t block_index = 0;
+  size_t blocks_filled = 0;
+  double loudness = -INFINITY;
+
+  // Optional PCM ring.
+  uint32_t pcm_frames = 0;
+  std::vector<float*> pcm;
+  std::atomic<uint32_t>* pcm_position = nullptr;
+
+  Napi::ThreadSafeFunction tsfn;
+  bool connected = false;
+
+  ~ObsAudioTap() {
+    for (float* channel : pcm)
+      bfree(channel);
+    bfree(pcm_position);
+  }
+
+  void setup(const struct obs_audio_info& oai, uint32_t interval_ms) {
+    channels = get_audio_channels(oai.speakers);
+    sample_rate = oai.samples_per_sec;
+    interval_frames = std::max(1u, (uint32_t)((uint64_t)sample_rate * interval_ms / 1000));
+    block_frames = sample_rate * LOUDNESS_BLOCK_MS / 1000;
+
+    peak.assign(channels, 0.0f);
+    sum_squares.assign(channels, 0.0);
+    shelf.resize(channels);
+    highpass.resize(channels);
+    weights.assign(channels, 1.0);
+    for (size_t c = 0; c < channels; c++)
+      kWeighting(sample_rate, shelf[c], highpass[c]);
+
+    // Surround layouts: no LFE contribution, rear channels weighted +1.5 dB.
+    if (oai.speakers == SPEAKERS_5POINT1 || oai.speakers == SPEAKERS_7POINT1) {
+      weights[3] = 0.0;
+      for (size_t c = 4; c < channels; c++)
+        weights[c] = 1.41;
+    }
+  }
+
+  void measure(struct audio_data* data) {
+    for (size_t c = 0; c < channels; c++)
+      meterSamples((const float*)data->data[c], data->frames, peak[c], sum_squares[c]);
+
+    // The K-weighting filters are recursive, so they run sample by sample.
+    for (uint32_t i = 0; i < data->frames; i++) {
+      double energy = 0;
+      for (size_t c = 0; c < channels; c++) {
+        if (weights[c] == 0.0)
+          continue;
+        double x = ((const float*)data->data[c])[i];
+        double y = highpass[c].process(shelf[c].process(x));
+        energy += weights[c] * y * y;
+      }
+      block_energy += energy;
+
+      if (++block_count == block_frames) {
+        blocks[block_index] = block_energy / block_frames;
+        block_index = (block_index + 1) % LOUDNESS_BLOCKS;
+        blocks_filled = std::min(blocks_filled + 1, (size_t)LOUDNESS_BLOCKS);
+        block_energy = 0;
+        block_count = 0;
+
+        double mean = 0;
+        for (size_t b = 0; b < blocks_filled; b++)
+          mean += blocks[b];
+        mean /= blocks_filled;
+        loudness = mean > 0 ? -0.691 + 10.0 * std::log10(mean) : -INFINITY;
+      }
+    }
+  }
+
+  void writePcm(struct audio_data* data) {
+    uint32_t position = pcm_position->load(std::memory_order_relaxed);
+    uint32_t start = position % pcm_frames;
+    uint32_t first = std::min(data->frames, pcm_frames - start);
+    for (size_t c = 0; c < channels; c++) {
+      const float* src = (const float*)data->data[c];
+      memcpy(pcm[c] + start, src, first * sizeof(float));
+      memcpy(pcm[c], src + first, (data->frames - first) * sizeof(float));
+    }
+    pcm_position->store(position + data->frames, std::memory_order_release);
+  }
+
+  static void onAudio(void* param, size_t, struct audio_data* data) {
+    ObsAudioTap* tap = (ObsAudioTap*)param;
+
+    tap->measure(data);
+    if (tap->pcm_frames)
+      tap->writePcm(data);
+
+    tap->interval_count += data->frames;
+    if (tap->interval_count < tap->interval_frames)
+      return;
+
+    ObsAudioLevels* levels = new ObsAudioLevels();
+    levels->mix = tap->mix;
+    levels->timestamp_ms = (double)data->timestamp / 1e6;
+    levels->loudness = tap->loudness;
+    levels->peak = tap->peak;
+    levels->rms.resize(tap->channels);
+    for (size_t c = 0; c < tap->channels; c++)
+      levels->rms[c] = std::sqrt(tap->sum_squares[c] / tap->interval_count);
+
+    std::fill(tap->peak.begin(), tap->peak.end(), 0.0f);
+    std::fill(tap->sum_squares.begin(), tap->sum_squares.end(), 0.0);
+    tap->interval_count = 0;
+
+    if (tap->tsfn.NonBlockingCall(levels, deliver) != napi_ok)
+      delete levels;
+  }
+
+  static void deliver(Napi::Env env, Napi::Function callback, ObsAudioLevels* levels) {
+    Napi::Array channels = Napi::Array::New(env, levels->peak.size());
+    for (size_t c = 0; c < levels->peak.size(); c++) {
+      Napi::Object channel = Napi::Object::New(env);
+      channel.Set("peak", Napi::Number::New(env, toDb(levels->peak[c])));
+      channel.Set("rms", Napi::Number::New(env, toDb(levels->rms[c])));
+      channels.Set(c, channel);
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("mix", Napi::Number::New(env, (double)levels->mix));
+    result.Set("timestamp", Napi::Number::New(env, levels->timestamp_ms));
+    result.Set("loudness", Napi::Number::New(env, levels->loudness));
+    result.Set("channels", channels);
+    delete levels;
+
+    callback.Call({ result });
+  }
+
+  void disconnect() {
+    if (!connected)
+      return;
+    obs_remove_raw_audio_callback(mix, onAudio, this);
+    tsfn.Release();
+    connected = false;
+  }
+};
+
+static std::map<uint32_t, std::shared_ptr<ObsAudioTap>> audio_taps;
+static uint32_t next_audio_tap = 1;
+
+Napi::Value obsCreateAudioTap(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!initReady()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() != 2 || !info[0].IsObject() || !info[1].IsFunction()) {
+    Napi::TypeError::New(env, "Expected an options object and a callback")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  struct obs_audio_info oai;
+  if (!obs_get_audio_info(&oai)) {
+    Napi::Error::New(env, "Error: audio must be reset before creating an audio tap")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  Napi::Object options = info[0].As<Napi::Object>();
+  uint32_t interval_ms = DEFAULT_AUDIO_TAP_INTERVAL_MS;
+  std::shared_ptr<ObsAudioTap> tap = std::make_shared<ObsAudioTap>();
+
+  if (options.Has("mix") && options.Get("mix").IsNumber())
+    tap->mix = options.Get("mix").As<Napi::Number>().Uint32Value();
+  if (options.Has("intervalMs") && options.Get("intervalMs").IsNumber())
+    interval_ms = std::min((uint32_t)MAX_AUDIO_TAP_INTERVAL_MS,
+        std::max((uint32_t)MIN_AUDIO_TAP_INTERVAL_MS,
+            options.Get("intervalMs").As<Napi::Number>().Uint32Value()));
+  if (options.Has("pcmFrames") && options.Get("pcmFrames").IsNumber())
+    tap->pcm_frames = options.Get("pcmFrames").As<Napi::Number>().Uint32Value();
+
+  if (tap->mix >= MAX_AUDIO_MIXES) {
+    Napi::TypeError::New(env, "Invalid audio mix index")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  tap->setup(oai, interval_ms);
+
+  Napi::Object result = Napi::Object::New(env);
+
+  if (tap->pcm_frames) {
+    // Never smaller than one callback block, so a write wraps at most once.
+    tap->pcm_frames = std::max(tap->pcm_frames, (uint32_t)AUDIO_OUTPUT_FRAMES);
+    tap->pcm_position = (std::atomic<uint32_t>*)bzalloc(sizeof(std::atomic<uint32_t>));
+    new (tap->pcm_position) std::atomic<uint32_t>(0);
+
+    Napi::Array channels = Napi::Array::New(env, tap->channels);
+    for (size_t c = 0; c < tap->channels; c++) {
+      float* channel = (float*)bzalloc(tap->pcm_frames * sizeof(float));
+      tap->pcm.push_back(channel);
+      channels.Set(c, Napi::ArrayBuffer::New(env, channel, tap->pcm_frames * sizeof(float),
+          [](Napi::Env, void*, std::shared_ptr<ObsAudioTap>* hint) { delete hint; },
+          new std::shared_ptr<ObsAudioTap>(tap)));
+    }
+
+    Napi::Object pcm = Napi::Object::New(env);
+    pcm.Set("frames", Napi::Number::New(env, tap->pcm_frames));
+    pcm.Set("channels", channels);
+    pcm.Set("position", Napi::ArrayBuffer::New(env, tap->pcm_position, sizeof(uint32_t),
+        [](Napi::Env, void*, std::shared_ptr<ObsAudioTap>* hint) { delete hint; },
+        new std::shared_ptr<ObsAudioTap>(tap)));
+    result.Set("pcm", pcm);
+  }
+
+  tap->tsfn = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(),
+      "obsapi_audio_tap", 4, 1);
+  ObsTaskWorker::Post(env, [tap]() {
+    obs_add_raw_audio_callback(tap->mix, nullptr, ObsAudioTap::onAudio, tap.get());
+    tap->connected = true;
+  });
+
+  uint32_t id = next_audio_tap++;
+  audio_taps[id] = tap;
+
+  result.Set("sampleRate", Napi::Number::New(env, tap->sample_rate));
+  result.Set("channelCount", Napi::Number::New(env, (double)tap->channels));
+  result.Set("stop", Napi::Function::New(env, [id](const Napi::CallbackInfo& info) {
+    auto it = audio_taps.find(id);
+    if (it != audio_taps.end()) {
+      std::shared_ptr<ObsAudioTap> tap = it->second;
+      audio_taps.erase(it);
+      ObsTaskWorker::Post(info.Env(), [tap]() { tap->disconnect(); });
+    }
+    return info.Env().Undefined();
+  }, "stop"));
+  return result;
+}
+
+// Encoded packet tap
+// A native output bound to shared encoders that hands every encoded packet
+// to JS without copying it: each packet is referenced with
+// obs_encoder_packet_ref and exposed as an external ArrayBuffer whose
+// finalizer releases the reference. Packets arriving while a delivery is
+// pending join the same batch, so JS gets one call per turn of its event
+// loop however high the bitrate. When more than maxPending packets wait,
+// new ones are dropped; video then resumes at the next keyframe.
+//
+// JS: createPacketTap({ encoders, maxPending }, cb(packets, headers?)) -> { stop(), stats() }
+//     stats() -> { delivered, batches, dropped, error? }, error when the tap could not start
+//     packets: [{ type: 'video' | 'audio', data, pts, dts, timebase: [num, den],
+//                 keyframe, track }]
+//     headers: { video?, audio? } codec extradata (E.G. SPS/PPS), with the first batch
+#define PACKET_TAP_OUTPUT_ID ("obsapi_packet_tap")
+#define DEFAULT_PACKET_TAP_MAX_PENDING 1024
+
+// Bytes of delivered packets that JS has not garbage collected yet.
+static std::atomic<uint64_t> packet_tap_held_bytes{0};
+
+struct ObsPacketTap {
+  std::shared_ptr<ObsEncoderContext> encoders;
+  obs_output_t* output = nullptr;
+  uint32_t flags = 0;
+  Napi::ThreadSafeFunction tsfn;
+  uint32_t max_pending = DEFAULT_PACKET_TAP_MAX_PENDING;
+
+  std::mutex mutex;
+  std::vector<struct encoder_packet*> pending;
+  bool scheduled = false;
+  bool wait_keyframe = false;
+  bool headers_sent = false;
+  std::vector<uint8_t> video_header;
+  std::vector<uint8_t> audio_header;
+  std::string error;
+
+  std::atomic<uint64_t> delivered{0};
+  std::atomic<uint64_t> batches{0};
+  std::atomic<uint64_t> dropped{0};
+
+  ~ObsPacketTap() {
+    for (struct encoder_packet* packet : pending)
+      releasePacket(packet);
+  }
+
+  static void releasePacket(struct encoder_packet* packet) {
+    obs_encoder_packet_release(packet);
+    delete packet;
+  }
+
+  void pendingUsage(size_t& packets, uint64_t& bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    packets = pending.size();
+    bytes = 0;
+    for (struct encoder_packet* packet : pending)
+      bytes += packet->size;
+  }
+
+  // Runs on the encoder threads.
+  void onPacket(struct encoder_packet* packet) {
+    bool video = packet->type == OBS_ENCODER_VIDEO;
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (video && wait_keyframe) {
+      if (!packet->keyframe) {
+        dropped++;
+        return;
+      }
+      wait_keyframe = false;
+    }
+    if (pending.size() >= max_pending) {
+      dropped++;
+      wait_keyframe = wait_keyframe || video;
+      return;
+    }
+
+    struct encoder_packet* ref = new encoder_packet();
+    obs_encoder_packet_ref(ref, packet);
+    pending.push_back(ref);
+
+    if (!scheduled) {
+      scheduled = tsfn.NonBlockingCall(this, deliver) == napi_ok;
+    }
+  }
+
+  static void copyExtraData(obs_encoder_t* encoder, std::vector<uint8_t>& out) {
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    if (encoder && obs_encoder_get_extra_data(encoder, &data, &size))
+      out.assign(data, data + size);
+  }
+
+  static Napi::Value headerToJs(Napi::Env env, const std::vector<uint8_t>& header) {
+    if (header.empty())
+      return env.Undefined();
+    Napi::ArrayBuffer buffer = Napi::ArrayBuffer::New(env, header.size());
+    memcpy(buffer.Data(), header.data(), header.size());
+    return buffer;
+  }
+
+  static void deliver(Napi::Env env, Napi::Function callback, ObsPacketTap* tap) {
+    std::vector<struct encoder_packet*> batch;
+    Napi::Value headers;
+    {
+      std::lock_guard<std::mutex> lock(tap->mutex);
+      batch.swap(tap->pending);
+      tap->scheduled = false;
+      if (!tap->headers_sent) {
+        Napi::Object object = Napi::Object::New(env);
+        object.Set("video", headerToJs(env, tap->video_header));
+        object.Set("audio", headerToJs(env, tap->audio_header));
+        headers = object;
+        tap->headers_sent = true;
+      }
+    }
+
+    Napi::Array packets = Napi::Array::New(env, batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+      struct encoder_packet* packet = batch[i];
+      Napi::Array timebase = Napi::Array::New(env, 2);
+      timebase.Set((uint32_t)0, Napi::Number::New(env, packet->timebase_num));
+      timebase.Set((uint32_t)1, Napi::Number::New(env, packet->timebase_den));
+
+      Napi::Object item = Napi::Object::New(env);
+      item.Set("type", Napi::String::New(env, packet->type == OBS_ENCODER_VIDEO ? "video" : "audio"));
+      packet_tap_held_bytes += packet->size;
+      item.Set("data", Napi::ArrayBuffer::New(env, packet->data, packet->size,
+          [](Napi::Env, void*, struct encoder_packet* hint) {
+            packet_tap_held_bytes -= hint->size;
+            releasePacket(hint);
+          }, packet));
+      item.Set("pts", Napi::Number::New(env, (double)packet->pts));
+      item.Set("dts", Napi::Number::New(env, (double)packet->dts));
+      item.Set("timebase", timebase);
+      item.Set("keyframe", Napi::Boolean::New(env, packet->keyframe));
+      item.Set("track", Napi::Number::New(env, (double)packet->track_idx));
+      packets.Set(i, item);
+    }
+    tap->delivered += batch.size();
+    tap->batches++;
+
+    if (headers.IsEmpty())
+      callback.Call({ packets });
+    else
+      callback.Call({ packets, headers });
+  }
+
+  // Runs on the command thread.
+  void disconnect() {
+    if (output) {
+      obs_output_stop(output);
+      obs_output_release(output);
+      output = nullptr;
+    }
+    encoders.reset();
+    tsfn.Release();
+  }
+};
+
+// Plugin data of the packet tap output; tap is set right after creation.
+struct ObsPacketTapOutput {
+  obs_output_t* output = nullptr;
+  ObsPacketTap* tap = nullptr;
+};
+
+static const char* packetTapGetName(void*) {
+  return "obsapi packet tap";
+}
+
+static void packetTapGet(void* data, calldata_t* cd) {
+  calldata_set_ptr(cd, "output", data);
+}
+
+static void* packetTapCreate(obs_data_t*, obs_output_t* output) {
+  ObsPacketTapOutput* data = new ObsPacketTapOutput();
+  data->output = output;
+  proc_handler_add(obs_output_get_proc_handler(output), "void get_output(out ptr output)",
+      packetTapGet, data);
+  return data;
+}
+
+static void packetTapDestroy(void* data) {
+  delete (ObsPacketTapOutput*)data;
+}
+
+static bool packetTapStart(void* data) {
+  ObsPacketTapOutput* tap_output = (ObsPacketTapOutput*)data;
+  uint32_t flags = tap_output->tap->flags;
+  if (!obs_output_can_begin_data_capture(tap_output->output, flags) ||
+      !obs_output_initialize_encoders(tap_output->output, flags))
+    return false;
+  return obs_output_begin_data_capture(tap_output->output, flags);
+}
+
+static void packetTapStop(void* data, uint64_t) {
+  obs_output_end_data_capture(((ObsPacketTapOutput*)data)->output);
+}
+
+static void packetTapPacket(void* data, struct encoder_packet* packet) {
+  if (packet)
+    ((ObsPacketTapOutput*)data)->tap->onPacket(packet);
+}
+
+// Registers the packet tap output type once per OBS session.
+static void registerPacketTapOutput() {
+  if (obs_output_get_display_name(PACKET_TAP_OUTPUT_ID))
+    return;
+
+  struct obs_output_info info = {};
+  info.id = PACKET_TAP_OUTPUT_ID;
+  info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED;
+  info.get_name = packetTapGetName;
+  info.create = packetTapCreate;
+  info.destroy = packetTapDestroy;
+  info.start = packetTapStart;
+  info.stop = packetTapStop;
+  info.encoded_packet = packetTapPacket;
+  obs_register_output(&info);
+}
+
+// Creates and starts the tap's output; on failure the output is released
+// again and error is set. Runs on the command thread.
+static bool connectPacketTap(ObsPacketTap* tap, std::string& error) {
+  registerPacketTapOutput();
+
+  tap->output = obs_output_create(PACKET_TAP_OUTPUT_ID, "obsapi_packet_tap", nullptr, nullptr);
+  if (!tap->output) {
+    error = "Error: could not create the packet tap output";
+    return false;
+  }
+
+  calldata_t cd = {};
+  proc_handler_call(obs_output_get_proc_handler(tap->output), "get_output", &cd);
+  ObsPacketTapOutput* tap_output = (ObsPacketTapOutput*)calldata_ptr(&cd, "output");
+  calldata_free(&cd);
+  if (!tap_output) {
+    error = "Error: could not create the packet tap output";
+    obs_output_release(tap->output);
+    tap->output = nullptr;
+    return false;
+  }
+  tap_output->tap = tap;
+
+  tap->encoders->rebind();
+  if (tap->encoders->video_encoder) {
+    obs_output_set_video_encoder(tap->output, tap->encoders->video_encoder);
+    tap->flags |= OBS_OUTPUT_VIDEO;
+  }
+  if (tap->encoders->audio_encoder) {
+    obs_output_set_audio_encoder(tap->output, tap->encoders->audio_encoder, 0);
+    tap->flags |= OBS_OUTPUT_AUDIO;
+  }
+  if (!obs_output_start(tap->output)) {
+    const char* last_error = obs_output_get_last_error(tap->output);
+    error = std::string("Error: could not start packet tap") +
+        (last_error ? std::string(": ") + last_error : std::string());
+    obs_output_release(tap->output);
+    tap->output = nullptr;
+    return false;
+  }
+
+  // Extradata is fixed once the encoders have been initialized by the start.
+  std::lock_guard<std::mutex> lock(tap->mutex);
+  ObsPacketTap::copyExtraData(tap->encoders->video_encoder, tap->video_header);
+  ObsPacketTap::copyExtraData(tap->encoders->audio_encoder, tap->audio_header);
+  return true;
+}
+
+static std::map<uint32_t, std::shared_ptr<ObsPacketTap>> packet_taps;
+static uint32_t next_packet_tap = 1;
+
+Napi::Value obsCreatePacketTap(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!initReady()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  if (info.Length() != 2 || !info[0].IsObject() || !info[1].IsFunction()) {
+    Napi::TypeError::New(env, "Expected an options object and a callback")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  Napi::Object options = info[0].As<Napi::Object>();
+  std::shared_ptr<ObsPacketTap> tap = std::make_shared<ObsPacketTap>();
+  tap->encoders = options.Has("encoders") ?
+      ObsEncoders::FromValue(options.Get("encoders")) : nullptr;
+  if (!tap->encoders || !getUint(options, "maxPending", tap->max_pending)) {
+    Napi::TypeError::New(env, "Expected encoders from createEncoders()")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  // Queued deliveries point at the tap, so the function keeps it alive.
+  tap->tsfn = Napi::ThreadSafeFunction::New(env, info[1].As<Napi::Function>(),
+      "obsapi_packet_tap", 2, 1, new std::shared_ptr<ObsPacketTap>(tap),
+      [](Napi::Env, std::shared_ptr<ObsPacketTap>* context) { delete context; });
+  ObsTaskWorker::Post(env, [tap]() {
+    std::string error;
+    if (!connectPacketTap(tap.get(), error)) {
+      blog(LOG_WARNING, "obsapi: %s", error.c_str());
+      std::lock_guard<std::mutex> lock(tap->mutex);
+      tap->error = error;
+    }
+  });
+
+  uint32_t id = next_packet_tap++;
+  packet_taps[id] = tap;
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("stats", Napi::Function::New(env, [tap](const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    Napi::Object stats = Napi::Object::New(env);
+    stats.Set("delivered", Napi::Number::New(env, (double)tap->delivered.load()));
+    stats.Set("batches", Napi::Number::New(env, (double)tap->batches.load()));
+    stats.Set("dropped", Napi::Number::New(env, (double)tap->dropped.load()));
+    std::lock_guard<std::mutex> lock(tap->mutex);
+    if (!tap->error.empty())
+      stats.Set("error", Napi::String::New(env, tap->error));
+    return stats;
+  }, "stats"));
+  result.Set("stop", Napi::Function::New(env, [id](const Napi::CallbackInfo& info) {
+    auto it = packet_taps.find(id);
+    if (it != packet_taps.end()) {
+      std::shared_ptr<ObsPacketTap> tap = it->second;
+      packet_taps.erase(it);
+      ObsTaskWorker::Post(info.Env(), [tap]() { tap->disconnect(); });
+    }
+    return info.Env().Undefined();
+  }, "stop"));
+  return result;
+}
+
+// The video, audio and packet taps, taken out of their maps. The maps are
+// only touched on the JS thread, so shutdown takes them there and
+// disconnects the taps on the command thread, where they were connected.
+struct ObsTaps {
+  std::map<uint32_t, std::shared_ptr<ObsVideoTap>> video;
+  std::map<uint32_t, std::shared_ptr<ObsAudioTap>> audio;
+  std::map<uint32_t, std::shared_ptr<ObsPacketTap>> packet;
+
+  // Runs on the command thread.
+  void disconnect() {
+    for (auto& kv : video)
+      kv.second->disconnect();
+    for (auto& kv : audio)
+      kv.second->disconnect();
+    for (auto& kv : packet)
+      kv.second->disconnect();
+    video.clear();
+    audio.clear();
+    packet.clear();
+  }
+};
+
+static ObsTaps takeTaps() {
+  ObsTaps taps;
+  taps.video.swap(video_taps);
+  taps.audio.swap(audio_taps);
+  taps.packet.swap(packet_taps);
+  return taps;
+}
+
+// Latency tracing
+// While a trace runs, every frame is timestamped at each stage of the
+// pipeline that libobs exposes and the age of the frame (now minus its
+// video timestamp) goes into one histogram per stage:
+//   render      the main render callback of the frame
+//   output      the converted frame leaving video-io, where encoders take it
+//   packet      its encoded packet leaving the encoder
+//   interleave  that packet handed to an audio/video output after interleaving
+// Ages are cumulative, so the difference between two stages is the time
+// spent between them. The packet stages need encoders and observe them
+// through two internal outputs (video only and interleaved), which keep the
+// encoders running while the trace does. Samples land in fixed log-scale
+// buckets with relaxed atomic adds, so recording never locks and reading
+// never waits. No callback is installed while tracing is off.
+//
+// JS: startLatencyTrace({ encoders }) -> Promise<{ stop() }>
+//     getLatencyHistogram({ reset }) -> { tracing, render, output, packet, interleave }
+//     stage: { count, meanMs, maxMs, p50Ms, p90Ms, p99Ms, buckets: [{ upToMs, count }] }
+#define LATENCY_TRACE_PACKET_ID ("obsapi_latency_packet")
+#define LATENCY_TRACE_INTERLEAVE_ID ("obsapi_latency_interleave")
+#define LATENCY_BUCKETS_PER_OCTAVE 4
+#define LATENCY_BUCKETS (LATENCY_BUCKETS_PER_OCTAVE * 26)
+
+enum ObsLatencyStage {
+  LATENCY_RENDER,
+  LATENCY_OUTPUT,
+  LATENCY_PACKET,
+  LATENCY_INTERLEAVE,
+  LATENCY_STAGES
+};
+
+static const char* LATENCY_STAGE_NAMES[LATENCY_STAGES] = {
+  "render", "output", "packet", "interleave"
+};
+
+// Bucket i counts ages below 2^((i + 1) / 4) microseconds, up to about 67 s.
+struct ObsLatencyHistogram {
+  std::atomic<uint64_t> buckets[LATENCY_BUCKETS];
+  std::atomic<uint64_t> count;
+  std::atomic<uint64_t> sum_us;
+  std::atomic<uint64_t> max_us;
+
+  static size_t bucket(uint64_t us) {
+    return std::min((size_t)(std::log2((double)us + 1.0) * LATENCY_BUCKETS_PER_OCTAVE),
+        (size_t)LATENCY_BUCKETS - 1);
+  }
+
+  static double bucketUpperMs(size_t index) {
+    return std::exp2((double)(index + 1) / LATENCY_BUCKETS_PER_OCTAVE) / 1000.0;
+  }
+
+  void record(uint64_t us) {
+    buckets[bucket(us)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sum_us.fetch_add(us, std::memory_order_relaxed);
+    uint64_t max = max_us.load(std::memory_order_relaxed);
+    while (us > max && !max_us.compare_exchange_weak(max, us, std::memory_order_relaxed)) { }
+  }
+
+  // Records the age of a frame with the given video timestamp.
+  void recordSince(uint64_t timestamp_ns) {
+    uint64_t now = os_gettime_ns();
+    record(now > timestamp_ns ? (now - timestamp_ns) / 1000 : 0);
+  }
+
+  void reset() {
+    for (std::atomic<uint64_t>& bucket : buckets)
+      bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    sum_us.store(0, std::memory_order_relaxed);
+    max_us.store(0, std::memory_order_relaxed);
+  }
+};
+
+// Static storage, so every counter starts at zero.
+static ObsLatencyHistogram latency_histograms[LATENCY_STAGES];
+static std::atomic<bool> latency_tracing{false};
+
+static void latencyRender(void*, uint32_t, uint32_t) {
+  latency_histograms[LATENCY_RENDER].recordSince(obs_get_video_frame_time());
+}
+
+static void latencyRawVideo(void*, struct video_data* frame) {
+  latency_histograms[LATENCY_OUTPUT].recordSince(frame->timestamp);
+}
+
+// Video timestamp of the frame a packet encodes: the system DTS moved to the
+// presentation time.
+static uint64_t packetFrameTime(const struct encoder_packet* packet) {
+  int64_t offset_us = packet->timebase_den ?
+      (packet->pts - packet->dts) * 1000000 * packet->timebase_num / packet->timebase_den : 0;
+  return (uint64_t)std::max((int64_t)0, packet->sys_dts_usec + offset_us) * 1000;
+}
+
+// Plugin data of the two trace outputs.
+struct ObsLatencyTraceOutput {
+  obs_output_t* output = nullptr;
+  ObsLatencyStage stage;
+  uint32_t flags;
+};
+
+static const char* latencyTraceGetName(void*) {
+  return "obsapi latency trace";
+}
+
+static void* latencyTracePacketCreate(obs_data_t*, obs_output_t* output) {
+  return new ObsLatencyTraceOutput{ output, LATENCY_PACKET, OBS_OUTPUT_VIDEO };
+}
+
+static void* latencyTraceInterleaveCreate(obs_data_t*, obs_output_t* output) {
+  return new ObsLatencyTraceOutput{ output, LATENCY_INTERLEAVE, OBS_OUTPUT_AV };
+}
+
+static void latencyTraceDestroy(void* data) {
+  delete (ObsLatencyTraceOutput*)data;
+}
+
+static bool latencyTraceStart(void* data) {
+  ObsLatencyTraceOutput* trace = (ObsLatencyTraceOutput*)data;
+  if (!obs_output_can_begin_data_capture(trace->output, trace->flags) ||
+      !obs_output_initialize_encoders(trace->output, trace->flags))
+    return false;
+  return obs_output_begin_data_capture(trace->output, trace->flags);
+}
+
+static void latencyTraceStop(void* data, uint64_t) {
+  obs_output_end_data_capture(((ObsLatencyTraceOutput*)data)->output);
+}
+
+static void latencyTracePacket(void* data, struct encoder_packet* packet) {
+  if (packet && packet->type == OBS_ENCODER_VIDEO)
+    latency_histograms[((ObsLatencyTraceOutput*)data)->stage].recordSince(packetFrameTime(packet));
+}
+
+// Registers the trace output types once per OBS session.
+static void registerLatencyTraceOutputs() {
+  if (obs_output_get_display_name(LATENCY_TRACE_PACKET_ID))
+    return;
+
+  struct obs_output_info info = {};
+  info.get_name = latencyTraceGetName;
+  info.destroy = latencyTraceDestroy;
+  info.start = latencyTraceStart;
+  info.stop = latencyTraceStop;
+  info.encoded_packet = latencyTracePacket;
+
+  info.id = LATENCY_TRACE_PACKET_ID;
+  info.flags = OBS_OUTPUT_VIDEO | OBS_OUTPUT_ENCODED;
+  info.create = latencyTracePacketCreate;
+  obs_register_output(&info);
+
+  info.id = LATENCY_TRACE_INTERLEAVE_ID;
+  info.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED;
+  info.create = latencyTraceInterleaveCreate;
+  obs_register_output(&info);
+}
+
+struct ObsLatencyTrace {
+  std::shared_ptr<ObsEncoderContext> encoders;
+  obs_output_t* packet_output = nullptr;
+  obs_output_t* interleave_output = nullptr;
+
+  // Runs on the command thread.
+  static obs_output_t* startOutput(const char* id, obs_encoder_t* video, obs_encoder_t* audio) {
+    obs_output_t* output = obs_output_create(id, id, nullptr, nullptr);
+    if (!output)
+      return nullptr;
+    obs_output_set_video_encoder(output, video);
+    if (audio)
+      obs_output_set_audio_encoder(output, audio, 0);
+    if (!obs_output_start(output)) {
+      blog(LOG_WARNING, "obsapi: could not start latency trace output %s", id);
+      obs_output_release(output);
+      return nullptr;
+    }
+    return output;
+  }
+
+  // Runs on the command thread.
+  void start() {
+    obs_add_main_render_callback(latencyRender, nullptr);
+    obs_add_raw_video_callback(nullptr, latencyRawVideo, nullptr);
+
+    if (!encoders)
+      return;
+    encoders->rebind();
+    if (!encoders->video_encoder)
+      return;
+    registerLatencyTraceOutputs();
+    packet_output = startOutput(LATENCY_TRACE_PACKET_ID, encoders->video_encoder, nullptr);
+    if (encoders->audio_encoder)
+      interleave_output = startOutput(LATENCY_TRACE_INTERLEAVE_ID, encoders->video_encoder,
+          encoders->audio_encoder);
+  }
+
+  // Runs on the command thread.
+  void stop() {
+    obs_remove_main_render_callback(latencyRender, nullptr);
+    obs_remove_raw_video_callback(latencyRawVideo, nullptr);
+    for (obs_output_t** output : { &packet_output, &interleave_output }) {
+      if (*output) {
+        obs_output_stop(*output);
+        obs_output_release(*output);
+        *output = nullptr;
+      }
+    }
+    encoders.reset();
+  }
+};
+
+// The running trace, touched on the command thread only.
+static std::shared_ptr<ObsLatencyTrace> latency_trace;
+
+// What an internal output belongs to, for errors; nullptr for other outputs.
+static const char* internalOutputUser(obs_output_t* output) {
+  const char* id = obs_output_get_id(output);
+  if (!id)
+    return nullptr;
+  if (strcmp(id, PACKET_TAP_OUTPUT_ID) == 0)
+    return "a packet tap";
+  if (strcmp(id, LATENCY_TRACE_PACKET_ID) == 0 || strcmp(id, LATENCY_TRACE_INTERLEAVE_ID) == 0)
+    return "the latency trace";
+  return nullptr;
+}
+
+// Stops the running trace. Runs on the command thread.
+static void stopLatencyTrace() {
+  if (latency_trace)
+    latency_trace->stop();
+  latency_trace.reset();
+  latency_tracing = false;
+}
+
+// Asynchronously starts a latency trace, clearing the histograms.
+//
+class AsyncLatencyTraceWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    std::shared_ptr<ObsLatencyTrace> trace = std::make_shared<ObsLatencyTrace>();
+    Napi::Object options = info.Length() > 0 && info[0].IsObject() ?
+        info[0].As<Napi::Object>() : Napi::Object::New(env);
+    if (options.Has("encoders")) {
+      trace->encoders = ObsEncoders::FromValue(options.Get("encoders"));
+      if (!trace->encoders) {
+        Napi::TypeError::New(env, "Expected encoders from createEncoders()")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+      }
+    }
+
+    AsyncLatencyTraceWorker* worker = new AsyncLatencyTraceWorker(env, trace);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error)) {
+      SetError(error);
+      return;
+    }
+    if (latency_trace) {
+      SetError("Error: a latency trace is already running");
+      return;
+    }
+
+    for (ObsLatencyHistogram& histogram : latency_histograms)
+      histogram.reset();
+    trace->start();
+    latency_trace = trace;
+    latency_tracing = true;
+  }
+
+  virtual void OnOK() override {
+    Napi::Env env = Env();
+    std::weak_ptr<ObsLatencyTrace> stopped = trace;
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("stop", Napi::Function::New(env, [stopped](const Napi::CallbackInfo& info) {
+      ObsTaskWorker::Post(info.Env(), [stopped]() {
+        if (stopped.lock() == latency_trace)
+          stopLatencyTrace();
+      });
+      return info.Env().Undefined();
+    }, "stop"));
+    deferredPromise.Resolve(result);
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncLatencyTraceWorker(napi_env env, std::shared_ptr<ObsLatencyTrace>& trace) :
+    ObsCommandWorker(env),
+    trace(trace),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  std::shared_ptr<ObsLatencyTrace> trace;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+static Napi::Object latencyHistogramToJs(Napi::Env env, ObsLatencyHistogram& histogram) {
+  uint64_t counts[LATENCY_BUCKETS];
+  uint64_t total = 0;
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    counts[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  uint64_t sum_us = histogram.sum_us.load(std::memory_order_relaxed);
+
+  const double ranks[] = { 0.5, 0.9, 0.99 };
+  double percentiles[] = { 0, 0, 0 };
+  Napi::Array buckets = Napi::Array::New(env);
+  uint64_t seen = 0;
+  size_t next = 0;
+  for (size_t i = 0; i < LATENCY_BUCKETS; i++) {
+    if (!counts[i])
+      continue;
+    seen += counts[i];
+    while (next < 3 && seen >= (uint64_t)std::ceil(ranks[next] * total))
+      percentiles[next++] = ObsLatencyHistogram::bucketUpperMs(i);
+
+    Napi::Object bucket = Napi::Object::New(env);
+    bucket.Set("upToMs", Napi::Number::New(env, ObsLatencyHistogram::bucketUpperMs(i)));
+    bucket.Set("count", Napi::Number::New(env, (double)counts[i]));
+    buckets.Set(buckets.Length(), bucket);
+  }
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("count", Napi::Number::New(env, (double)total));
+  result.Set("meanMs", Napi::Number::New(env, total ? (double)sum_us / total / 1000.0 : 0));
+  result.Set("maxMs", Napi::Number::New(env,
+      (double)histogram.max_us.load(std::memory_order_relaxed) / 1000.0));
+  result.Set("p50Ms", Napi::Number::New(env, percentiles[0]));
+  result.Set("p90Ms", Napi::Number::New(env, percentiles[1]));
+  result.Set("p99Ms", Napi::Number::New(env, percentiles[2]));
+  result.Set("buckets", buckets);
+  return result;
+}
+
+// Reads the histograms directly on the JS thread; percentiles are bucket
+// upper bounds, so they are accurate to a quarter octave.
+Napi::Value obsGetLatencyHistogram(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  bool reset = info.Length() > 0 && info[0].IsObject() &&
+      info[0].As<Napi::Object>().Get("reset").ToBoolean();
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("tracing", Napi::Boolean::New(env, latency_tracing));
+  for (int stage = 0; stage < LATENCY_STAGES; stage++) {
+    result.Set(LATENCY_STAGE_NAMES[stage], latencyHistogramToJs(env, latency_histograms[stage]));
+    if (reset)
+      latency_histograms[stage].reset();
+  }
+  return result;
+}
+
+// Memory stats
+// One snapshot of where memory goes, read directly on the JS thread:
+// libobs' own allocation count (bnum_allocs), the process footprint, the
+// packets buffered per output (replay buffers, through their meter) and per
+// packet tap (queued, and delivered but not yet collected by JS), and the
+// fixed rings of the video and audio taps. Objects counts the encoders,
+// outputs, services, sources and scenes alive in libobs, so a count that
+// keeps growing over a session points at a missed release.
+//
+// With initialize({ debugObjects: true }) the snapshot also names those
+// objects, and shutdown() reports as leaked whatever is still alive after
+// the addon released everything it holds.
+//
+// JS: getMemoryStats() -> { allocs, residentBytes, virtualBytes, systemFreeBytes,
+//       objects: { encoders, outputs, services, sources, scenes },
+//       names?: { encoders: [name], ... },
+//       outputs: [{ name, bufferedBytes }],
+//       packetTaps: [{ pendingPackets, pendingBytes }], packetTapHeldBytes,
+//       videoTaps: [{ slots, slotBytes, free, writing, ready }],
+//       audioTaps: [{ mix, pcmFrames, pcmFilledFrames, pcmBytes }] }
+enum ObsObjectKind {
+  OBJECT_ENCODER,
+  OBJECT_OUTPUT,
+  OBJECT_SERVICE,
+  OBJECT_SOURCE,
+  OBJECT_SCENE,
+  OBJECT_KINDS
+};
+
+static const char* OBJECT_KIND_NAMES[OBJECT_KINDS] = {
+  "encoders", "outputs", "services", "sources", "scenes"
+};
+
+// Names of the objects alive in libobs, per kind.
+struct ObsLiveObjects {
+  std::vector<std::string> names[OBJECT_KINDS];
+};
+
+static void addLiveObject(void* data, ObsObjectKind kind, const char* name) {
+  ((ObsLiveObjects*)data)->names[kind].push_back(name ? name : "");
+}
+
+static ObsLiveObjects liveObjects() {
+  ObsLiveObjects live;
+  obs_enum_encoders([](void* data, obs_encoder_t* encoder) {
+    addLiveObject(data, OBJECT_ENCODER, obs_encoder_get_name(encoder));
+    return true;
+  }, &live);
+  obs_enum_outputs([](void* data, obs_output_t* output) {
+    addLiveObject(data, OBJECT_OUTPUT, obs_output_get_name(output));
+    return true;
+  }, &live);
+  obs_enum_services([](void* data, obs_service_t* service) {
+    addLiveObject(data, OBJECT_SERVICE, obs_service_get_name(service));
+    return true;
+  }, &live);
+  obs_enum_sources([](void* data, obs_source_t* source) {
+    addLiveObject(data, OBJECT_SOURCE, obs_source_get_name(source));
+    return true;
+  }, &live);
+  obs_enum_scenes([](void* data, obs_source_t* scene) {
+    addLiveObject(data, OBJECT_SCENE, obs_source_get_name(scene));
+    return true;
+  }, &live);
+  return live;
+}
+
+static Napi::Object liveNamesToJs(Napi::Env env, const ObsLiveObjects& live) {
+  Napi::Object result = Napi::Object::New(env);
+  for (int kind = 0; kind < OBJECT_KINDS; kind++) {
+    Napi::Array names = Napi::Array::New(env, live.names[kind].size());
+    for (size_t i = 0; i < live.names[kind].size(); i++)
+      names.Set(i, Napi::String::New(env, live.names[kind][i]));
+    result.Set(OBJECT_KIND_NAMES[kind], names);
+  }
+  return result;
+}
+
+Napi::Value obsGetMemoryStats(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!initReady()) {
+    Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  os_proc_memory_usage_t usage = {};
+  os_get_proc_memory_usage(&usage);
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("allocs", Napi::Number::New(env, (double)bnum_allocs()));
+  result.Set("residentBytes", Napi::Number::New(env, (double)usage.resident_size));
+  result.Set("virtualBytes", Napi::Number::New(env, (double)usage.virtual_size));
+  result.Set("systemFreeBytes", Napi::Number::New(env, (double)os_get_sys_free_size()));
+
+  ObsLiveObjects live = liveObjects();
+  Napi::Object objects = Napi::Object::New(env);
+  for (int kind = 0; kind < OBJECT_KINDS; kind++)
+    objects.Set(OBJECT_KIND_NAMES[kind], Napi::Number::New(env, (double)live.names[kind].size()));
+  result.Set("objects", objects);
+  if (debug_objects)
+    result.Set("names", liveNamesToJs(env, live));
+
+  Napi::Array outputs = Napi::Array::New(env);
+  {
+    std::lock_guard<std::mutex> lock(output_registry_mutex);
+    for (ObsOutputContext* context : output_registry) {
+      Napi::Object item = Napi::Object::New(env);
+      item.Set("name", Napi::String::New(env, obs_output_get_name(context->output)));
+      item.Set("bufferedBytes", Napi::Number::New(env,
+          context->meter ? (double)context->meter->bytes.load() : 0));
+      outputs.Set(outputs.Length(), item);
+    }
+  }
+  result.Set("outputs", outputs);
+
+  Napi::Array packet_tap_stats = Napi::Array::New(env);
+  for (auto& kv : packet_taps) {
+    size_t pending_packets = 0;
+    uint64_t pending_bytes = 0;
+    kv.second->pendingUsage(pending_packets, pending_bytes);
+    Napi::Object item = Napi::Object::New(env);
+    item.Set("pendingPackets", Napi::Number::New(env, (double)pending_packets));
+    item.Set("pendingBytes", Napi::Number::New(env, (double)pending_bytes));
+    packet_tap_stats.Set(packet_tap_stats.Length(), item);
+  }
+  result.Set("packetTaps", packet_tap_stats);
+  result.Set("packetTapHeldBytes", Napi::Number::New(env, (double)packet_tap_held_bytes.load()));
+
+  Napi::Array video_tap_stats = Napi::Array::New(env);
+  for (auto& kv : video_taps) {
+    const ObsVideoTap& tap = *kv.second;
+    Napi::Object item = Napi::Object::New(env);
+    item.Set("slots", Napi::Number::New(env, (double)tap.slots.size()));
+    item.Set("slotBytes", Napi::Number::New(env, (double)tap.slot_size));
+    item.Set("free", Napi::Number::New(env, (double)tap.count(ObsSlotState::FREE)));
+    item.Set("writing", Napi::Number::New(env, (double)tap.count(ObsSlotState::WRITING)));
+    item.Set("ready", Napi::Number::New(env, (double)tap.count(ObsSlotState::READY)));
+    video_tap_stats.Set(video_tap_stats.Length(), item);
+  }
+  result.Set("videoTaps", video_tap_stats);
+
+  Napi::Array audio_tap_stats = Napi::Array::New(env);
+  for (auto& kv : audio_taps) {
+    const ObsAudioTap& tap = *kv.second;
+    uint32_t written = tap.pcm_position ? tap.pcm_position->load() : 0;
+    Napi::Object item = Napi::Object::New(env);
+    item.Set("mix", Napi::Number::New(env, (double)tap.mix));
+    item.Set("pcmFrames", Napi::Number::New(env, tap.pcm_frames));
+    item.Set("pcmFilledFrames", Napi::Number::New(env, std::min(written, tap.pcm_frames)));
+    item.Set("pcmBytes", Napi::Number::New(env,
+        (double)tap.pcm_frames * tap.pcm.size() * sizeof(float)));
+    audio_tap_stats.Set(audio_tap_stats.Length(), item);
+  }
+  result.Set("audioTaps", audio_tap_stats);
+  return result;
+}
+
+// Preview display
+// A display renders the main texture into a native child surface of the
+// Electron window: a child HWND on Windows, a subview of the content view on
+// macOS and a child X11 window on Linux. Frames never leave the GPU. The
+// surface is created, moved and destroyed on the JS thread, which is the UI
+// thread of the main process; the obs_display itself lives on the command
+// thread. A tick callback enables the display only on the frames that a
+// target fps keeps, so a slower preview also renders less.
+//
+// Bounds are in the parent's native coordinates (points on macOS, pixels
+// elsewhere); scaleFactor converts them to backbuffer pixels.
+//
+// JS: createDisplay(win.getNativeWindowHandle(),
+//                   { x, y, width, height, scaleFactor, fps }) -> Promise<Display>
+//     display.setBounds({ x, y, width, height, scaleFactor })
+//     display.setFps(fps)                        0 renders every frame
+//     display.destroy() -> Promise
+struct ObsDisplayBounds {
+  int32_t x = 0;
+  int32_t y = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  double scale_factor = 1.0;
+
+  uint32_t pixelWidth() const { return (uint32_t)std::lround(width * scale_factor); }
+  uint32_t pixelHeight() const { return (uint32_t)std::lround(height * scale_factor); }
+};
+
+static bool getInt(const Napi::Object& obj, const char* key, int32_t& out) {
+  if (!obj.Has(key))
+    return true;
+
+  Napi::Value value = obj.Get(key);
+  if (!value.IsNumber())
+    return false;
+
+  out = value.As<Napi::Number>().Int32Value();
+  return true;
+}
+
+static bool parseDisplayBounds(const Napi::Object& options, ObsDisplayBounds& bounds) {
+  return getInt(options, "x", bounds.x) &&
+      getInt(options, "y", bounds.y) &&
+      getUint(options, "width", bounds.width) &&
+      getUint(options, "height", bounds.height) &&
+      getNumber(options, "scaleFactor", 0.1, 16, bounds.scale_factor) &&
+      bounds.width && bounds.height;
+}
+
+#if defined(__APPLE__)
+static id objcSend(id object, const char* selector) {
+  return ((id (*)(id, SEL))objc_msgSend)(object, sel_registerName(selector));
+}
+#endif
+
+// Child surface of the Electron window that a display renders into.
+class ObsNativeSurface {
+public:
+  // parent is the buffer from getNativeWindowHandle().
+  bool create(const uint8_t* parent, size_t size, const ObsDisplayBounds& bounds) {
+    uintptr_t handle = 0;
+    memcpy(&handle, parent, std::min(size, sizeof(handle)));
+    if (!handle)
+      return false;
+
+#if defined(_WIN32)
+    hwnd = CreateWindowExW(0, L"STATIC", nullptr,
+        WS_CHILD | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN | WS_DISABLED,
+        bounds.x, bounds.y, bounds.width, bounds.height, (HWND)handle, nullptr,
+        GetModuleHandleW(nullptr), nullptr);
+    return hwnd != nullptr;
+#elif defined(__APPLE__)
+    // The Chromium content view is flipped, so frames are top-left based as on
+    // the other platforms.
+    view = objcSend((id)objc_getClass("NSView"), "alloc");
+    view = ((id (*)(id, SEL, CGRect))objc_msgSend)(view, sel_registerName("initWithFrame:"),
+        CGRectMake(bounds.x, bounds.y, bounds.width, bounds.height));
+    if (!view)
+      return false;
+    ((void (*)(id, SEL, id))objc_msgSend)((id)handle, sel_registerName("addSubview:"), view);
+    return true;
+#elif defined(__linux__)
+    x_display = XOpenDisplay(nullptr);
+    if (!x_display)
+      return false;
+    x_window = XCreateSimpleWindow(x_display, (Window)handle, bounds.x, bounds.y,
+        bounds.width, bounds.height, 0, 0, 0);
+    XMapWindow(x_display, x_window);
+    XFlush(x_display);
+    return x_window != 0;
+#else
+    return false;
+#endif
+  }
+
+  void setBounds(const ObsDisplayBounds& bounds) {
+#if defined(_WIN32)
+    if (hwnd)
+      SetWindowPos(hwnd, nullptr, bounds.x, bounds.y, bounds.width, bounds.height,
+          SWP_NOZORDER | SWP_NOACTIVATE);
+#elif defined(__APPLE__)
+    if (view)
+      ((void (*)(id, SEL, CGRect))objc_msgSend)(view, sel_registerName("setFrame:"),
+          CGRectMake(bounds.x, bounds.y, bounds.width, bounds.height));
+#elif defined(__linux__)
+    if (x_window) {
+      XMoveResizeWindow(x_display, x_window, bounds.x, bounds.y, bounds.width, bounds.height);
+      XFlush(x_display);
+    }
+#endif
+  }
+
+  void fill(struct gs_window& window) const {
+#if defined(_WIN32)
+    window.hwnd = hwnd;
+#elif defined(__APPLE__)
+    window.view = view;
+#elif defined(__linux__)
+    window.id = (uint32_t)x_window;
+    window.display = x_display;
+#endif
+  }
+
+  void destroy() {
+#if defined(_WIN32)
+    if (hwnd)
+      DestroyWindow(hwnd);
+    hwnd = nullptr;
+#elif defined(__APPLE__)
+    if (view) {
+      objcSend(view, "removeFromSuperview");
+      objcSend(view, "release");
+    }
+    view = nullptr;
+#elif defined(__linux__)
+    if (x_window)
+      XDestroyWindow(x_display, x_window);
+    if (x_display)
+      XCloseDisplay(x_display);
+    x_window = 0;
+    x_display = nullptr;
+#endif
+  }
+
+private:
+#if defined(_WIN32)
+  HWND hwnd = nullptr;
+#elif defined(__APPLE__)
+  id view = nullptr;
+#elif defined(__linux__)
+  Display* x_display = nullptr;
+  Window x_window = 0;
+#endif
+};
+
+struct ObsDisplayContext {
+  ObsNativeSurface surface;
+  ObsDisplayBounds bounds;
+  obs_display_t* display = nullptr;
+  std::atomic<uint32_t> fps{0};
+  uint64_t next_ns = 0;
+
+  // Draws the base canvas letterboxed into the display. Runs on the graphics thread.
+  static void draw(void*, uint32_t cx, uint32_t cy) {
+    struct obs_video_info ovi;
+    if (!obs_get_video_info(&ovi) || !ovi.base_width || !ovi.base_height)
+      return;
+
+    double scale = std::min((double)cx / ovi.base_width, (double)cy / ovi.base_height);
+    int width = (int)(ovi.base_width * scale);
+    int height = (int)(ovi.base_height * scale);
+
+    gs_viewport_push();
+    gs_projection_push();
+    gs_ortho(0.0f, (float)ovi.base_width, 0.0f, (float)ovi.base_height, -100.0f, 100.0f);
+    gs_set_viewport(((int)cx - width) / 2, ((int)cy - height) / 2, width, height);
+    obs_render_main_texture();
+    gs_projection_pop();
+    gs_viewport_pop();
+  }
+
+  // Enables the display for the frames the target fps keeps. Runs on the
+  // graphics thread before displays render.
+  static void pace(void* data, float) {
+    ObsDisplayContext* ctx = (ObsDisplayContext*)data;
+    uint32_t fps = ctx->fps;
+    if (!fps) {
+      obs_display_set_enabled(ctx->display, true);
+      return;
+    }
+
+    uint64_t interval_ns = 1000000000ULL / fps;
+    uint64_t now_ns = os_gettime_ns();
+    bool due = now_ns + interval_ns / 4 >= ctx->next_ns;
+    if (due)
+      ctx->next_ns = now_ns > ctx->next_ns + interval_ns ? now_ns + interval_ns :
+          ctx->next_ns + interval_ns;
+    obs_display_set_enabled(ctx->display, due);
+  }
+
+  // Runs on the command thread.
+  void destroyDisplay() {
+    if (!display)
+      return;
+    obs_remove_tick_callback(pace, this);
+    obs_display_remove_draw_callback(display, draw, this);
+    obs_display_destroy(display);
+    display = nullptr;
+  }
+};
+
+// Live displays, touched on the command thread only.
+static std::set<std::shared_ptr<ObsDisplayContext>> displays;
+
+// Destroys every obs_display. Runs on the command thread.
+static void stopDisplays() {
+  for (const std::shared_ptr<ObsDisplayContext>& context : displays)
+    context->destroyDisplay();
+  displays.clear();
+}
+
+// Handle to a preview display.
+class ObsDisplay : public Napi::ObjectWrap<ObsDisplay> {
+public:
+  static void Init(Napi::Env env, Napi::Object exports) {
+    Napi::Function func = DefineClass(env, "Display", {
+      InstanceMethod("setBounds", &ObsDisplay::SetBounds),
+      InstanceMethod("setFps", &ObsDisplay::SetFps),
+      InstanceMethod("destroy", &ObsDisplay::Destroy),
+    });
+
+    constructor = Napi::Persistent(func);
+    constructor.SuppressDestruct();
+
+    exports.Set("Display", func);
+  }
+
+  static Napi::Object NewInstance(Napi::Env env, std::shared_ptr<ObsDisplayContext>& context) {
+    return constructor.New({ Napi::External<std::shared_ptr<ObsDisplayContext>>::New(env, &context) });
+  }
+
+  ObsDisplay(const Napi::CallbackInfo& info) : Napi::ObjectWrap<ObsDisplay>(info) {
+    if (info.Length() != 1 || !info[0].IsExternal()) {
+      Napi::TypeError::New(info.Env(), "Use createDisplay() to create a display")
+          .ThrowAsJavaScriptException();
+      return;
+    }
+
+    context = *info[0].As<Napi::External<std::shared_ptr<ObsDisplayContext>>>().Data();
+  }
+
+  ~ObsDisplay();
+
+private:
+  static Napi::FunctionReference constructor;
+
+  Napi::Value SetBounds(const Napi::CallbackInfo& info);
+  Napi::Value SetFps(const Napi::CallbackInfo& info);
+  Napi::Value Destroy(const Napi::CallbackInfo& info);
+
+  std::shared_ptr<ObsDisplayContext> context;
+};
+
+Napi::FunctionReference ObsDisplay::constructor;
+
+// Asynchronously creates or destroys the obs_display of a display. The native
+// surface is destroyed back on the JS thread once the display is gone.
+//
+class AsyncDisplayWorker : public ObsCommandWorker {
+public:
+  enum class Op { CREATE, DESTROY };
+
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    std::shared_ptr<ObsDisplayContext> context = std::make_shared<ObsDisplayContext>();
+    double fps = 0;
+    if (info.Length() != 2 || !info[0].IsBuffer() || !info[1].IsObject() ||
+        !parseDisplayBounds(info[1].As<Napi::Object>(), context->bounds) ||
+        !getNumber(info[1].As<Napi::Object>(), "fps", 0, 240, fps)) {
+      Napi::TypeError::New(env, "Expected a native window handle and display bounds")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    context->fps = (uint32_t)fps;
+
+    Napi::Buffer<uint8_t> handle = info[0].As<Napi::Buffer<uint8_t>>();
+    if (!context->surface.create(handle.Data(), handle.Length(), context->bounds)) {
+      Napi::TypeError::New(env, "Error: could not create a native surface for the display")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    return Schedule(env, context, Op::CREATE);
+  }
+
+  static Napi::Value Schedule(Napi::Env env, std::shared_ptr<ObsDisplayContext>& context, Op op) {
+    AsyncDisplayWorker* worker = new AsyncDisplayWorker(env, context, op);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    if (op == Op::DESTROY) {
+      context->destroyDisplay();
+      displays.erase(context);
+      return;
+    }
+
+    std::string error;
+    if (!waitForReady(error)) {
+      SetError(error);
+      return;
+    }
+
+    struct gs_init_data init = {};
+    init.cx = context->bounds.pixelWidth();
+    init.cy = context->bounds.pixelHeight();
+    init.format = GS_BGRA;
+    init.zsformat = GS_ZS_NONE;
+    context->surface.fill(init.window);
+
+    context->display = obs_display_create(&init, 0);
+    if (!context->display) {
+      SetError("Error: could not create display");
+      return;
+    }
+    obs_display_add_draw_callback(context->display, ObsDisplayContext::draw, context.get());
+    obs_add_tick_callback(ObsDisplayContext::pace, context.get());
+    displays.insert(context);
+  }
+
+  virtual void OnOK() override {
+    if (op == Op::DESTROY) {
+      context->surface.destroy();
+      deferredPromise.Resolve(Env().Undefined());
+    } else {
+      deferredPromise.Resolve(ObsDisplay::NewInstance(Env(), context));
+    }
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    context->surface.destroy();
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncDisplayWorker(napi_env env, std::shared_ptr<ObsDisplayContext>& context, Op op) :
+    ObsCommandWorker(env),
+    context(context),
+    op(op),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
+
+  std::shared_ptr<ObsDisplayContext> context;
+  Op op;
+  Napi::Promise::Deferred deferredPromise;
+};
+
+// Runs from a GC finalizer, where no JS values can be created, so the display
+// is destroyed by a task instead of a command with a promise. The queue only
+// stops after every obs_display is destroyed, so the surface can go then.
+ObsDisplay::~ObsDisplay() {
+  if (!context)
+    return;
+  std::shared_ptr<ObsDisplayContext> destroyed;
+  destroyed.swap(context);
+  ObsTaskWorker::Post(Env(), [destroyed]() {
+    destroyed->destroyDisplay();
+    displays.erase(destroyed);
+  }, ObsPriority::NORMAL, [destroyed]() { destroyed->surface.destroy(); });
+}
+
+Napi::Value ObsDisplay::SetBounds(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  ObsDisplayBounds bounds;
+  if (!context || info.Length() != 1 || !info[0].IsObject() ||
+      !parseDisplayBounds(info[0].As<Napi::Object>(), bounds)) {
+    Napi::TypeError::New(env, "Expected display bounds")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  context->bounds = bounds;
+  context->surface.setBounds(bounds);
+
+  std::shared_ptr<ObsDisplayContext> resized = context;
+  ObsTaskWorker::Post(env, [resized, bounds]() {
+    if (resized->display)
+      obs_display_resize(resized->display, bounds.pixelWidth(), bounds.pixelHeight());
+  });
+  return env.Undefined();
+}
+
+Napi::Value ObsDisplay::SetFps(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!context || info.Length() != 1 || !info[0].IsNumber() ||
+      info[0].As<Napi::Number>().DoubleValue() < 0) {
+    Napi::TypeError::New(env, "Expected a frame rate")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  context->fps = info[0].As<Napi::Number>().Uint32Value();
+  return env.Undefined();
+}
+
+Napi::Value ObsDisplay::Destroy(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  if (!context) {
+    Napi::TypeError::New(env, "Error: display has been destroyed")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::shared_ptr<ObsDisplayContext> destroyed;
+  destroyed.swap(context);
+  return AsyncDisplayWorker::Schedule(env, destroyed, AsyncDisplayWorker::Op::DESTROY);
+}
+
+// Scene graph
+// Scenes and sources are addressed by name, scene items by the id that
+// obs_sceneitem_get_id() gives them. Changes are sent as a batch of ops that
+// crosses into native code once and runs on the command thread. The whole
+// batch is validated against the graph before anything is applied. Sources
+// are created and updated first. The layout ops (items, transforms,
+// visibility, order, removals, program) are then applied while holding the
+// graphics context, so no frame renders with half of them applied. Source
+// settings go through libobs' deferred update and land on the next video tick.
+//
+// JS: applyBatch([op]) -> Promise<[result]>
+//   { op: 'createScene', name }                                     -> name
+//   { op: 'createSource', name, id, settings }                      -> name
+//   { op: 'updateSource', name, settings }
+//   { op: 'removeSource', name }                   (scenes included)
+//   { op: 'addItem', scene, source, visible }                       -> item id
+//   { op: 'setTransform', scene, item, pos: { x, y }, scale: { x, y },
+//     rotation, alignment, crop: { left, top, right, bottom } }
+//   { op: 'setVisible', scene, item, visible }
+//   { op: 'setOrder', scene, item, order }         ('up', 'down', 'top', 'bottom')
+//   { op: 'removeItem', scene, item }
+//   { op: 'setProgram', source }                   (renders it on output channel 0)
+//     createScene(name), createSource({ name, id, settings }) and
+//     addSceneItem(scene, source) are one-op batches.
+//     getSceneItems(scene) -> Promise<[{ id, source, visible, pos, scale, rotation }]>
+//
+// Ops before a failing one stay applied; validation catches unknown names,
+// items and source ids before the batch starts.
+enum class ObsGraphOpType {
+  CREATE_SCENE, CREATE_SOURCE, UPDATE_SOURCE, REMOVE_SOURCE,
+  ADD_ITEM, SET_TRANSFORM, SET_VISIBLE, SET_ORDER, REMOVE_ITEM, SET_PROGRAM
+};
+
+static const ObsEnumName<ObsGraphOpType> GRAPH_OP_NAMES[] = {
+  { "createScene", ObsGraphOpType::CREATE_SCENE },
+  { "createSource", ObsGraphOpType::CREATE_SOURCE },
+  { "updateSource", ObsGraphOpType::UPDATE_SOURCE },
+  { "removeSource", ObsGraphOpType::REMOVE_SOURCE },
+  { "addItem", ObsGraphOpType::ADD_ITEM },
+  { "setTransform", ObsGraphOpType::SET_TRANSFORM },
+  { "setVisible", ObsGraphOpType::SET_VISIBLE },
+  { "setOrder", ObsGraphOpType::SET_ORDER },
+  { "removeItem", ObsGraphOpType::REMOVE_ITEM },
+  { "setProgram", ObsGraphOpType::SET_PROGRAM },
+};
+
+static const ObsEnumName<enum obs_order_movement> ORDER_NAMES[] = {
+  { "up", OBS_ORDER_MOVE_UP },
+  { "down", OBS_ORDER_MOVE_DOWN },
+  { "top", OBS_ORDER_MOVE_TOP },
+  { "bottom", OBS_ORDER_MOVE_BOTTOM },
+};
+
+struct ObsGraphOp {
+  ObsGraphOpType type = ObsGraphOpType::CREATE_SCENE;
+  std::string name;
+  std::string id;
+  std::string settings;
+  std::string scene;
+  std::string source;
+  int64_t item = 0;
+  bool visible = true;
+  bool has_pos = false;
+  struct vec2 pos = {};
+  bool has_scale = false;
+  struct vec2 scale = {};
+  bool has_rotation = false;
+  double rotation = 0;
+  bool has_alignment = false;
+  uint32_t alignment = 0;
+  bool has_crop = false;
+  struct obs_sceneitem_crop crop = {};
+  enum obs_order_movement order = OBS_ORDER_MOVE_UP;
+};
+
+// Result of one op: a name, an item id, or nothing.
+struct ObsGraphResult {
+  std::string name;
+  int64_t item = -1;
+};
+
+// Sources of the graph by name. Touched on the command thread only; every
+// entry holds a reference.
+static std::map<std::string, obs_source_t*> graph_sources;
+
+// Releases the graph and clears the program. Runs on the command thread.
+static void clearSceneGraph() {
+  obs_set_output_source(0, nullptr);
+  for (auto& kv : graph_sources)
+    obs_source_release(kv.second);
+  graph_sources.clear();
+}
+
+static bool getVec2(const Napi::Object& obj, const char* key, bool& has, struct vec2& out) {
+  if (!obj.Has(key))
+    return true;
+
+  Napi::Value value = obj.Get(key);
+  if (!value.IsObject())
+    return false;
+
+  double x = 0, y = 0;
+  Napi::Object vec = value.As<Napi::Object>();
+  if (!getNumber(vec, "x", -1e7, 1e7, x) || !getNumber(vec, "y", -1e7, 1e7, y))
+    return false;
+
+  vec2_set(&out, (float)x, (float)y);
+  has = true;
+  return true;
+}
+
+static bool getCrop(const Napi::Object& obj, bool& has, struct obs_sceneitem_crop& out) {
+  if (!obj.Has("crop"))
+    return true;
+
+  Napi::Value value = obj.Get("crop");
+  if (!value.IsObject())
+    return false;
+
+  double left = 0, top = 0, right = 0, bottom = 0;
+  Napi::Object crop = value.As<Napi::Object>();
+  if (!getNumber(crop, "left", 0, 1e5, left) || !getNumber(crop, "top", 0, 1e5, top) ||
+      !getNumber(crop, "right", 0, 1e5, right) || !getNumber(crop, "bottom", 0, 1e5, bottom))
+    return false;
+
+  out.left = (int)left;
+  out.top = (int)top;
+  out.right = (int)right;
+  out.bottom = (int)bottom;
+  has = true;
+  return true;
+}
+
+static bool parseGraphOp(Napi::Env env, const Napi::Object& obj, ObsGraphOp& op) {
+  if (!obj.Has("op") || !getEnum(obj, "op", GRAPH_OP_NAMES, op.type))
+    return false;
+
+  double item = 0, rotation = 0, alignment = 0;
+  if (!getString(obj, "name", op.name) ||
+      !getString(obj, "id", op.id) ||
+      !getSettingsJson(env, obj, op.settings) ||
+      !getString(obj, "scene", op.scene) ||
+      !getString(obj, "source", op.source) ||
+      !getNumber(obj, "item", 0, 9007199254740991.0, item) ||
+      !getVec2(obj, "pos", op.has_pos, op.pos) ||
+      !getVec2(obj, "scale", op.has_scale, op.scale) ||
+      !getNumber(obj, "rotation", -36000, 36000, rotation) ||
+      !getNumber(obj, "alignment", 0, 255, alignment) ||
+      !getCrop(obj, op.has_crop, op.crop) ||
+      !getEnum(obj, "order", ORDER_NAMES, op.order))
+    return false;
+
+  op.item = (int64_t)item;
+  op.has_rotation = obj.Has("rotation");
+  op.rotation = rotation;
+  op.has_alignment = obj.Has("alignment");
+  op.alignment = (uint32_t)alignment;
+  if (obj.Has("visible"))
+    op.visible = obj.Get("visible").ToBoolean();
+
+  switch (op.type) {
+  case ObsGraphOpType::CREATE_SCENE:
+  case ObsGraphOpType::UPDATE_SOURCE:
+  case ObsGraphOpType::REMOVE_SOURCE:
+    return !op.name.empty();
+  case ObsGraphOpType::CREATE_SOURCE:
+    return !op.name.empty() && !op.id.empty();
+  case ObsGraphOpType::ADD_ITEM:
+    return !op.scene.empty() && !op.source.empty();
+  case ObsGraphOpType::SET_PROGRAM:
+    return !op.source.empty();
+  default:
+    return !op.scene.empty() && obj.Has("item");
+  }
+}
+
+// Applies a batch of graph ops on the command thread.
+//
+class AsyncApplyBatchWorker : public ObsCommandWorker {
+public:
+  static Napi::Value Create(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() != 1 || !info[0].IsArray()) {
+      Napi::TypeError::New(env, "Expected an array of scene graph ops")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    Napi::Array array = info[0].As<Napi::Array>();
+    std::vector<ObsGraphOp> ops(array.Length());
+    for (uint32_t i = 0; i < array.Length(); i++) {
+      if (!array.Get(i).IsObject() || !parseGraphOp(env, array.Get(i).As<Napi::Object>(), ops[i])) {
+        Napi::TypeError::New(env, "Invalid scene graph op " + std::to_string(i))
+            .ThrowAsJavaScriptException();
+        return env.Null();
+      }
+    }
+
+    return Schedule(env, ops);
+  }
+
+  static Napi::Value Schedule(Napi::Env env, std::vector<ObsGraphOp>& ops) {
+    if (!initRequested()) {
+      Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+
+    AsyncApplyBatchWorker* worker = new AsyncApplyBatchWorker(env, ops);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
+
+protected:
+  void Execute() override {
+    std::string error;
+    if (!waitForReady(error) || !validate(error)) {
+      SetError(error);
+      return;
+    }
+
+    results.resize(ops.size());
+    for (size_t i = 0; i < ops.size(); i++) {
+      if (isSourceOp(ops[i].type) && !apply(i, error)) {
+        SetError(error);
+        return;
+      }
+    }
+
+    obs_enter_graphics();
+    for (size_t i = 0; i < ops.size(); i++) {
+      if (!isSourceOp(ops[i].type) && !apply(i, error)) {
+        SetError(error);
+        break;
+      }
+    }
+    obs_leave_graphics();
+  }
+
+  virtual void OnOK() override {
+    Napi::Env env = Env();
+    Napi::Array array = Napi::Array::New(env, results.size());
+    for (size_t i = 0; i < results.size(); i++) {
+      if (results[i].item >= 0)
+        array.Set(i, Napi::Number::New(env, (double)results[i].item));
+      else if (!results[i].name.empty())
+        array.Set(i, Napi::String::New(env, results[i].name));
+      else
+        array.Set(i, env.Undefined());
+    }
+    deferredPromise.Resolve(array);
+  }
+
+  virtual void OnError(const Napi::Error& e) override {
+    deferredPromise.Reject(e.Value());
+  }
+
+private:
+  AsyncApplyBatchWorker(napi_env env, std::vector<ObsGraphOp>& ops) :
+    ObsCommandWorker(env),
+    ops(std::move(ops)),
+    deferredPromise(Napi::Promise::Deferred::New(env)) { }
 
-#define DEFAULT_AUDIO_SAMPLES 44100
-#define DEFAULT_AUDIO_CHANNELS SPEAKERS_STEREO
+  static bool isSourceOp(ObsGraphOpType type) {
+    return type == ObsGraphOpType::CREATE_SCENE || type == ObsGraphOpType::CREATE_SOURCE ||
+        type == ObsGraphOpType::UPDATE_SOURCE;
+  }
 
-#define NOT_INITIALIZED_STRING ("Error: OBS API not initialized!")
+  static std::string opError(size_t index, const std::string& message) {
+    return "Error: op " + std::to_string(index) + ": " + message;
+  }
 
-obs_video_info create_ovi(
-    size_t adapter = DEFAULT_VIDEO_ADAPTER,
-    const char* graphics_module = DEFAULT_MODULE,
-    const enum video_format output_format = DEFAULT_VIDEO_FORMAT,
-    size_t fps_num = DEFAULT_VIDEO_FPS_NUM,
-    size_t fps_den = DEFAULT_VIDEO_FPS_DEN,
-    size_t base_width = DEFAULT_VIDEO_WIDTH,
-    size_t base_height = DEFAULT_VIDEO_HEIGHT,
-    size_t output_width = DEFAULT_VIDEO_WIDTH,
-    size_t output_height = DEFAULT_VIDEO_HEIGHT
-    ) 
-{
-    struct obs_video_info ovi;
+  // Checks every op against the graph as it will be when the op runs.
+  // Sources created by the batch exist for all of it, since they are
+  // created before any layout op.
+  bool validate(std::string& error) {
+    std::map<std::string, bool> names;  // name -> is a scene, for live names
+    for (auto& kv : graph_sources)
+      names[kv.first] = obs_scene_from_source(kv.second) != nullptr;
+    for (const ObsGraphOp& op : ops)
+      if (op.type == ObsGraphOpType::CREATE_SCENE || op.type == ObsGraphOpType::CREATE_SOURCE)
+        names.emplace(op.name, op.type == ObsGraphOpType::CREATE_SCENE);
 
-    ovi.adapter = adapter;
-    ovi.graphics_module = graphics_module;
-    ovi.output_format = output_format;
-    ovi.fps_num = fps_num;
-    ovi.fps_den = fps_den;
-    ovi.base_width = base_width;
-    ovi.base_height = base_height;
-    ovi.output_width = output_width;
-    ovi.output_height = output_height;
+    std::set<std::string> created;
+    std::set<std::string> removed;
+    std::set<std::pair<std::string, int64_t>> removed_items;
+    for (size_t i = 0; i < ops.size(); i++) {
+      const ObsGraphOp& op = ops[i];
+      const std::string& target = op.type == ObsGraphOpType::ADD_ITEM ||
+          op.type == ObsGraphOpType::SET_PROGRAM ? op.source : op.name;
 
-    return ovi;
-}
+      switch (op.type) {
+      case ObsGraphOpType::CREATE_SOURCE:
+        if (!obs_source_get_display_name(op.id.c_str())) {
+          error = opError(i, "unknown source id " + op.id);
+          return false;
+        }
+        // fall through
+      case ObsGraphOpType::CREATE_SCENE:
+        if (graph_sources.count(op.name) || !created.insert(op.name).second) {
+          error = opError(i, "a source named " + op.name + " already exists");
+          return false;
+        }
+        continue;
+      case ObsGraphOpType::UPDATE_SOURCE:
+      case ObsGraphOpType::REMOVE_SOURCE:
+      case ObsGraphOpType::ADD_ITEM:
+      case ObsGraphOpType::SET_PROGRAM:
+        if (!names.count(target) || removed.count(target)) {
+          error = opError(i, "no source named " + target);
+          return false;
+        }
+        if (op.type == ObsGraphOpType::REMOVE_SOURCE)
+          removed.insert(target);
+        if (op.type != ObsGraphOpType::ADD_ITEM)
+          continue;
+        break;
+      default:
+        break;
+      }
 
-obs_audio_info create_oai(
-  size_t samples_per_sec = DEFAULT_AUDIO_SAMPLES,
-  const enum speaker_layout speakers = DEFAULT_AUDIO_CHANNELS) 
-{
-    struct obs_audio_info oai;
+      if (!names.count(op.scene) || !names[op.scene] || removed.count(op.scene)) {
+        error = opError(i, "no scene named " + op.scene);
+        return false;
+      }
+      if (op.type == ObsGraphOpType::ADD_ITEM)
+        continue;
 
-    oai.samples_per_sec = samples_per_sec;
-    oai.speakers = speakers;
+      auto it = graph_sources.find(op.scene);
+      obs_scene_t* scene = it == graph_sources.end() ? nullptr : obs_scene_from_source(it->second);
+      if (!scene || !obs_scene_find_sceneitem_by_id(scene, op.item) ||
+          removed_items.count(std::make_pair(op.scene, op.item))) {
+        error = opError(i, "no item " + std::to_string(op.item) + " in scene " + op.scene);
+        return false;
+      }
+      if (op.type == ObsGraphOpType::REMOVE_ITEM)
+        removed_items.insert(std::make_pair(op.scene, op.item));
+    }
+    return true;
+  }
 
-    return oai;
-}
+  bool apply(size_t index, std::string& error) {
+    const ObsGraphOp& op = ops[index];
+    obs_data_t* settings;
 
-// Enumerates encoders
-bool enumCodecs(void* c, obs_encoder_t* encoder) {
-  if(c && encoder) { 
-    std::string* codecs = (std::string*)c;
-    *codecs += obs_encoder_get_name(encoder);
+    switch (op.type) {
+    case ObsGraphOpType::CREATE_SCENE: {
+      obs_scene_t* scene = obs_scene_create(op.name.c_str());
+      if (!scene) {
+        error = opError(index, "could not create scene " + op.name);
+        return false;
+      }
+      graph_sources[op.name] = obs_scene_get_source(scene);
+      results[index].name = op.name;
+      return true;
+    }
+    case ObsGraphOpType::CREATE_SOURCE: {
+      settings = dataFromJson(op.settings);
+      obs_source_t* source = obs_source_create(op.id.c_str(), op.name.c_str(), settings, nullptr);
+      obs_data_release(settings);
+      if (!source) {
+        error = opError(index, "could not create source " + op.id);
+        return false;
+      }
+      graph_sources[op.name] = source;
+      results[index].name = op.name;
+      return true;
+    }
+    case ObsGraphOpType::UPDATE_SOURCE:
+      settings = dataFromJson(op.settings);
+      obs_source_update(graph_sources[op.name], settings);
+      obs_data_release(settings);
+      return true;
+    case ObsGraphOpType::REMOVE_SOURCE: {
+      obs_source_t* source = graph_sources[op.name];
+      obs_source_t* program = obs_get_output_source(0);
+      if (program == source)
+        obs_set_output_source(0, nullptr);
+      obs_source_release(program);
+      obs_source_remove(source);
+      obs_source_release(source);
+      graph_sources.erase(op.name);
+      return true;
+    }
+    case ObsGraphOpType::SET_PROGRAM:
+      obs_set_output_source(0, graph_sources[op.source]);
+      return true;
+    case ObsGraphOpType::ADD_ITEM: {
+      obs_sceneitem_t* item = obs_scene_add(obs_scene_from_source(graph_sources[op.scene]),
+          graph_sources[op.source]);
+      if (!item) {
+        error = opError(index, "could not add " + op.source + " to " + op.scene);
+        return false;
+      }
+      obs_sceneitem_set_visible(item, op.visible);
+      results[index].item = obs_sceneitem_get_id(item);
+      return true;
+    }
+    default:
+      break;
+    }
+
+    obs_sceneitem_t* item = obs_scene_find_sceneitem_by_id(
+        obs_scene_from_source(graph_sources[op.scene]), op.item);
+    switch (op.type) {
+    case ObsGraphOpType::SET_TRANSFORM:
+      obs_sceneitem_defer_update_begin(item);
+      if (op.has_pos)
+        obs_sceneitem_set_pos(item, &op.pos);
+      if (op.has_scale)
+        obs_sceneitem_set_scale(item, &op.scale);
+      if (op.has_rotation)
+        obs_sceneitem_set_rot(item, (float)op.rotation);
+      if (op.has_alignment)
+        obs_sceneitem_set_alignment(item, op.alignment);
+      if (op.has_crop)
+        obs_sceneitem_set_crop(item, &op.crop);
+      obs_sceneitem_defer_update_end(item);
+      break;
+    case ObsGraphOpType::SET_VISIBLE:
+      obs_sceneitem_set_visible(item, op.visible);
+      break;
+    case ObsGraphOpType::SET_ORDER:
+      obs_sceneitem_set_order(item, op.order);
+      break;
+    case ObsGraphOpType::REMOVE_ITEM:
+      obs_sceneitem_remove(item);
+      break;
+    default:
+      break;
+    }
     return true;
   }
 
-  return false;
-}
+  std::vector<ObsGraphOp> ops;
+  std::vector<ObsGraphResult> results;
+  Napi::Promise::Deferred deferredPromise;
+};
 
-Napi::String obsGetCodecs(const Napi::CallbackInfo& info) {
+// createScene(name) -> Promise<name>
+Napi::Value obsCreateScene(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  
-  if(obs_initialized()) {
-    std::string codecs = "";
-    obs_enum_encoders(enumCodecs, &codecs);
-    
-    return Napi::String::New(env, codecs);
-  }
-  else
-    return Napi::String::New(env, NOT_INITIALIZED_STRING);
-} 
 
-// Enumerates outputs.
-// 
-bool enumOutputs(void* c, obs_output_t* encoder) {
-  if(c && encoder) { 
-    std::string* codecs = (std::string*)c;
-    *codecs += obs_output_get_name(encoder);
-    return true;
+  if (info.Length() != 1 || !info[0].IsString()) {
+    Napi::TypeError::New(env, "Expected a scene name")
+        .ThrowAsJavaScriptException();
+    return env.Null();
   }
 
-  return false;
+  std::vector<ObsGraphOp> ops(1);
+  ops[0].type = ObsGraphOpType::CREATE_SCENE;
+  ops[0].name = info[0].As<Napi::String>();
+  return AsyncApplyBatchWorker::Schedule(env, ops);
+}
+
+// createSource({ name, id, settings }) -> Promise<name>
+Napi::Value obsCreateSource(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  std::vector<ObsGraphOp> ops(1);
+  if (info.Length() != 1 || !info[0].IsObject()) {
+    Napi::TypeError::New(env, "Expected a source config object with a name and an id")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  Napi::Object options = info[0].As<Napi::Object>();
+  ops[0].type = ObsGraphOpType::CREATE_SOURCE;
+  if (!getString(options, "name", ops[0].name) || !getString(options, "id", ops[0].id) ||
+      !getSettingsJson(env, options, ops[0].settings) ||
+      ops[0].name.empty() || ops[0].id.empty()) {
+    Napi::TypeError::New(env, "Expected a source config object with a name and an id")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  return AsyncApplyBatchWorker::Schedule(env, ops);
 }
 
-Napi::String obsGetOutputs(const Napi::CallbackInfo& info) {
+// addSceneItem(scene, source) -> Promise<item id>
+Napi::Value obsAddSceneItem(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  
-  if(obs_initialized()) {
-    std::string outputs = "";
-    obs_enum_outputs(enumOutputs, &outputs);
-    
-    return Napi::String::New(env, outputs);
+
+  if (info.Length() != 2 || !info[0].IsString() || !info[1].IsString()) {
+    Napi::TypeError::New(env, "Expected a scene name and a source name")
+        .ThrowAsJavaScriptException();
+    return env.Null();
   }
-  else
-    return Napi::String::New(env, NOT_INITIALIZED_STRING);
-} 
 
-// Asynchronously initializes the OBS core context. 
-class AsyncInitializeWorker : public Napi::AsyncWorker {
+  std::vector<ObsGraphOp> ops(1);
+  ops[0].type = ObsGraphOpType::ADD_ITEM;
+  ops[0].scene = info[0].As<Napi::String>();
+  ops[0].source = info[1].As<Napi::String>();
+  return AsyncApplyBatchWorker::Schedule(env, ops);
+}
+
+// Asynchronously lists the items of a scene, bottom to top.
+//
+class AsyncSceneItemsWorker : public ObsCommandWorker {
 public:
   static Napi::Value Create(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
-    //   :param  locale:             The locale to use for modules
-    //                               (E.G. "en-US")
-    //   :param  module_config_path: Path to module config storage directory
-    //                               (or *NULL* if none)
-    //   :param  store:              The profiler name store for OBS to use or NULL
-    obs_startup("en-US", nullptr, nullptr);
-    if (!obs_initialized()) {
+    if (!initRequested()) {
       Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
           .ThrowAsJavaScriptException();
       return env.Null();
     }
-    
-    obs_load_all_modules();
 
-    AsyncInitializeWorker* worker = new AsyncInitializeWorker(info.Env());
+    if (info.Length() != 1 || !info[0].IsString()) {
+      Napi::TypeError::New(env, "Expected a scene name")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
 
+    AsyncSceneItemsWorker* worker = new AsyncSceneItemsWorker(env, info[0].As<Napi::String>());
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
     worker->Queue();
-    return worker->deferredPromise.Promise();
+    return promise;
   }
 
 protected:
   void Execute() override {
-    result = "v" + std::string(obs_get_version_string());
+    auto it = graph_sources.find(scene_name);
+    obs_scene_t* scene = it == graph_sources.end() ? nullptr : obs_scene_from_source(it->second);
+    if (!scene) {
+      SetError("Error: no scene named " + scene_name);
+      return;
+    }
+    obs_scene_enum_items(scene, collectItem, &items);
   }
 
   virtual void OnOK() override {
-      deferredPromise.Resolve(Napi::String::New(Env(), result));
+    Napi::Env env = Env();
+    Napi::Array array = Napi::Array::New(env, items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+      const Item& item = items[i];
+      Napi::Object pos = Napi::Object::New(env);
+      pos.Set("x", Napi::Number::New(env, item.pos.x));
+      pos.Set("y", Napi::Number::New(env, item.pos.y));
+      Napi::Object scale = Napi::Object::New(env);
+      scale.Set("x", Napi::Number::New(env, item.scale.x));
+      scale.Set("y", Napi::Number::New(env, item.scale.y));
+
+      Napi::Object object = Napi::Object::New(env);
+      object.Set("id", Napi::Number::New(env, (double)item.id));
+      object.Set("source", Napi::String::New(env, item.source));
+      object.Set("visible", Napi::Boolean::New(env, item.visible));
+      object.Set("pos", pos);
+      object.Set("scale", scale);
+      object.Set("rotation", Napi::Number::New(env, item.rotation));
+      array.Set(i, object);
+    }
+    deferredPromise.Resolve(array);
   }
 
   virtual void OnError(const Napi::Error& e) override {
-      deferredPromise.Reject(e.Value());
+    deferredPromise.Reject(e.Value());
   }
 
 private:
-  AsyncInitializeWorker(napi_env env) :
-    Napi::AsyncWorker(env),
-    result(),
+  struct Item {
+    int64_t id;
+    std::string source;
+    bool visible;
+    struct vec2 pos;
+    struct vec2 scale;
+    float rotation;
+  };
+
+  AsyncSceneItemsWorker(napi_env env, const std::string& scene_name) :
+    ObsCommandWorker(env),
+    scene_name(scene_name),
     deferredPromise(Napi::Promise::Deferred::New(env)) { }
 
-  std::string result;
+  static bool collectItem(obs_scene_t*, obs_sceneitem_t* sceneitem, void* data) {
+    std::vector<Item>& items = *(std::vector<Item>*)data;
+    Item item;
+    item.id = obs_sceneitem_get_id(sceneitem);
+    const char* name = obs_source_get_name(obs_sceneitem_get_source(sceneitem));
+    item.source = name ? name : "";
+    item.visible = obs_sceneitem_visible(sceneitem);
+    obs_sceneitem_get_pos(sceneitem, &item.pos);
+    obs_sceneitem_get_scale(sceneitem, &item.scale);
+    item.rotation = obs_sceneitem_get_rot(sceneitem);
+    items.push_back(item);
+    return true;
+  }
 
+  std::string scene_name;
+  std::vector<Item> items;
   Napi::Promise::Deferred deferredPromise;
 };
 
-// Releases all data associated with OBS and terminates the OBS context
+// Frame source
+// An async video source fed from JS, for overlays rendered offscreen by
+// Electron (webContents "paint" events). push() hands the bitmap straight to
+// obs_source_output_video, which copies it once into libobs' async frame
+// cache; the cache reuses frames of the same size and format, so steady
+// pushes allocate nothing. The source is unbuffered, so the newest frame is
+// always the one shown. It joins the scene graph under its name.
 //
-Napi::String obsShutdown(const Napi::CallbackInfo& info) {
-  Napi::Env env = info.Env();
-  
-  if(obs_initialized()) {
-    obs_shutdown();
-    return Napi::String::New(env, "Success shutting down OBS");
+// Electron 13 offscreen rendering only provides CPU bitmaps, so shared GPU
+// textures are not supported.
+//
+// JS: createFrameSource({ name, width, height, format }) -> Promise<FrameSource>
+//     format is 'bgra' (default, what NativeImage.getBitmap() gives) or 'rgba'
+//     frameSource.push(buffer[, width, height, stride]) -> true if queued
+//     frameSource.release()
+#define FRAME_SOURCE_ID ("obsapi_frame_source")
+
+static const char* frameSourceGetName(void*) {
+  return "obsapi frame source";
+}
+
+static void* frameSourceCreate(obs_data_t*, obs_source_t* source) {
+  return source;
+}
+
+static void frameSourceDestroy(void*) {
+}
+
+// Registers the frame source type once per OBS session.
+static void registerFrameSource() {
+  if (obs_source_get_display_name(FRAME_SOURCE_ID))
+    return;
+
+  struct obs_source_info info = {};
+  info.id = FRAME_SOURCE_ID;
+  info.type = OBS_SOURCE_TYPE_INPUT;
+  info.output_flags = OBS_SOURCE_ASYNC_VIDEO | OBS_SOURCE_DO_NOT_DUPLICATE;
+  info.get_name = frameSourceGetName;
+  info.create = frameSourceCreate;
+  info.destroy = frameSourceDestroy;
+  obs_register_source(&info);
+}
+
+struct ObsFrameSource {
+  std::mutex mutex;
+  obs_source_t* source = nullptr;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  enum video_format format = VIDEO_FORMAT_BGRA;
+
+  // Runs on the JS thread.
+  bool push(const uint8_t* data, size_t size, uint32_t frame_width, uint32_t frame_height,
+      uint32_t stride) {
+    if (!stride)
+      stride = frame_width * 4;
+    if (!frame_width || !frame_height || stride < frame_width * 4 ||
+        (uint64_t)stride * frame_height > size)
+      return false;
+
+    struct obs_source_frame frame = {};
+    frame.data[0] = (uint8_t*)data;
+    frame.linesize[0] = stride;
+    frame.width = frame_width;
+    frame.height = frame_height;
+    frame.format = format;
+    frame.full_range = true;
+    frame.timestamp = os_gettime_ns();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!source)
+      return false;
+    obs_source_output_video(source, &frame);
+    return true;
   }
-  else
-    return Napi::String::New(env, NOT_INITIALIZED_STRING);
+
+  // Drops the source reference. Runs on the command thread.
+  void release() {
+    std::lock_guard<std::mutex> lock(mutex);
+    obs_source_release(source);
+    source = nullptr;
+  }
+};
+
+// Live frame sources, touched on the command thread only.
+static std::set<std::shared_ptr<ObsFrameSource>> frame_sources;
+
+// Releases every frame source. Runs on the command thread.
+static void stopFrameSources() {
+  for (const std::shared_ptr<ObsFrameSource>& frame_source : frame_sources)
+    frame_source->release();
+  frame_sources.clear();
 }
 
-// Asynchronously sets base video output base resolution/fps/format
-// Note: This data cannot be changed if an output is currently active.
-// Note: The graphics module cannot be changed without fully destroying the OBS context.
+// Asynchronously creates a frame source and adds it to the scene graph.
 //
-class AsyncResetVideoWorker : public Napi::AsyncWorker {
+class AsyncCreateFrameSourceWorker : public ObsCommandWorker {
 public:
   static Napi::Value Create(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
-    if (!obs_initialized()) {
+    if (!initRequested()) {
       Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
           .ThrowAsJavaScriptException();
       return env.Null();
     }
 
-    if (info.Length() != 1 || !info[0].IsString()) {
-      Napi::TypeError::New(env, "Expected a single string argument")
+    std::string name;
+    std::string format = "bgra";
+    std::shared_ptr<ObsFrameSource> frame_source = std::make_shared<ObsFrameSource>();
+    Napi::Object options = info.Length() == 1 && info[0].IsObject() ?
+        info[0].As<Napi::Object>() : Napi::Object();
+    if (options.IsEmpty() || !getString(options, "name", name) || name.empty() ||
+        !getUint(options, "width", frame_source->width) ||
+        !getUint(options, "height", frame_source->height) ||
+        !getString(options, "format", format) || (format != "bgra" && format != "rgba")) {
+      Napi::TypeError::New(env, "Expected a frame source config object with a name")
           .ThrowAsJavaScriptException();
       return env.Null();
     }
+    frame_source->format = format == "rgba" ? VIDEO_FORMAT_RGBA : VIDEO_FORMAT_BGRA;
 
-    std::string input = info[0].As<Napi::String>();
-
-    AsyncResetVideoWorker* worker = new AsyncResetVideoWorker(info.Env(), input);
+    AsyncCreateFrameSourceWorker* worker =
+        new AsyncCreateFrameSourceWorker(env, name, frame_source);
 
+    Napi::Promise promise = worker->deferredPromise.Promise();
     worker->Queue();
-    return worker->deferredPromise.Promise();
+    return promise;
   }
 
 protected:
   void Execute() override {
-    size_t width = DEFAULT_VIDEO_WIDTH;
-    size_t height = DEFAULT_VIDEO_HEIGHT;
-    size_t xpos = input.find('x');
-    if(xpos != std::string::npos) {
-      std::string w = input.substr(0, xpos);
-      input.erase(0, xpos + 1);
-      std::string h = input;
-      if(w.length()) {
-        width = atoi(w.c_str());
-      };
-      if(h.length()) {
-        height = atoi(h.c_str());
-      };
+    std::string error;
+    if (!waitForReady(error)) {
+      SetError(error);
+      return;
+    }
+    if (graph_sources.count(name)) {
+      SetError("Error: a source named " + name + " already exists");
+      return;
     }
 
-    ovi = create_ovi(DEFAULT_VIDEO_ADAPTER, DEFAULT_MODULE, DEFAULT_VIDEO_FORMAT, 
-      DEFAULT_VIDEO_FPS_NUM, DEFAULT_VIDEO_FPS_DEN, width, height);
+    registerFrameSource();
+    obs_source_t* source = obs_source_create(FRAME_SOURCE_ID, name.c_str(), nullptr, nullptr);
+    if (!source) {
+      SetError("Error: could not create frame source");
+      return;
+    }
+    obs_source_set_async_unbuffered(source, true);
 
-    obs_reset_video(&ovi);
+    // The graph and the handle each hold a reference.
+    graph_sources[name] = source;
+#if LIBOBS_API_MAJOR_VER >= 28
+    frame_source->source = obs_source_get_ref(source);
+#else
+    obs_source_addref(source);
+    frame_source->source = source;
+#endif
+    frame_sources.insert(frame_source);
   }
 
   virtual void OnOK() override {
-      deferredPromise.Resolve(Napi::String::New(Env(), 
-        std::to_string(ovi.base_width) + 'x' + std::to_string(ovi.base_height)));
+    Napi::Env env = Env();
+    std::shared_ptr<ObsFrameSource> pushed = frame_source;
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("name", Napi::String::New(env, name));
+    result.Set("push", Napi::Function::New(env, [pushed](const Napi::CallbackInfo& info) {
+      Napi::Env env = info.Env();
+      if (info.Length() < 1 || (!info[0].IsBuffer() && !info[0].IsArrayBuffer())) {
+        Napi::TypeError::New(env, "Expected a Buffer or an ArrayBuffer")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+      }
+
+      const uint8_t* data;
+      size_t size;
+      if (info[0].IsBuffer()) {
+        Napi::Buffer<uint8_t> buffer = info[0].As<Napi::Buffer<uint8_t>>();
+        data = buffer.Data();
+        size = buffer.Length();
+      } else {
+        Napi::ArrayBuffer buffer = info[0].As<Napi::ArrayBuffer>();
+        data = (const uint8_t*)buffer.Data();
+        size = buffer.ByteLength();
+      }
+
+      uint32_t width = info.Length() > 2 ? info[1].ToNumber().Uint32Value() : pushed->width;
+      uint32_t height = info.Length() > 2 ? info[2].ToNumber().Uint32Value() : pushed->height;
+      uint32_t stride = info.Length() > 3 ? info[3].ToNumber().Uint32Value() : 0;
+      return Napi::Boolean::New(env, pushed->push(data, size, width, height, stride));
+    }, "push"));
+    result.Set("release", Napi::Function::New(env, [pushed](const Napi::CallbackInfo& info) {
+      std::shared_ptr<ObsFrameSource> released = pushed;
+      ObsTaskWorker::Post(info.Env(), [released]() {
+        released->release();
+        frame_sources.erase(released);
+      });
+      return info.Env().Undefined();
+    }, "release"));
+    deferredPromise.Resolve(result);
   }
 
   virtual void OnError(const Napi::Error& e) override {
-      deferredPromise.Reject(e.Value());
+    deferredPromise.Reject(e.Value());
   }
 
 private:
-  struct obs_video_info ovi;
-  AsyncResetVideoWorker(napi_env env, std::string& hint) :
-    Napi::AsyncWorker(env),
-    input(hint),
+  AsyncCreateFrameSourceWorker(napi_env env, const std::string& name,
+      std::shared_ptr<ObsFrameSource>& frame_source) :
+    ObsCommandWorker(env),
+    name(name),
+    frame_source(frame_source),
     deferredPromise(Napi::Promise::Deferred::New(env)) { }
 
-  std::string input;
+  std::string name;
+  std::shared_ptr<ObsFrameSource> frame_source;
   Napi::Promise::Deferred deferredPromise;
 };
 
-// Asynchronously sets base audio output format/channels/samples/etc.
-// Note: Cannot reset base audio if an output is currently active.
+// Asynchronously creates a canvas, or changes the scene it renders.
 //
-class AsyncResetAudioWorker : public Napi::AsyncWorker {
+class AsyncCanvasWorker : public ObsCommandWorker {
 public:
+  enum class Op { CREATE, SET_SCENE };
+
   static Napi::Value Create(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
-    if (!obs_initialized()) {
+    if (!initRequested()) {
       Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
           .ThrowAsJavaScriptException();
       return env.Null();
     }
 
-    if (info.Length() != 1 || !info[0].IsString()) {
-      Napi::TypeError::New(env, "Expected a single string argument")
+    std::string name;
+    std::string scene;
+    struct obs_video_info ovi = create_ovi();
+    Napi::Object options = info.Length() == 1 && info[0].IsObject() ?
+        info[0].As<Napi::Object>() : Napi::Object();
+    if (options.IsEmpty() || !getString(options, "name", name) || name.empty() ||
+        !getString(options, "scene", scene) ||
+        !options.Has("baseWidth") || !options.Has("baseHeight") ||
+        !parseVideoConfig(options, ovi)) {
+      Napi::TypeError::New(env, "Expected a canvas config object with a name and a base size")
           .ThrowAsJavaScriptException();
       return env.Null();
     }
 
-    std::string input = info[0].As<Napi::String>();
+    AsyncCanvasWorker* worker = new AsyncCanvasWorker(env, Op::CREATE, name, scene);
+    worker->ovi = ovi;
+    worker->inherit_fps = !options.Has("fpsNum") && !options.Has("fpsDen");
+    worker->inherit_color = !options.Has("format") && !options.Has("colorspace") &&
+        !options.Has("range");
 
-    AsyncResetAudioWorker* worker = new AsyncResetAudioWorker(info.Env(), input);
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue();
+    return promise;
+  }
 
+  static Napi::Value Schedule(Napi::Env env, const std::string& name, const std::string& scene) {
+    AsyncCanvasWorker* worker = new AsyncCanvasWorker(env, Op::SET_SCENE, name, scene);
+
+    Napi::Promise promise = worker->deferredPromise.Promise();
     worker->Queue();
-    return worker->deferredPromise.Promise();
+    return promise;
   }
 
 protected:
   void Execute() override {
-    size_t mpos = input.find("mono");
-    bool stereo = true;
-    if(mpos != std::string::npos) {
-      stereo = false;
+    std::string error;
+    if (!waitForReady(error)) {
+      SetError(error);
+      return;
+    }
+
+    obs_source_t* source = nullptr;
+    if (!scene.empty()) {
+      auto it = graph_sources.find(scene);
+      if (it == graph_sources.end()) {
+        SetError("Error: no source named " + scene);
+        return;
+      }
+      source = it->second;
+    }
+
+    if (op == Op::SET_SCENE) {
+      auto it = canvases.find(name);
+      if (it == canvases.end()) {
+        SetError("Error: no canvas named " + name);
+        return;
+      }
+      obs_view_set_source(it->second->view, 0, source);
+      return;
+    }
+
+    if (canvases.count(name)) {
+      SetError("Error: a canvas named " + name + " already exists");
+      return;
+    }
+
+    struct obs_video_info main_ovi;
+    if (!obs_get_video_info(&main_ovi)) {
+      SetError("Error: video has not been reset");
+      return;
+    }
+    ovi.adapter = main_ovi.adapter;
+    ovi.graphics_module = main_ovi.graphics_module;
+    if (inherit_fps) {
+      ovi.fps_num = main_ovi.fps_num;
+      ovi.fps_den = main_ovi.fps_den;
+    }
+    if (inherit_color) {
+      ovi.output_format = main_ovi.output_format;
+      ovi.colorspace = main_ovi.colorspace;
+      ovi.range = main_ovi.range;
     }
 
-    oai = create_oai(DEFAULT_AUDIO_SAMPLES, stereo? SPEAKERS_STEREO : SPEAKERS_MONO);
+    std::shared_ptr<ObsCanvas> canvas = std::make_shared<ObsCanvas>();
+    canvas->name = name;
+    canvas->view = obs_view_create();
+#if LIBOBS_API_MAJOR_VER >= 30
+    canvas->video = obs_view_add2(canvas->view, &ovi);
+#else
+    if (ovi.base_width != main_ovi.base_width || ovi.base_height != main_ovi.base_height ||
+        ovi.output_width != main_ovi.output_width || ovi.output_height != main_ovi.output_height ||
+        ovi.fps_num * main_ovi.fps_den != main_ovi.fps_num * ovi.fps_den) {
+      SetError("Error: canvases with their own size or frame rate require libobs 30 or later");
+      return;
+    }
+    canvas->video = obs_view_add(canvas->view);
+    ovi = main_ovi;
+#endif
+    if (!canvas->video) {
+      SetError("Error: could not create the canvas video mix");
+      return;
+    }
 
-    obs_reset_audio(&oai);
+    obs_view_set_source(canvas->view, 0, source);
+    canvases[name] = canvas;
   }
 
   virtual void OnOK() override {
-      deferredPromise.Resolve(Napi::String::New(Env(), 
-        oai.speakers == SPEAKERS_STEREO ? "stereo" : "mono"));
+    Napi::Env env = Env();
+    if (op == Op::SET_SCENE) {
+      deferredPromise.Resolve(env.Undefined());
+      return;
+    }
+
+    // The functions hold the name rather than the canvas, so that a
+    // collected handle never releases the view off the command thread.
+    std::string canvas_name = name;
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("name", Napi::String::New(env, name));
+    result.Set("video", videoInfoToJs(env, ovi));
+    result.Set("setScene", Napi::Function::New(env, [canvas_name](const Napi::CallbackInfo& info) {
+      Napi::Env env = info.Env();
+      std::string scene;
+      if (info.Length() > 0 && !info[0].IsNull() && !info[0].IsUndefined()) {
+        if (!info[0].IsString()) {
+          Napi::TypeError::New(env, "Expected a scene name")
+              .ThrowAsJavaScriptException();
+          return env.Null();
+        }
+        scene = info[0].As<Napi::String>().Utf8Value();
+      }
+      return Schedule(env, canvas_name, scene);
+    }, "setScene"));
+    result.Set("destroy", Napi::Function::New(env, [canvas_name](const Napi::CallbackInfo& info) {
+      ObsTaskWorker::Post(info.Env(), [canvas_name]() { canvases.erase(canvas_name); });
+      return info.Env().Undefined();
+    }, "destroy"));
+    deferredPromise.Resolve(result);
   }
 
   virtual void OnError(const Napi::Error& e) override {
-      deferredPromise.Reject(e.Value());
+    deferredPromise.Reject(e.Value());
   }
 
 private:
-  struct obs_audio_info oai;
-  AsyncResetAudioWorker(napi_env env, std::string& hint) :
-    Napi::AsyncWorker(env),
-    input(hint),
+  AsyncCanvasWorker(napi_env env, Op op, const std::string& name, const std::string& scene) :
+    ObsCommandWorker(env),
+    op(op),
+    name(name),
+    scene(scene),
     deferredPromise(Napi::Promise::Deferred::New(env)) { }
 
-  std::string input;
+  Op op;
+  std::string name;
+  std::string scene;
+  struct obs_video_info ovi;
+  bool inherit_fps = false;
+  bool inherit_color = false;
   Napi::Promise::Deferred deferredPromise;
 };
 
-// Asynchronously start output
+// Shared memory ring
+// A named block of shared memory holding a ring of fixed-size slots, so one
+// process can hand frames to another without serializing them: the
+// out-of-process host (obs-host.js) writes preview frames and audio levels,
+// and the Electron main process reads them. There is one writer; readers
+// only ever want the newest slot, so every slot is guarded by a sequence
+// counter (odd while it is being written) and a reader that races the
+// writer simply retries. No call blocks or takes a lock, and libobs is not
+// involved, so the ring works before initialize().
+//
+// JS: openSharedRing({ name, slots, slotSize, create }) -> ring
+//     create: true makes a new ring (1-64 slots of at most 128 MiB); false
+//     opens the ring another process created under that name
+//     ring.write(buffer) -> seq of the written slot
+//     ring.read([buffer]) -> null if nothing new, else { seq, size, dropped, data }
+//     data is the given buffer when it is large enough, else a new Buffer;
+//     dropped counts the writes skipped since the previous read
+//     ring.name, ring.slots, ring.slotSize, ring.close()
+#define SHARED_RING_MAGIC 0x5253424f
+#define SHARED_RING_VERSION 1
+#define SHARED_RING_ALIGN 64
+#define SHARED_RING_READ_ATTEMPTS 4
+#define MAX_SHARED_RING_SLOTS 64
+#define MAX_SHARED_RING_SLOT_SIZE (128u * 1024 * 1024)
+
+struct ObsSharedRingHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slots;
+  uint32_t slot_size;
+  std::atomic<uint64_t> written;
+};
+
+struct ObsSharedRingSlot {
+  std::atomic<uint64_t> seq;
+  uint64_t size;
+};
+
+static size_t sharedRingAlign(size_t size) {
+  return (size + SHARED_RING_ALIGN - 1) / SHARED_RING_ALIGN * SHARED_RING_ALIGN;
+}
+
+struct ObsSharedRing {
+  std::string name;
+  bool owner = false;
+  uint8_t* memory = nullptr;
+  size_t mapped_size = 0;
+  size_t slot_stride = 0;
+  ObsSharedRingHeader* header = nullptr;
+  uint64_t last_read = 0;
+#if defined(_WIN32)
+  HANDLE mapping = nullptr;
+#endif
+
+  ~ObsSharedRing() {
+    close();
+  }
+
+  static size_t slotStride(uint32_t slot_size) {
+    return sharedRingAlign(sizeof(ObsSharedRingSlot) + slot_size);
+  }
+
+  ObsSharedRingSlot* slot(uint64_t index) {
+    return (ObsSharedRingSlot*)(memory + sharedRingAlign(sizeof(ObsSharedRingHeader)) +
+        (index % header->slots) * slot_stride);
+  }
+
+  bool map(bool create, uint32_t slots, uint32_t slot_size, std::string& error) {
+    size_t size = create ?
+        sharedRingAlign(sizeof(ObsSharedRingHeader)) + slots * slotStride(slot_size) : 0;
+#if defined(_WIN32)
+    std::string path = "Local\\" + name;
+    mapping = create ?
+        CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+            (DWORD)((uint64_t)size >> 32), (DWORD)size, path.c_str()) :
+        OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path.c_str());
+    if (!mapping || (create && GetLastError() == ERROR_ALREADY_EXISTS)) {
+      if (mapping)
+        CloseHandle(mapping);
+      mapping = nullptr;
+      error = "Error: could not " + std::string(create ? "create" : "open") +
+          " shared ring " + name;
+      return false;
+    }
+    memory = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    MEMORY_BASIC_INFORMATION region = {};
+    if (memory && VirtualQuery(memory, &region, sizeof(region)))
+      mapped_size = region.RegionSize;
+#else
+    std::string path = "/" + name;
+    int fd = shm_open(path.c_str(), create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR, 0600);
+    if (fd < 0) {
+      error = "Error: could not " + std::string(create ? "create" : "open") +
+          " shared ring " + name;
+      return false;
+    }
+    owner = create;
+    struct stat info = {};
+    if (create ? ftruncate(fd, (off_t)size) == 0 : fstat(fd, &info) == 0) {
+      mapped_size = create ? size : (size_t)info.st_size;
+      void* view = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      memory = view == MAP_FAILED ? nullptr : (uint8_t*)view;
+    }
+    ::close(fd);
+#endif
+    if (!memory || mapped_size < sizeof(ObsSharedRingHeader)) {
+      error = "Error: could not map shared ring " + name;
+      close();
+      return false;
+    }
+
+    header = (ObsSharedRingHeader*)memory;
+    if (create) {
+      header->magic = SHARED_RING_MAGIC;
+      header->version = SHARED_RING_VERSION;
+      header->slots = slots;
+      header->slot_size = slot_size;
+      header->written.store(0, std::memory_order_relaxed);
+      slot_stride = slotStride(slot_size);
+      for (uint32_t i = 0; i < slots; i++)
+        new (slot(i)) ObsSharedRingSlot{ {0}, 0 };
+    } else if (header->magic != SHARED_RING_MAGIC || header->version != SHARED_RING_VERSION ||
+        !header->slots || header->slots > MAX_SHARED_RING_SLOTS ||
+        header->slot_size > MAX_SHARED_RING_SLOT_SIZE || sharedRingAlign(sizeof(ObsSharedRingHeader)) +
+            header->slots * slotStride(header->slot_size) > mapped_size) {
+      error = "Error: " + name + " is not a compatible shared ring";
+      close();
+      return false;
+    }
+    slot_stride = slotStride(header->slot_size);
+    last_read = header->written.load(std::memory_order_acquire);
+    return true;
+  }
+
+  // Writes one slot and returns its sequence number (1 for the first write).
+  uint64_t write(const uint8_t* data, size_t size) {
+    uint64_t n = header->written.load(std::memory_order_relaxed);
+    ObsSharedRingSlot* target = slot(n);
+    target->seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy((uint8_t*)(target + 1), data, size);
+    target->size = size;
+    target->seq.store(2 * n + 2, std::memory_order_release);
+    header->written.store(n + 1, std::memory_order_release);
+    return n + 1;
+  }
+
+  // Copies the newest slot into target if it is new and fits in capacity.
+  // Returns false if nothing was written since the last read, the writer kept
+  // overtaking the reader, or the slot did not fit; size is set in that case
+  // so the caller can retry with a larger buffer.
+  bool read(uint8_t* target, size_t capacity, size_t& size, uint64_t& seq, uint64_t& dropped) {
+    size = 0;
+    for (int attempt = 0; attempt < SHARED_RING_READ_ATTEMPTS; attempt++) {
+      uint64_t written = header->written.load(std::memory_order_acquire);
+      if (written == last_read)
+        return false;
+
+      uint64_t n = written - 1;
+      ObsSharedRingSlot* source = slot(n);
+      if (source->seq.load(std::memory_order_acquire) != 2 * n + 2)
+        continue;
+      size = std::min((size_t)source->size, (size_t)header->slot_size);
+      if (size > capacity)
+        return false;
+      if (size)
+        memcpy(target, (const uint8_t*)(source + 1), size);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (source->seq.load(std::memory_order_relaxed) != 2 * n + 2)
+        continue;
+
+      seq = written;
+      dropped = written - last_read - 1;
+      last_read = written;
+      return true;
+    }
+    return false;
+  }
+
+  void close() {
+#if defined(_WIN32)
+    if (memory)
+      UnmapViewOfFile(memory);
+    if (mapping)
+      CloseHandle(mapping);
+    mapping = nullptr;
+#else
+    if (memory)
+      munmap(memory, mapped_size);
+    if (owner)
+      shm_unlink(("/" + name).c_str());
+    owner = false;
+#endif
+    memory = nullptr;
+    header = nullptr;
+  }
+};
+
+static bool getBufferData(const Napi::Value& value, uint8_t*& data, size_t& size) {
+  if (value.IsBuffer()) {
+    Napi::Buffer<uint8_t> buffer = value.As<Napi::Buffer<uint8_t>>();
+    data = buffer.Data();
+    size = buffer.Length();
+  } else if (value.IsArrayBuffer()) {
+    Napi::ArrayBuffer buffer = value.As<Napi::ArrayBuffer>();
+    data = (uint8_t*)buffer.Data();
+    size = buffer.ByteLength();
+  } else if (value.IsTypedArray()) {
+    Napi::TypedArray array = value.As<Napi::TypedArray>();
+    data = (uint8_t*)array.ArrayBuffer().Data() + array.ByteOffset();
+    size = array.ByteLength();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+Napi::Value obsOpenSharedRing(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+
+  std::shared_ptr<ObsSharedRing> ring = std::make_shared<ObsSharedRing>();
+  bool create = false;
+  uint32_t slots = DEFAULT_TAP_SLOTS;
+  uint32_t slot_size = 0;
+  Napi::Object options = info.Length() == 1 && info[0].IsObject() ?
+      info[0].As<Napi::Object>() : Napi::Object();
+  if (!options.IsEmpty())
+    create = options.Has("create") && options.Get("create").ToBoolean();
+  if (options.IsEmpty() || !getString(options, "name", ring->name) || ring->name.empty() ||
+      ring->name.find_first_of("/\\") != std::string::npos ||
+      !getUint(options, "slots", slots) ||
+      !getUint(options, "slotSize", slot_size) ||
+      (create && (!slots || slots > MAX_SHARED_RING_SLOTS ||
+          !slot_size || slot_size > MAX_SHARED_RING_SLOT_SIZE))) {
+    Napi::TypeError::New(env, "Expected a shared ring config object with a name, and "
+        "slotSize when creating")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  std::string error;
+  if (!ring->map(create, slots, slot_size, error)) {
+    Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("name", Napi::String::New(env, ring->name));
+  result.Set("slots", Napi::Number::New(env, ring->header->slots));
+  result.Set("slotSize", Napi::Number::New(env, ring->header->slot_size));
+  result.Set("write", Napi::Function::New(env, [ring](const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    if (!ring->memory || info.Length() < 1 || !getBufferData(info[0], data, size) ||
+        size > ring->header->slot_size) {
+      Napi::TypeError::New(env, "Expected a buffer no larger than slotSize on an open ring")
+          .ThrowAsJavaScriptException();
+      return env.Null();
+    }
+    return Napi::Number::New(env, (double)ring->write(data, size));
+  }, "write"));
+  result.Set("read", Napi::Function::New(env, [ring](const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+    if (!ring->memory)
+      return env.Null();
+
+    // A caller-supplied buffer saves an allocation per frame.
+    uint8_t* target = nullptr;
+    size_t capacity = 0;
+    Napi::Value buffer;
+    if (info.Length() > 0 && getBufferData(info[0], target, capacity))
+      buffer = info[0];
+
+    size_t size = 0;
+    uint64_t seq = 0;
+    uint64_t dropped = 0;
+    if (!ring->read(target, capacity, size, seq, dropped)) {
+      if (size <= capacity)
+        return env.Null();
+      Napi::Buffer<uint8_t> grown = Napi::Buffer<uint8_t>::New(env, size);
+      buffer = grown;
+      if (!ring->read(grown.Data(), size, size, seq, dropped))
+        return env.Null();
+    }
+    // An empty slot read without a buffer.
+    if (buffer.IsEmpty())
+      buffer = Napi::Buffer<uint8_t>::New(env, 0);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("seq", Napi::Number::New(env, (double)seq));
+    result.Set("size", Napi::Number::New(env, (double)size));
+    result.Set("dropped", Napi::Number::New(env, (double)dropped));
+    result.Set("data", buffer);
+    return result;
+  }, "read"));
+  result.Set("close", Napi::Function::New(env, [ring](const Napi::CallbackInfo& info) {
+    ring->close();
+    return info.Env().Undefined();
+  }, "close"));
+  return result;
+}
+
+// Asynchronously shuts OBS down in bounded steps:
+//   1. stops every active output and waits, up to timeoutMs in total, for
+//      them to flush their last packets and signal "stop"; outputs still
+//      running at the deadline are force-stopped
+//   2. releases taps, displays, the scene graph, outputs, encoders, services
+//      and canvases, including the ones JS handles still hold
+//   3. calls obs_shutdown
+// Everything runs on the command thread, queued behind the commands already
+// waiting. Resolves with the duration of every step in milliseconds and the
+// names of the outputs that had to be force-stopped.
 //
-class AsyncStartOutputWorker : public Napi::AsyncWorker {
+// JS: shutdown({ timeoutMs }) -> Promise<{ timings: { stopOutputs, release,
+//     shutdown, total }, forced: [name], leaked? }>
+//     leaked: { encoders: [name], outputs, services, sources, scenes }, with
+//     initialize({ debugObjects: true })
+#define DEFAULT_SHUTDOWN_TIMEOUT_MS 5000
+
+class AsyncShutdownWorker : public ObsCommandWorker {
 public:
   static Napi::Value Create(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
-    if (!obs_initialized()) {
+    if (!initReady()) {
       Napi::TypeError::New(env, NOT_INITIALIZED_STRING)
           .ThrowAsJavaScriptException();
       return env.Null();
     }
 
-    if (info.Length() != 1 || !info[0].IsString()) {
-      Napi::TypeError::New(env, "Expected a single string argument")
+    uint32_t timeout_ms = DEFAULT_SHUTDOWN_TIMEOUT_MS;
+    if (info.Length() > 0 && !info[0].IsUndefined() &&
+        (!info[0].IsObject() || !getUint(info[0].As<Napi::Object>(), "timeoutMs", timeout_ms))) {
+      Napi::TypeError::New(env, "Expected an optional options object")
           .ThrowAsJavaScriptException();
       return env.Null();
     }
 
-    std::string input = info[0].As<Napi::String>();
+    // These own native threads that are joined on the JS thread.
+    stopStatsSubscriptions();
+    stopOutputEventSubscriptions();
+    stopAbrControllers();
 
-    AsyncStartOutputWorker* worker = new AsyncStartOutputWorker(info.Env(), input);
+    AsyncShutdownWorker* worker = new AsyncShutdownWorker(env, timeout_ms);
+    worker->taps = takeTaps();
 
-    worker->Queue();
-    return worker->deferredPromise.Promise();
+    Napi::Promise promise = worker->deferredPromise.Promise();
+    worker->Queue(ObsPriority::LOW);
+    return promise;
   }
 
 protected:
   void Execute() override {
-    video_encoder = obs_video_encoder_create("com.apple.videotoolbox.videoencoder.h264.gva", 
-        "",
-        NULL, 
-        NULL);
+    if (!initReady()) {
+      SetError(NOT_INITIALIZED_STRING);
+      return;
+    }
+    setInitState(ObsInitState::IDLE);
+
+    auto begin = std::chrono::steady_clock::now();
+    auto phase = begin;
+
+    std::vector<ObsOutputContext*> contexts;
+    {
+      std::lock_guard<std::mutex> lock(output_registry_mutex);
+      contexts.assign(output_registry.begin(), output_registry.end());
+    }
+    stopOutputs(contexts, begin + std::chrono::milliseconds(timeout_ms));
+    stop_outputs_ms = elapsedMs(phase);
+
+    phase = std::chrono::steady_clock::now();
+    stopDisplays();
+    taps.disconnect();
+    stopLatencyTrace();
+    stopFrameSources();
+    clearSceneGraph();
+    for (ObsOutputContext* context : contexts)
+      context->release();
+    std::vector<ObsEncoderContext*> encoders;
+    {
+      std::lock_guard<std::mutex> lock(encoder_registry_mutex);
+      encoders.assign(encoder_registry.begin(), encoder_registry.end());
+    }
+    for (ObsEncoderContext* context : encoders)
+      context->release();
+    stopCanvases();
+    release_ms = elapsedMs(phase);
 
-    audio_encoder = obs_audio_encoder_create("adv_stream_aac", 
-        "",
-        NULL, 
-        0, 
-        NULL);
+    // Whatever is still alive here was not released by the addon.
+    if (debug_objects) {
+      leaked.reset(new ObsLiveObjects(liveObjects()));
+      for (int kind = 0; kind < OBJECT_KINDS; kind++) {
+        for (const std::string& name : leaked->names[kind])
+          blog(LOG_WARNING, "obsapi: %s left alive on shutdown: %s", OBJECT_KIND_NAMES[kind],
+              name.c_str());
+      }
+    }
 
-    obs_encoder_set_video(video_encoder, obs_get_video());
-    obs_encoder_set_audio(audio_encoder, obs_get_audio());
-    obs_output_set_video_encoder(output, video_encoder);
-    obs_output_set_audio_encoder(output, audio_encoder, audio_index);
-    obs_output_set_service(output, streaming_service); /* if a stream */
-    obs_output_start(output);
+    phase = std::chrono::steady_clock::now();
+    obs_shutdown();
+    stopProfiler();
+    {
+      std::lock_guard<std::mutex> lock(module_mutex);
+      loaded_modules.clear();
+    }
+    shutdown_ms = elapsedMs(phase);
+    total_ms = elapsedMs(begin);
   }
 
   virtual void OnOK() override {
-    cleanup();
-    deferredPromise.Resolve(Napi::String::New(Env(), "ok"));
+    Napi::Env env = Env();
+    ready_promise.Reset();
+
+    Napi::Object timings = Napi::Object::New(env);
+    timings.Set("stopOutputs", Napi::Number::New(env, stop_outputs_ms));
+    timings.Set("release", Napi::Number::New(env, release_ms));
+    timings.Set("shutdown", Napi::Number::New(env, shutdown_ms));
+    timings.Set("total", Napi::Number::New(env, total_ms));
+
+    Napi::Array names = Napi::Array::New(env, forced.size());
+    for (size_t i = 0; i < forced.size(); i++)
+      names.Set(i, Napi::String::New(env, forced[i]));
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("timings", timings);
+    result.Set("forced", names);
+    if (leaked)
+      result.Set("leaked", liveNamesToJs(env, *leaked));
+    deferredPromise.Resolve(result);
   }
 
   virtual void OnError(const Napi::Error& e) override {
-    cleanup();
     deferredPromise.Reject(e.Value());
   }
 
 private:
-  AsyncStartOutputWorker(napi_env env, std::string& hint) :
-    Napi::AsyncWorker(env),
-    input(hint),
+  AsyncShutdownWorker(napi_env env, uint32_t timeout_ms) :
+    ObsCommandWorker(env),
+    timeout_ms(timeout_ms),
     deferredPromise(Napi::Promise::Deferred::New(env)) { }
 
-  obs_encoder_t* video_encoder = nullptr;
-  obs_encoder_t* audio_encoder = nullptr;
-  obs_output_t* output = nullptr;
-  obs_service_t* streaming_service = nullptr;
-  size_t audio_index = 0;
-
-  void cleanup() {
-    if(output) {
-      obs_output_stop(output);
-      obs_output_release(output);
-      output = nullptr;
+  // Stops the outputs together so they flush in parallel, then waits for
+  // each one until the shared deadline.
+  void stopOutputs(const std::vector<ObsOutputContext*>& contexts,
+      std::chrono::steady_clock::time_point deadline) {
+    std::vector<ObsOutputContext*> stopping;
+    for (ObsOutputContext* context : contexts) {
+      if (obs_output_active(context->output)) {
+        context->requestStop();
+        stopping.push_back(context);
+      }
     }
 
-    if(video_encoder) {
-      obs_encoder_release(video_encoder);
-      video_encoder = nullptr;
-    }
-    if(audio_encoder) {
-      obs_encoder_release(audio_encoder);
-      audio_encoder = nullptr;
-    }
+    for (ObsOutputContext* context : stopping) {
+      long long code;
+      if (context->waitStopped(deadline, code))
+        continue;
 
-    if(streaming_service) {
-      obs_service_release(streaming_service);
-      streaming_service = nullptr;
+      forced.push_back(obs_output_get_name(context->output));
+      obs_output_force_stop(context->output);
     }
   }
 
-  std::string input;
+  uint32_t timeout_ms;
+  ObsTaps taps;
+  std::vector<std::string> forced;
+  std::unique_ptr<ObsLiveObjects> leaked;
+  double stop_outputs_ms = 0;
+  double release_ms = 0;
+  double shutdown_ms = 0;
+  double total_ms = 0;
   Napi::Promise::Deferred deferredPromise;
 };
 
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
   exports.Set(Napi::String::New(env, "initialize"),
               Napi::Function::New(env, AsyncInitializeWorker::Create));
+  exports.Set(Napi::String::New(env, "ready"),
+              Napi::Function::New(env, obsReady));
+  exports.Set(Napi::String::New(env, "loadModule"),
+              Napi::Function::New(env, AsyncLoadModuleWorker::Create));
   exports.Set(Napi::String::New(env, "shutdown"),
-              Napi::Function::New(env, obsShutdown));
+              Napi::Function::New(env, AsyncShutdownWorker::Create));
   exports.Set(Napi::String::New(env, "resetVideo"),
               Napi::Function::New(env, AsyncResetVideoWorker::Create));
   exports.Set(Napi::String::New(env, "resetAudio"),
               Napi::Function::New(env, AsyncResetAudioWorker::Create));
-  exports.Set(Napi::String::New(env, "startOutput"),
-              Napi::Function::New(env, AsyncStartOutputWorker::Create));
+  exports.Set(Napi::String::New(env, "saveProfile"),
+              Napi::Function::New(env, AsyncProfileWorker::Save));
+  exports.Set(Napi::String::New(env, "loadProfile"),
+              Napi::Function::New(env, AsyncProfileWorker::Load));
+  exports.Set(Napi::String::New(env, "createEncoders"),
+              Napi::Function::New(env, AsyncCreateEncodersWorker::Create));
+  exports.Set(Napi::String::New(env, "createOutput"),
+              Napi::Function::New(env, AsyncCreateOutputWorker::Create));
+  exports.Set(Napi::String::New(env, "selectVideoEncoder"),
+              Napi::Function::New(env, AsyncSelectEncoderWorker::Create));
+  exports.Set(Napi::String::New(env, "getStats"),
+              Napi::Function::New(env, obsGetStats));
+  exports.Set(Napi::String::New(env, "subscribeOutputEvents"),
+              Napi::Function::New(env, obsSubscribeOutputEvents));
+  exports.Set(Napi::String::New(env, "subscribeStats"),
+              Napi::Function::New(env, obsSubscribeStats));
+  exports.Set(Napi::String::New(env, "createVideoTap"),
+              Napi::Function::New(env, obsCreateVideoTap));
+  exports.Set(Napi::String::New(env, "createAudioTap"),
+              Napi::Function::New(env, obsCreateAudioTap));
+  exports.Set(Napi::String::New(env, "createPacketTap"),
+              Napi::Function::New(env, obsCreatePacketTap));
+  exports.Set(Napi::String::New(env, "createDisplay"),
+              Napi::Function::New(env, AsyncDisplayWorker::Create));
+  exports.Set(Napi::String::New(env, "applyBatch"),
+              Napi::Function::New(env, AsyncApplyBatchWorker::Create));
+  exports.Set(Napi::String::New(env, "createScene"),
+              Napi::Function::New(env, obsCreateScene));
+  exports.Set(Napi::String::New(env, "createSource"),
+              Napi::Function::New(env, obsCreateSource));
+  exports.Set(Napi::String::New(env, "addSceneItem"),
+              Napi::Function::New(env, obsAddSceneItem));
+  exports.Set(Napi::String::New(env, "createFrameSource"),
+              Napi::Function::New(env, AsyncCreateFrameSourceWorker::Create));
+  exports.Set(Napi::String::New(env, "getSceneItems"),
+              Napi::Function::New(env, AsyncSceneItemsWorker::Create));
+  exports.Set(Napi::String::New(env, "createCanvas"),
+              Napi::Function::New(env, AsyncCanvasWorker::Create));
+  exports.Set(Napi::String::New(env, "getAdapters"),
+              Napi::Function::New(env, AsyncGetAdaptersWorker::Create));
+  exports.Set(Napi::String::New(env, "getMemoryStats"),
+              Napi::Function::New(env, obsGetMemoryStats));
+  exports.Set(Napi::String::New(env, "startLatencyTrace"),
+              Napi::Function::New(env, AsyncLatencyTraceWorker::Create));
+  exports.Set(Napi::String::New(env, "getLatencyHistogram"),
+              Napi::Function::New(env, obsGetLatencyHistogram));
+  exports.Set(Napi::String::New(env, "getProfilerSnapshot"),
+              Napi::Function::New(env, AsyncProfilerSnapshotWorker::Create));
   exports.Set(Napi::String::New(env, "getCodecs"),
               Napi::Function::New(env, obsGetCodecs));
   exports.Set(Napi::String::New(env, "getOutputs"),
               Napi::Function::New(env, obsGetOutputs));
+  exports.Set(Napi::String::New(env, "openSharedRing"),
+              Napi::Function::New(env, obsOpenSharedRing));
+  ObsEncoders::Init(env, exports);
+  ObsOutput::Init(env, exports);
+  ObsDisplay::Init(env, exports);
+  obs_commands.Start(env);
+
+  // Native threads must not outlive the environment they call back into.
+  napi_add_env_cleanup_hook(env, [](void*) {
+    stopStatsSubscriptions();
+    stopOutputEventSubscriptions();
+    stopAbrControllers();
+    ObsTaps taps = takeTaps();
+    obs_commands.RunSync([&taps] {
+      stopDisplays();
+      taps.disconnect();
+      stopLatencyTrace();
+    });
+    obs_commands.Stop();
+  }, nullptr);
   return exports;
 }
 